@@ -41,6 +41,11 @@ enum l4re_aux_ldr_flags_t
   L4RE_AUX_LDR_FLAG_EAGER_MAP    = 0x1,
   L4RE_AUX_LDR_FLAG_ALL_SEGS_COW = 0x2,
   L4RE_AUX_LDR_FLAG_PINNED_SEGS  = 0x4,
+  /** Map a window around page faults in all regions (see L4Re::Rm::Prefault) */
+  L4RE_AUX_LDR_FLAG_PREFAULT     = 0x8,
+  /** log2 of the largest fault-around window, 0 for the default of 1 MiB */
+  L4RE_AUX_LDR_FAULT_AROUND_SHIFT = 8,
+  L4RE_AUX_LDR_FAULT_AROUND_MASK  = 0x3f00,
 };
 
 /**
@@ -45,19 +45,59 @@ namespace
 {
   struct Ca : L4Re::Cap_alloc_t<L4Re::Util::_Cap_alloc>
   {
-    enum { Caps = 4096 };
+    enum
+    {
+      Caps = 4096,
+      Max_chunks = 64,
+    };
     typedef L4Re::Util::_Cap_alloc::Counter_storage<Caps> Storage;
 
-    L4::Cap<L4Re::Dataspace> _ds;
-    Ca() : _ds(L4::Cap<L4Re::Dataspace>::No_init)
+    l4_addr_t _area;
+
+    /**
+     * Map the counter storage for the slots starting at `first`.
+     *
+     * The dataspace for the storage uses the capability slot `cap`.
+     */
+    bool add_chunk(long cap, long first)
+    {
+      L4Re::Env const *e = L4Re::Env::env();
+      L4::Cap<L4Re::Dataspace> ds(cap << L4_CAP_SHIFT);
+      if (e->mem_alloc()->alloc(sizeof(Storage), ds) < 0)
+        return false;
+
+      l4_addr_t a = _area + first * (sizeof(Storage) / Caps);
+      if (e->rm()->attach(&a, sizeof(Storage), L4Re::Rm::In_area,
+                          L4::Ipc::make_cap_rw(ds)) < 0)
+        {
+          e->task()->unmap(ds.fpage(), L4_FP_ALL_SPACES | L4_FP_DELETE_OBJ);
+          return false;
+        }
+
+      return true;
+    }
+
+    static long grow(L4Re::Util::_Cap_alloc *a, long capacity)
+    {
+      Ca *ca = static_cast<Ca *>(a);
+      if (capacity >= Caps * Max_chunks)
+        return capacity;
+
+      // The first slot of the new chunk holds its dataspace.
+      if (!ca->add_chunk(ca->last() + 1, capacity))
+        return capacity;
+
+      ca->counter(capacity)->alloc();
+      return capacity + Caps;
+    }
+
+    Ca() : _area(0)
     {
       L4Re::Env const *e = L4Re::Env::env();
-      _ds = L4::Cap<L4Re::Dataspace>(e->first_free_cap() << L4_CAP_SHIFT);
-      l4_check(e->mem_alloc()->alloc(sizeof(Storage), _ds) >= 0);
-      void *a = 0;
-      l4_check(e->rm()->attach(&a, sizeof(Storage), L4Re::Rm::Search_addr,
-                               L4::Ipc::make_cap_rw(_ds)) >= 0);
-      setup(a, Caps, e->first_free_cap() + 1);
+      l4_check(e->rm()->reserve_area(&_area, sizeof(Storage) * Max_chunks,
+                                     L4Re::Rm::Search_addr) >= 0);
+      l4_check(add_chunk(e->first_free_cap(), 0));
+      setup((void *)_area, Caps, e->first_free_cap() + 1, grow);
     }
   };
 
@@ -40,9 +40,10 @@ EXTERN_C_BEGIN
  * \see L4Re::Mem_alloc::Mem_alloc_flags
  */
 enum l4re_ma_flags {
-  L4RE_MA_CONTINUOUS  = 0x01,
-  L4RE_MA_PINNED      = 0x02,
-  L4RE_MA_SUPER_PAGES = 0x04,
+  L4RE_MA_CONTINUOUS     = 0x01,
+  L4RE_MA_PINNED         = 0x02,
+  L4RE_MA_SUPER_PAGES    = 0x04,
+  L4RE_MA_NO_SUPER_PAGES = 0x08,
 };
 
 
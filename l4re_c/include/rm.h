@@ -43,6 +43,7 @@ enum l4re_rm_flags_t {
   L4RE_RM_PAGER        = 0x04, /**< \brief Region has a pager */
   L4RE_RM_RESERVED     = 0x08, /**< \brief Region is reserved (blocked) */
   L4RE_RM_REGION_FLAGS = 0x0f, /**< \brief Mask of all region flags */
+  L4RE_RM_PREFAULT     = 0x400, /**< \brief Map a window around each fault */
 
   L4RE_RM_OVERMAP      = 0x10, /**< \brief Unmap memory already mapped in the region */
   L4RE_RM_SEARCH_ADDR  = 0x20, /**< \brief Search for a suitable address range */
@@ -28,6 +28,84 @@ using L4Re::Rm;
 using L4Re::Dataspace;
 using L4Re::Util::Region;
 
+namespace {
+
+/**
+ * Fault-around windows for regions with Rm::Prefault.
+ *
+ * A fault gets a naturally aligned window of Base_order around it. A fault
+ * right behind the window of an earlier one continues a sequential scan,
+ * it gets the window behind it, twice as large up to the maximum. The last
+ * few scans are tracked, so that interleaved scans keep their windows.
+ */
+class Fault_around
+{
+public:
+  enum
+  {
+    Base_order        = L4_PAGESHIFT + 4,
+    Default_max_order = 20,
+    Num_streams       = 4,
+  };
+
+  /**
+   * Get the window [start, end] to map for a fault at `addr` in `r`.
+   */
+  void window(l4_addr_t addr, Region const &r, unsigned char max_order,
+              l4_addr_t *start, l4_addr_t *end);
+
+private:
+  struct Stream
+  {
+    l4_addr_t next;
+    unsigned char order;
+  };
+
+  Stream _s[Num_streams];
+  unsigned _victim = 0;
+};
+
+void
+Fault_around::window(l4_addr_t addr, Region const &r, unsigned char max_order,
+                     l4_addr_t *start, l4_addr_t *end)
+{
+  addr = l4_trunc_page(addr);
+
+  Stream *s = 0;
+  for (Stream &x: _s)
+    if (x.next == addr)
+      {
+        s = &x;
+        break;
+      }
+
+  unsigned char order;
+  if (s)
+    {
+      order = s->order < max_order ? s->order + 1 : max_order;
+      *start = addr;
+    }
+  else
+    {
+      s = &_s[_victim++ % Num_streams];
+      order = Base_order < max_order ? (unsigned char)Base_order : max_order;
+      *start = l4_trunc_size(addr, order);
+    }
+
+  *end = *start + (1UL << order) - 1;
+  if (*start < r.start())
+    *start = r.start();
+  if (*end > r.end() || *end < *start)
+    *end = r.end();
+
+  s->next = *end + 1;
+  s->order = order;
+}
+
+Fault_around fault_around;
+
+}
+
 Region_map::Region_map()
   : Base(0,0)
 {}
@@ -86,7 +164,36 @@ Region_ops::map(Region_handler const *h, l4_addr_t local_addr,
       l4_addr_t offset = local_addr - r.start() + h->offset();
       L4::Cap<L4Re::Dataspace> ds = L4::cap_cast<L4Re::Dataspace>(h->memory());
       unsigned flags = writable | (h->caching() >> Rm::Caching_ds_shift);
-      return ds->map(offset, flags, local_addr, r.start(), r.end());
+      l4_umword_t ldr_flags = Global::l4re_aux->ldr_flags;
+
+      if (!(h->flags() & Rm::Prefault)
+          && !(ldr_flags & L4RE_AUX_LDR_FLAG_PREFAULT))
+        return ds->map(offset, flags, local_addr, r.start(), r.end());
+
+      unsigned char max_order = (ldr_flags & L4RE_AUX_LDR_FAULT_AROUND_MASK)
+                                >> L4RE_AUX_LDR_FAULT_AROUND_SHIFT;
+      if (!max_order)
+        max_order = Fault_around::Default_max_order;
+      else if (max_order < L4_PAGESHIFT)
+        max_order = L4_PAGESHIFT;
+      else if (max_order > sizeof(l4_addr_t) * 8 - 1)
+        max_order = sizeof(l4_addr_t) * 8 - 1;
+
+      // a window larger than the region would only be clipped to it
+      l4_addr_t r_last = r.end() - r.start();
+      while (max_order > L4_PAGESHIFT && (1UL << (max_order - 1)) > r_last)
+        --max_order;
+
+      l4_addr_t start, end;
+      fault_around.window(local_addr, r, max_order, &start, &end);
+
+      // map_region() sends the largest fpages the window allows
+      long err = ds->map_region(start - r.start() + h->offset(), flags,
+                                start, end + 1);
+      if (err < 0)
+        return ds->map(offset, flags, local_addr, r.start(), r.end());
+
+      return err;
     }
 }
 
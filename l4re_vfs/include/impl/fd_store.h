@@ -18,26 +18,126 @@
 #pragma once
 
 #include <l4/l4re_vfs/vfs.h>
+#include <l4/sys/utcb.h>
 
 namespace L4Re { namespace Core {
 
 using cxx::Ref_ptr;
 
+/**
+ * Table of open file descriptors.
+ *
+ * The table grows in chunks of one bitmap word worth of descriptors. Chunks
+ * are never freed or moved, so get() runs without taking a lock. A thread
+ * that removes a file from the table waits until no reader can still be
+ * about to take a reference to it before the table drops its own one.
+ *
+ * Free descriptors are found through a two-level bitmap of full chunks, so
+ * the lowest free descriptor is found in constant time.
+ */
 class Fd_store
 {
 public:
-  enum { MAX_FILES = 50 };
+  enum
+  {
+    MAX_FILES = 32768,
+    Bpw = sizeof(unsigned long) * 8,
+    Chunk_size = Bpw,
+    Num_chunks = MAX_FILES / Chunk_size,
+    Full_words = Num_chunks / Bpw,
+    Reader_slots = 8,
+  };
+
+  Fd_store() throw();
 
-  Fd_store() throw() : _fd_hint(0) {}
+  /**
+   * Allocate the lowest free descriptor.
+   *
+   * \param f  File to store at the descriptor, may be Nil to only reserve
+   *           the descriptor.
+   *
+   * \retval >=0      The allocated descriptor.
+   * \retval -EMFILE  The table is full.
+   * \retval -ENOMEM  The table could not grow.
+   */
+  int alloc(Ref_ptr<L4Re::Vfs::File> const &f) throw();
+
+  /**
+   * Free a descriptor.
+   *
+   * \return The file that was stored at the descriptor.
+   */
+  Ref_ptr<L4Re::Vfs::File> free(int fd) throw();
 
-  int alloc() throw();
-  void free(int fd) throw();
   Ref_ptr<L4Re::Vfs::File> get(int fd) throw();
-  void set(int fd, Ref_ptr<L4Re::Vfs::File> const &f) throw();
+
+  /**
+   * Store a file at a descriptor, growing the table as needed.
+   *
+   * \param      fd   The descriptor.
+   * \param      f    The new file. Nil frees the descriptor.
+   * \param[out] old  The file that was stored at the descriptor before.
+   *
+   * \retval 0        Success.
+   * \retval -EBADF   `fd` is out of range.
+   * \retval -ENOMEM  The table could not grow.
+   */
+  int set(int fd, Ref_ptr<L4Re::Vfs::File> const &f,
+          Ref_ptr<L4Re::Vfs::File> *old = 0) throw();
 
 private:
-  int _fd_hint;
-  Ref_ptr<L4Re::Vfs::File> _files[MAX_FILES];
+  struct Chunk
+  {
+    L4Re::Vfs::File *files[Chunk_size];
+    unsigned long used;
+  };
+
+  struct Reader_slot
+  {
+    unsigned long cnt[2];
+  } __attribute__((aligned(64)));
+
+  /**
+   * Marks a reader of the table for the duration of a get().
+   *
+   * Readers are counted in one of a few slots selected by their UTCB, so
+   * threads mostly do not share a cache line.
+   */
+  class Read_guard
+  {
+  public:
+    explicit Read_guard(Fd_store *s) throw()
+    {
+      Reader_slot *r =
+        &s->_readers[((l4_addr_t)l4_utcb() / L4_UTCB_OFFSET) % Reader_slots];
+      _cnt = &r->cnt[__atomic_load_n(&s->_epoch, __ATOMIC_RELAXED) & 1];
+      __atomic_add_fetch(_cnt, 1, __ATOMIC_SEQ_CST);
+    }
+
+    ~Read_guard() throw()
+    { __atomic_sub_fetch(_cnt, 1, __ATOMIC_RELEASE); }
+
+  private:
+    unsigned long *_cnt;
+  };
+
+  void lock() throw();
+  void unlock() throw();
+  void wait_for_readers() throw();
+  Chunk *get_chunk(int ci) throw();
+  L4Re::Vfs::File *exchange(int fd, L4Re::Vfs::File *f) throw();
+  void mark(int fd, bool used) throw();
+  int find_free() const throw();
+
+  Chunk *_chunks[Num_chunks];
+  unsigned long _full[Full_words];
+  unsigned long _full_words;
+  unsigned _epoch;
+  bool _lock;
+  Chunk _first;
+  Reader_slot _readers[Reader_slots];
+
+  static_assert(Full_words <= Bpw, "descriptor bitmap too large");
 };
 
 
@@ -45,17 +145,16 @@ inline
 Ref_ptr<L4Re::Vfs::File>
 Fd_store::get(int fd) throw()
 {
-  if (fd >= 0 && fd < MAX_FILES)
-    return _files[fd];
+  if (L4_UNLIKELY(fd < 0 || fd >= MAX_FILES))
+    return Ref_ptr<>::Nil;
 
-  return Ref_ptr<>::Nil;
-}
+  Chunk *c = __atomic_load_n(&_chunks[fd / Chunk_size], __ATOMIC_ACQUIRE);
+  if (!c)
+    return Ref_ptr<>::Nil;
 
-inline
-void
-Fd_store::set(int fd, Ref_ptr<L4Re::Vfs::File> const &f) throw()
-{
-  _files[fd] = f;
+  Read_guard g(this);
+  return Ref_ptr<L4Re::Vfs::File>(
+    __atomic_load_n(&c->files[fd % Chunk_size], __ATOMIC_SEQ_CST));
 }
 
 }}
@@ -17,30 +17,184 @@
  */
 #include "fd_store.h"
 
+#include <l4/sys/thread.h>
+#include <errno.h>
+#include <string.h>
+
 namespace L4Re { namespace Core {
 
-int
-Fd_store::alloc() throw()
+Fd_store::Fd_store() throw()
+: _full_words(0), _epoch(0), _lock(false)
+{
+  memset(_chunks, 0, sizeof(_chunks));
+  memset(_full, 0, sizeof(_full));
+  memset(&_first, 0, sizeof(_first));
+  memset(_readers, 0, sizeof(_readers));
+  _chunks[0] = &_first;
+
+  // words beyond the bitmap count as full
+  if (Full_words < Bpw)
+    _full_words = ~0UL << Full_words;
+}
+
+void
+Fd_store::lock() throw()
+{
+  while (__atomic_test_and_set(&_lock, __ATOMIC_ACQUIRE))
+    l4_thread_yield();
+}
+
+void
+Fd_store::unlock() throw()
+{
+  __atomic_clear(&_lock, __ATOMIC_RELEASE);
+}
+
+void
+Fd_store::wait_for_readers() throw()
 {
-  for (int i = _fd_hint; i < MAX_FILES; ++i)
+  // Switch new readers to the other counter and wait for the old one to
+  // drain. Twice, because a reader may have picked its counter before the
+  // previous switch.
+  for (int round = 0; round < 2; ++round)
     {
-      if (!_files[i])
-	{
-	  _fd_hint = i + 1;
-	  return i;
-	}
+      unsigned idx = __atomic_fetch_xor(&_epoch, 1, __ATOMIC_SEQ_CST) & 1;
+      for (auto &r: _readers)
+        while (__atomic_load_n(&r.cnt[idx], __ATOMIC_SEQ_CST))
+          l4_thread_yield();
     }
+}
+
+Fd_store::Chunk *
+Fd_store::get_chunk(int ci) throw()
+{
+  Chunk *c = _chunks[ci];
+  if (c)
+    return c;
+
+  c = static_cast<Chunk *>(Vfs_config::malloc(sizeof(Chunk)));
+  if (!c)
+    return 0;
 
-  return -1;
+  memset(c, 0, sizeof(*c));
+  __atomic_store_n(&_chunks[ci], c, __ATOMIC_RELEASE);
+  return c;
+}
+
+L4Re::Vfs::File *
+Fd_store::exchange(int fd, L4Re::Vfs::File *f) throw()
+{
+  if (f)
+    f->add_ref();
+
+  L4Re::Vfs::File *old =
+    __atomic_exchange_n(&_chunks[fd / Chunk_size]->files[fd % Chunk_size], f,
+                        __ATOMIC_SEQ_CST);
+  if (old)
+    wait_for_readers();
+
+  return old;
 }
 
 void
+Fd_store::mark(int fd, bool used) throw()
+{
+  unsigned ci = fd / Chunk_size;
+  unsigned long bit = 1UL << (fd % Chunk_size);
+  unsigned long cbit = 1UL << (ci % Bpw);
+  unsigned w = ci / Bpw;
+  Chunk *c = _chunks[ci];
+
+  if (used)
+    {
+      c->used |= bit;
+      if (c->used == ~0UL)
+        {
+          _full[w] |= cbit;
+          if (_full[w] == ~0UL)
+            _full_words |= 1UL << w;
+        }
+    }
+  else
+    {
+      c->used &= ~bit;
+      _full[w] &= ~cbit;
+      _full_words &= ~(1UL << w);
+    }
+}
+
+int
+Fd_store::find_free() const throw()
+{
+  if (_full_words == ~0UL)
+    return -1;
+
+  unsigned w = __builtin_ctzl(~_full_words);
+  unsigned ci = w * Bpw + __builtin_ctzl(~_full[w]);
+  Chunk const *c = _chunks[ci];
+  return ci * Chunk_size + (c ? __builtin_ctzl(~c->used) : 0);
+}
+
+int
+Fd_store::alloc(Ref_ptr<L4Re::Vfs::File> const &f) throw()
+{
+  lock();
+  int fd = find_free();
+  if (fd < 0)
+    {
+      unlock();
+      return -EMFILE;
+    }
+
+  if (!get_chunk(fd / Chunk_size))
+    {
+      unlock();
+      return -ENOMEM;
+    }
+
+  mark(fd, true);
+  // the descriptor was free, so there is no old file to wait for
+  exchange(fd, f.get());
+  unlock();
+  return fd;
+}
+
+int
+Fd_store::set(int fd, Ref_ptr<L4Re::Vfs::File> const &f,
+              Ref_ptr<L4Re::Vfs::File> *old) throw()
+{
+  if (fd < 0 || fd >= MAX_FILES)
+    return -EBADF;
+
+  lock();
+  if (!get_chunk(fd / Chunk_size))
+    {
+      unlock();
+      return -ENOMEM;
+    }
+
+  mark(fd, bool(f));
+  // adopt the reference the table held
+  Ref_ptr<L4Re::Vfs::File> o(exchange(fd, f.get()), true);
+  unlock();
+
+  if (old)
+    *old = cxx::move(o);
+
+  return 0;
+}
+
+Ref_ptr<L4Re::Vfs::File>
 Fd_store::free(int fd) throw()
 {
-  _files[fd] = 0;
-  if (fd < _fd_hint)
-    _fd_hint = fd;
+  if (fd < 0 || fd >= MAX_FILES || !_chunks[fd / Chunk_size])
+    return Ref_ptr<>::Nil;
+
+  lock();
+  mark(fd, false);
+  Ref_ptr<L4Re::Vfs::File> o(exchange(fd, 0), true);
+  unlock();
+  return o;
 }
 
 }}
-
@@ -20,6 +20,7 @@
 
 #include <l4/l4re_vfs/backend>
 #include <l4/sys/capability>
+#include <l4/sys/thread.h>
 #include <l4/re/namespace>
 #include <l4/re/unique_cap>
 
@@ -27,6 +28,91 @@ namespace L4Re { namespace Core {
 
 using cxx::Ref_ptr;
 
+/**
+ * Cache for the results of Namespace::query().
+ *
+ * Maps a name within a namespace to the capability returned by the query,
+ * or to the error for a name that does not exist. Positive entries share
+ * their capability slot with the files created from them, the slot is
+ * reference counted by L4Re::virt_cap_alloc. An entry whose object is gone
+ * is dropped when it is found. Negative entries expire after
+ * #Neg_timeout_us, so that names registered later become visible.
+ */
+class Ns_cache
+{
+public:
+  enum
+  {
+    Num_entries = 32,         ///< Number of cached names, LRU replaced
+    Max_name = 64,            ///< Longer names are not cached
+    Max_type = 32,            ///< Maximum cached length of a type name
+    Neg_timeout_us = 1000000, ///< Lifetime of negative entries
+  };
+
+  /// Type of an object as reported by L4::Meta::interface().
+  struct Type
+  {
+    long proto;
+    char name[Max_type];
+    bool valid;
+  };
+
+  /**
+   * Query `name` in `ns`, or take the result from the cache.
+   *
+   * \param[out] obj   Capability for the object, the caller owns one
+   *                   reference to it and must release it.
+   * \param[out] type  Type of the object if known, `type->valid` is false
+   *                   otherwise.
+   * \return >=0 on success, <0 on error.
+   */
+  long query(L4::Cap<L4Re::Namespace> ns, char const *name, unsigned len,
+             L4::Cap<void> *obj, Type *type) throw();
+
+  /// Remember the type of a cached object.
+  void set_type(L4::Cap<L4Re::Namespace> ns, char const *name, unsigned len,
+                Type const &type) throw();
+
+  /// Forget `name` and everything below it in `ns`.
+  void invalidate(L4::Cap<L4Re::Namespace> ns, char const *name,
+                  unsigned len) throw();
+
+private:
+  struct Entry
+  {
+    bool used;
+    l4_cap_idx_t ns;
+    l4_cap_idx_t obj;
+    long err;
+    l4_cpu_time_t expires;
+    unsigned long last_use;
+    unsigned hash;
+    unsigned len;
+    char name[Max_name];
+    Type type;
+  };
+
+  static unsigned hash(l4_cap_idx_t ns, char const *name, unsigned len) throw();
+  Entry *find(l4_cap_idx_t ns, char const *name, unsigned len,
+              unsigned hash) throw();
+  void insert(l4_cap_idx_t ns, char const *name, unsigned len,
+              unsigned hash, L4::Cap<void> obj, long err) throw();
+  void drop(Entry *e) throw();
+
+  void lock() throw()
+  {
+    while (__atomic_test_and_set(&_lock, __ATOMIC_ACQUIRE))
+      l4_thread_yield();
+  }
+
+  void unlock() throw()
+  { __atomic_clear(&_lock, __ATOMIC_RELEASE); }
+
+  Entry _e[Num_entries];
+  unsigned long _clock;
+  bool _lock;
+};
+
 class Env_dir : public L4Re::Vfs::Be_file
 {
 public:
@@ -42,12 +128,12 @@ public:
   int faccessat(const char *path, int mode, int flags) throw();
   int get_entry(const char *path, int flags, mode_t mode,
                 Ref_ptr<L4Re::Vfs::File> *) throw();
+  int unlink(const char *path) throw();
   ssize_t getdents(char *, size_t) throw();
 
   ~Env_dir() throw() {}
 
 private:
-  int get_ds(const char *path, L4Re::Unique_cap<L4Re::Dataspace> *ds) throw();
   bool check_type(Env::Cap_entry const *e, long protocol) throw();
 
   L4Re::Env const *_env;
@@ -69,6 +155,7 @@ public:
   int faccessat(const char *path, int mode, int flags) throw();
   int get_entry(const char *path, int flags, mode_t mode,
                 Ref_ptr<L4Re::Vfs::File> *) throw();
+  int unlink(const char *path) throw();
   ssize_t getdents(char *, size_t) throw();
 
   ~Ns_dir() throw() {}
@@ -25,19 +25,206 @@
 
 namespace L4Re { namespace Core {
 
+static Ns_cache ns_cache;
+
+unsigned
+Ns_cache::hash(l4_cap_idx_t ns, char const *name, unsigned len) throw()
+{
+  // FNV-1a
+  unsigned h = 2166136261U ^ (ns >> L4_CAP_SHIFT);
+  for (unsigned i = 0; i < len; ++i)
+    h = (h ^ (unsigned char)name[i]) * 16777619U;
+  return h;
+}
+
+Ns_cache::Entry *
+Ns_cache::find(l4_cap_idx_t ns, char const *name, unsigned len,
+               unsigned hash) throw()
+{
+  for (Entry &e: _e)
+    if (e.used && e.hash == hash && e.ns == ns && e.len == len
+        && !memcmp(e.name, name, len))
+      return &e;
+
+  return 0;
+}
+
+void
+Ns_cache::drop(Entry *e) throw()
+{
+  if (e->err >= 0)
+    L4Re::virt_cap_alloc->release(L4::Cap<void>(e->obj), L4Re::This_task);
+
+  e->used = false;
+}
+
+void
+Ns_cache::insert(l4_cap_idx_t ns, char const *name, unsigned len,
+                 unsigned hash, L4::Cap<void> obj, long err) throw()
+{
+  lock();
+  if (find(ns, name, len, hash))
+    {
+      // someone else was faster
+      unlock();
+      return;
+    }
+
+  Entry *e = &_e[0];
+  for (Entry &i: _e)
+    {
+      if (!i.used)
+        {
+          e = &i;
+          break;
+        }
+
+      if (i.last_use < e->last_use)
+        e = &i;
+    }
+
+  if (e->used)
+    drop(e);
+
+  if (err >= 0)
+    L4Re::virt_cap_alloc->take(obj);
+
+  e->used = true;
+  e->ns = ns;
+  e->obj = obj.cap();
+  e->err = err;
+  e->expires = l4_kip_clock(l4re_kip()) + Neg_timeout_us;
+  e->last_use = ++_clock;
+  e->hash = hash;
+  e->len = len;
+  memcpy(e->name, name, len);
+  e->type.valid = false;
+  unlock();
+}
+
+long
+Ns_cache::query(L4::Cap<L4Re::Namespace> ns, char const *name, unsigned len,
+                L4::Cap<void> *obj, Type *type) throw()
+{
+  type->valid = false;
+  unsigned h = hash(ns.cap(), name, len);
+
+  if (len <= Max_name)
+    {
+      lock();
+      Entry *e = find(ns.cap(), name, len, h);
+      if (e && e->err < 0)
+        {
+          if (l4_kip_clock(l4re_kip()) < e->expires)
+            {
+              long err = e->err;
+              unlock();
+              return err;
+            }
+
+          drop(e);
+        }
+      else if (e)
+        {
+          L4::Cap<void> c(e->obj);
+          // a deleted object leaves an empty capability slot behind
+          if (L4Re::Env::env()->task()->cap_valid(c).label() > 0)
+            {
+              L4Re::virt_cap_alloc->take(c);
+              e->last_use = ++_clock;
+              *type = e->type;
+              *obj = c;
+              unlock();
+              return 0;
+            }
+
+          drop(e);
+        }
+      unlock();
+    }
+
+  L4::Cap<void> c = L4Re::virt_cap_alloc->alloc<void>();
+  if (!c.is_valid())
+    return -ENOMEM;
+
+  long err = ns->query(name, len, c);
+  if (err < 0)
+    L4Re::virt_cap_alloc->free(c);
+
+  // other errors, such as timeouts, are not permanent
+  if (len <= Max_name && (err >= 0 || err == -L4_ENOENT))
+    insert(ns.cap(), name, len, h, c, err);
+
+  if (err >= 0)
+    *obj = c;
+
+  return err;
+}
+
+void
+Ns_cache::set_type(L4::Cap<L4Re::Namespace> ns, char const *name,
+                   unsigned len, Type const &type) throw()
+{
+  if (len > Max_name)
+    return;
+
+  lock();
+  Entry *e = find(ns.cap(), name, len, hash(ns.cap(), name, len));
+  if (e)
+    e->type = type;
+  unlock();
+}
+
+void
+Ns_cache::invalidate(L4::Cap<L4Re::Namespace> ns, char const *name,
+                     unsigned len) throw()
+{
+  lock();
+  for (Entry &e: _e)
+    if (e.used && e.ns == ns.cap() && e.len >= len
+        && !memcmp(e.name, name, len)
+        && (e.len == len || e.name[len] == '/'))
+      drop(&e);
+  unlock();
+}
+
 static
 Ref_ptr<L4Re::Vfs::File>
-cap_to_vfs_object(L4::Cap<void> o, int *err)
+cap_to_vfs_object(L4::Cap<void> o, int *err, Ns_cache::Type *type = 0)
 {
-  L4::Cap<L4::Meta> m = L4::cap_reinterpret_cast<L4::Meta>(o);
   long proto = 0;
   char name_buf[256];
-  L4::Ipc::String<char> name(sizeof(name_buf), name_buf);
-  int r = l4_error(m->interface(0, &proto, &name));
-  *err = -ENOPROTOOPT;
-  if (r < 0)
-    // could not get type of object so bail out
-    return Ref_ptr<L4Re::Vfs::File>();
+  char const *name = name_buf;
+
+  if (type && type->valid)
+    {
+      proto = type->proto;
+      name = type->name;
+    }
+  else
+    {
+      L4::Cap<L4::Meta> m = L4::cap_reinterpret_cast<L4::Meta>(o);
+      L4::Ipc::String<char> n(sizeof(name_buf), name_buf);
+      int r = l4_error(m->interface(0, &proto, &n));
+      *err = -ENOPROTOOPT;
+      if (r < 0)
+        // could not get type of object so bail out
+        return Ref_ptr<L4Re::Vfs::File>();
+
+      if (type)
+        {
+          type->proto = proto;
+          for (unsigned i = 0; i < sizeof(type->name) && i < n.length; ++i)
+            {
+              type->name[i] = name_buf[i];
+              if (!name_buf[i])
+                {
+                  type->valid = true;
+                  break;
+                }
+            }
+        }
+    }
 
   *err = -EPROTO;
   Ref_ptr<L4Re::Vfs::File_factory> factory;
@@ -46,7 +233,7 @@ cap_to_vfs_object(L4::Cap<void> o, int *err)
     factory = L4Re::Vfs::vfs_ops->get_file_factory(proto);
 
   if (!factory)
-    factory = L4Re::Vfs::vfs_ops->get_file_factory(name.data);
+    factory = L4Re::Vfs::vfs_ops->get_file_factory(name);
 
   if (!factory)
     return Ref_ptr<L4Re::Vfs::File>();
@@ -55,6 +242,59 @@ cap_to_vfs_object(L4::Cap<void> o, int *err)
   return factory->create(o);
 }
 
+/**
+ * Look up `name` in `ns` through the cache and create a file for it.
+ */
+static int
+ns_get_entry(L4::Cap<L4Re::Namespace> ns, char const *name, unsigned len,
+             Ref_ptr<L4Re::Vfs::File> *f) throw()
+{
+  L4::Cap<void> obj;
+  Ns_cache::Type type;
+
+  if (ns_cache.query(ns, name, len, &obj, &type) < 0)
+    return -ENOENT;
+
+  bool known = type.valid;
+  int err;
+  cxx::Ref_ptr<L4Re::Vfs::File> fi = cap_to_vfs_object(obj, &err, &type);
+  if (!fi)
+    {
+      L4Re::virt_cap_alloc->release(obj, L4Re::This_task);
+      return err;
+    }
+
+  if (!known && type.valid)
+    ns_cache.set_type(ns, name, len, type);
+
+  *f = cxx::move(fi);
+  return 0;
+}
+
+/**
+ * Check whether `name` exists in `ns`, through the cache.
+ */
+static int
+ns_access(L4::Cap<L4Re::Namespace> ns, char const *name, unsigned len,
+          int mode) throw()
+{
+  L4::Cap<void> obj;
+  Ns_cache::Type type;
+
+  long err = ns_cache.query(ns, name, len, &obj, &type);
+  if (err == -ENOMEM)
+    return err;
+
+  if (err < 0)
+    return -ENOENT;
+
+  L4Re::virt_cap_alloc->release(obj, L4Re::This_task);
+
+  if (mode & W_OK)
+    return -EACCES;
+
+  return 0;
+}
 
 int
 Ns_dir::get_ds(const char *path, L4Re::Unique_cap<L4Re::Dataspace> *ds) throw()
@@ -84,37 +324,22 @@ Ns_dir::get_entry(const char *path, int flags, mode_t mode,
       return 0;
     }
 
-  L4Re::Unique_cap<Dataspace> file;
-  int err = get_ds(path, &file);
-
-  if (err < 0)
-    return -ENOENT;
-
-  cxx::Ref_ptr<L4Re::Vfs::File> fi = cap_to_vfs_object(file.get(), &err);
-  if (!fi)
-    return err;
+  return ns_get_entry(_ns, path, strlen(path), f);
+}
 
-  file.release();
-  *f = cxx::move(fi);
-  return 0;
+int
+Ns_dir::unlink(const char *path) throw()
+{
+  long err = _ns->unlink(path);
+  ns_cache.invalidate(_ns, path, strlen(path));
+  return err < 0 ? err : 0;
 }
 
 int
 Ns_dir::faccessat(const char *path, int mode, int flags) throw()
 {
   (void)flags;
-  auto tmpcap = L4Re::make_unique_cap<void>(L4Re::virt_cap_alloc);
-
-  if (!tmpcap.is_valid())
-    return -ENOMEM;
-
-  if (_ns->query(path, tmpcap.get()))
-    return -ENOENT;
-
-  if (mode & W_OK)
-    return -EACCES;
-
-  return 0;
+  return ns_access(_ns, path, strlen(path), mode);
 }
 
 int
@@ -215,8 +440,16 @@ Ns_dir::getdents(char *buf, size_t sz) throw()
 }
 
 int
-Env_dir::get_ds(const char *path, L4Re::Unique_cap<L4Re::Dataspace> *ds) throw()
+Env_dir::get_entry(const char *path, int flags, mode_t mode,
+                   Ref_ptr<L4Re::Vfs::File> *f) throw()
 {
+  (void)mode; (void)flags;
+  if (!*path)
+    {
+      *f = cxx::ref_ptr(this);
+      return 0;
+    }
+
   Vfs::Path p(path);
   Vfs::Path first = p.strip_first();
 
@@ -229,48 +462,14 @@ Env_dir::get_ds(const char *path, L4Re::Unique_cap<L4Re::Dataspace> *ds) throw()
   if (!c.is_valid())
     return -ENOENT;
 
-  if (p.empty())
-    {
-      *ds = L4Re::Unique_cap<L4Re::Dataspace>(L4::cap_reinterpret_cast<L4Re::Dataspace>(c));
-      return 0;
-    }
-
-  auto file = L4Re::make_unique_cap<L4Re::Dataspace>(L4Re::virt_cap_alloc);
-
-  if (!file.is_valid())
-    return -ENOMEM;
-
-  int err = c->query(p.path(), p.length(), file.get());
-
-  if (err < 0)
-    return -ENOENT;
-
-  *ds = cxx::move(file);
-  return err;
-}
-
-int
-Env_dir::get_entry(const char *path, int flags, mode_t mode,
-                   Ref_ptr<L4Re::Vfs::File> *f) throw()
-{
-  (void)mode; (void)flags;
-  if (!*path)
-    {
-      *f = cxx::ref_ptr(this);
-      return 0;
-    }
-
-  L4Re::Unique_cap<Dataspace> file;
-  int err = get_ds(path, &file);
+  if (!p.empty())
+    return ns_get_entry(c, p.path(), p.length(), f);
 
-  if (err < 0)
-    return -ENOENT;
-
-  cxx::Ref_ptr<L4Re::Vfs::File> fi = cap_to_vfs_object(file.get(), &err);
+  int err;
+  cxx::Ref_ptr<L4Re::Vfs::File> fi = cap_to_vfs_object(c, &err);
   if (!fi)
     return err;
 
-  file.release();
   *f = cxx::move(fi);
   return 0;
 }
@@ -299,18 +498,31 @@ Env_dir::faccessat(const char *path, int mode, int flags) throw()
       return 0;
     }
 
-  auto tmpcap = L4Re::make_unique_cap<void>(L4Re::virt_cap_alloc);
+  return ns_access(c, p.path(), p.length(), mode);
+}
 
-  if (!tmpcap.is_valid())
-    return -ENOMEM;
+int
+Env_dir::unlink(const char *path) throw()
+{
+  Vfs::Path p(path);
+  Vfs::Path first = p.strip_first();
+
+  if (first.empty())
+    return -ENOENT;
+
+  L4::Cap<L4Re::Namespace>
+    c = _env->get_cap<L4Re::Namespace>(first.path(), first.length());
 
-  if (c->query(p.path(), p.length(), tmpcap.get()))
+  if (!c.is_valid())
     return -ENOENT;
 
-  if (mode & W_OK)
-    return -EACCES;
+  // the initial capabilities cannot be removed
+  if (p.empty())
+    return -EPERM;
 
-  return 0;
+  long err = c->unlink(p.path());
+  ns_cache.invalidate(c, p.path(), p.length());
+  return err < 0 ? err : 0;
 }
 
 bool
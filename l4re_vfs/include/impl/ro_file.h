@@ -29,9 +29,12 @@ private:
   off64_t _size;
   char const *_addr;
 
+  /// File range that is known to be mapped into the local address space.
+  off64_t _mapped_start, _mapped_end;
+
 public:
   explicit Ro_file(L4::Cap<L4Re::Dataspace> ds) throw()
-  : Be_file_pos(), _ds(ds), _addr(0)
+  : Be_file_pos(), _ds(ds), _addr(0), _mapped_start(0), _mapped_end(0)
   {
     _size = _ds->size();
   }
@@ -50,9 +53,13 @@ public:
   int set_status_flags(long) throw()
   { return 0; }
 
+  int fadvise(off64_t offset, off64_t len, int advice) throw();
+
   ~Ro_file() throw();
 
 private:
+  int map_file() throw();
+  void premap(off64_t offset, off64_t len) throw();
   ssize_t read_single(const struct iovec*, off64_t) throw();
   ssize_t preadv(const struct iovec *, int, off64_t) throw();
   ssize_t pwritev(const struct iovec *, int , off64_t) throw();
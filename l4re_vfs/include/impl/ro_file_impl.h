@@ -20,6 +20,7 @@
 #include "ro_file.h"
 
 #include <sys/ioctl.h>
+#include <fcntl.h>
 
 #include <l4/re/env>
 
@@ -64,20 +65,88 @@ Ro_file::read_single(const struct iovec *vec, off64_t pos) throw()
   return 0;
 }
 
+int
+Ro_file::map_file() throw()
+{
+  if (_addr)
+    return 0;
+
+  // align large files to superpages, so that premap() can use large
+  // flexpages for them
+  unsigned char align = _size >= (off64_t)L4_SUPERPAGESIZE
+                        ? L4_SUPERPAGESHIFT : L4_PAGESHIFT;
+  void const *file = (void*)L4_PAGESIZE;
+  long err = L4Re::Env::env()->rm()->attach(&file, _size,
+                                            Rm::Search_addr | Rm::Read_only,
+                                            _ds, 0, align);
+  if (err < 0)
+    return err;
+
+  _addr = (char const *)file;
+  return 0;
+}
+
+/**
+ * Map the given range of the file in advance, instead of taking a page
+ * fault for each page when the range is copied out.
+ */
+void
+Ro_file::premap(off64_t offset, off64_t len) throw()
+{
+  off64_t s = l4_trunc_page(offset);
+  off64_t e = l4_round_page(offset + len);
+  if (e > (off64_t)l4_round_page(_size))
+    e = l4_round_page(_size);
+
+  if (s >= e || (s >= _mapped_start && e <= _mapped_end))
+    return;
+
+  if (_ds->map_region(s, L4Re::Dataspace::Map_ro, l4_addr_t(_addr) + s,
+                      l4_addr_t(_addr) + e) < 0)
+    return;
+
+  _mapped_start = s;
+  _mapped_end = e;
+}
+
+int
+Ro_file::fadvise(off64_t offset, off64_t len, int advice) throw()
+{
+  if (offset < 0 || len < 0)
+    return -EINVAL;
+
+  if (advice != POSIX_FADV_WILLNEED || offset >= _size)
+    return 0;
+
+  int err = map_file();
+  if (err < 0)
+    return err;
+
+  if (len == 0 || len > _size - offset)
+    len = _size - offset;
+
+  premap(offset, len);
+  return 0;
+}
+
 ssize_t
 Ro_file::preadv(const struct iovec *vec, int cnt, off64_t offset) throw()
 {
-  if (!_addr)
+  int err = map_file();
+  if (err < 0)
+    return err;
+
+  if (offset < _size)
     {
-      void const *file = (void*)L4_PAGESIZE;
-      long err = L4Re::Env::env()->rm()->attach(&file, _size,
-                                                Rm::Search_addr | Rm::Read_only,
-                                                _ds, 0);
+      off64_t total = 0;
+      for (int i = 0; i < cnt; ++i)
+        total += vec[i].iov_len;
 
-      if (err < 0)
-	return err;
+      if (total > _size - offset)
+        total = _size - offset;
 
-      _addr = (char const *)file;
+      if (total > (off64_t)L4_PAGESIZE)
+        premap(offset, total);
     }
 
   ssize_t l = 0;
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <l4/sys/capability>
+#include <l4/sys/kip.h>
 #include <l4/sys/vcon>
 #include <l4/sys/semaphore>
 
@@ -28,20 +29,80 @@ namespace L4Re { namespace Core {
 class Vcon_stream : public L4Re::Vfs::Be_file_stream
 {
 private:
+  enum
+  {
+    /**
+     * Buffered output older than this is sent with the next write.
+     *
+     * Nothing checks the age in between, see set_buffered().
+     */
+    Flush_timeout_us = 50000,
+  };
+
+  /**
+   * Output buffer of a buffered stream.
+   *
+   * Small writes are collected and sent with a single IPC once a line is
+   * complete, the buffer is full or the data got too old.
+   */
+  struct Obuf
+  {
+    l4_cpu_time_t since;
+    unsigned len;
+    char data[L4_VCON_WRITE_SIZE];
+  };
+
   L4::Cap<L4::Vcon> _s;
   L4::Cap<L4::Semaphore>  _irq;
+  L4::Cap<L4::Triggerable> _notifier;
+  Obuf *_obuf;
+  bool _out_lock;
+
+  void wait_input() throw();
+  void lock_out() throw();
+  void unlock_out() throw();
+  void send(char const *b, unsigned long len) throw();
+  void flush_locked() throw();
+  ssize_t send_iov(const struct iovec *iovec, int iovcnt) throw();
 
 public:
   explicit Vcon_stream(L4::Cap<L4::Vcon> s) throw();
 
+  /**
+   * Switch buffering of output on or off.
+   *
+   * Switching it off sends all buffered output. Writes from all threads
+   * keep their order either way.
+   *
+   * \note There is no timer behind Flush_timeout_us. A partial line stays
+   *       in the buffer until the next write, a read, fsync() or until
+   *       buffering is switched off, however long that takes. Programs
+   *       that print a prompt or progress without a newline and then block
+   *       on something other than this stream must call fsync().
+   */
+  void set_buffered(bool on) throw();
+
+  /// Send all buffered output.
+  void flush() throw();
+
+  /**
+   * Write without buffering.
+   *
+   * Buffered output is sent first, so the order of all writes is kept.
+   */
+  ssize_t writev_unbuffered(const struct iovec *iovec, int iovcnt) throw();
+
   ssize_t readv(const struct iovec*, int iovcnt) throw();
   ssize_t writev(const struct iovec*, int iovcnt) throw();
+  int fsync() const throw();
   int fstat64(struct stat64 *buf) const throw();
   int get_status_flags() const throw() { return O_RDWR; }
   int set_status_flags(long) throw() { return 0; }
   int ioctl(unsigned long request, va_list args) throw();
+  int check_ready(int events) throw();
+  int set_ready_notifier(L4::Cap<L4::Triggerable> irq) throw();
 
-  ~Vcon_stream() throw() {}
+  ~Vcon_stream() throw() { set_buffered(false); }
   void operator delete (void *) {}
 };
 
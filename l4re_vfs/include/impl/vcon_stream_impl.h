@@ -17,7 +17,9 @@
  */
 
 #include <l4/re/env>
+#include <l4/re/env.h>
 #include <l4/sys/factory>
+#include <l4/sys/thread.h>
 
 #include "vcon_stream.h"
 
@@ -28,7 +30,8 @@
 
 namespace L4Re { namespace Core {
 Vcon_stream::Vcon_stream(L4::Cap<L4::Vcon> s) throw()
-: Be_file_stream(), _s(s), _irq(L4Re::virt_cap_alloc->alloc<L4::Semaphore>())
+: Be_file_stream(), _s(s), _irq(L4Re::virt_cap_alloc->alloc<L4::Semaphore>()),
+  _notifier(L4::Cap<L4::Triggerable>::Invalid), _obuf(0), _out_lock(false)
 {
   //printf("VCON: irq cap = %lx\n", _irq.cap());
   int res = l4_error(L4Re::Env::env()->factory()->create(_irq));
@@ -44,6 +47,10 @@ Vcon_stream::Vcon_stream(L4::Cap<L4::Vcon> s) throw()
 ssize_t
 Vcon_stream::readv(const struct iovec *iovec, int iovcnt) throw()
 {
+  // make a prompt visible before waiting for input
+  if (_obuf)
+    flush();
+
   ssize_t bytes = 0;
   for (; iovcnt > 0; --iovcnt, ++iovec)
     {
@@ -73,7 +80,7 @@ Vcon_stream::readv(const struct iovec *iovec, int iovcnt) throw()
 		return ret;
 	      else if (ret == 0)
 		{
-		  _irq->down();
+		  wait_input();
 		  continue;
 		}
 	    }
@@ -90,35 +97,218 @@ Vcon_stream::readv(const struct iovec *iovec, int iovcnt) throw()
   return bytes;
 }
 
-ssize_t
-Vcon_stream::writev(const struct iovec *iovec, int iovcnt) throw()
+void
+Vcon_stream::wait_input() throw()
+{
+  if (!_notifier.is_valid())
+    {
+      _irq->down();
+      return;
+    }
+
+  // Input events go to the notifier of a waiter in select or poll. Take
+  // them back while blocking in read and pass one on afterwards, as the
+  // notifier might have missed input in the meantime.
+  _s->bind(0, _irq);
+  if (_s->read(0, 0) == 0)
+    _irq->down();
+
+  _s->bind(0, _notifier);
+  _notifier->trigger();
+}
+
+namespace {
+
+/**
+ * Keep the message registers a vcon send clobbers.
+ *
+ * Output may happen while a message is being composed, so the registers
+ * are restored afterwards. Only the words a send of `len` bytes uses are
+ * saved.
+ */
+class Vcon_mr_save
+{
+public:
+  explicit Vcon_mr_save(unsigned long len) throw()
+  : _mr(l4_utcb_mr())
+  {
+    if (len > L4_VCON_WRITE_SIZE)
+      len = L4_VCON_WRITE_SIZE;
+    _words = 2 + (len + sizeof(l4_umword_t) - 1) / sizeof(l4_umword_t);
+    Vfs_config::memcpy(_store, _mr->mr, _words * sizeof(l4_umword_t));
+  }
+
+  ~Vcon_mr_save() throw()
+  { Vfs_config::memcpy(_mr->mr, _store, _words * sizeof(l4_umword_t)); }
+
+private:
+  l4_msg_regs_t *_mr;
+  unsigned _words;
+  l4_umword_t _store[L4_UTCB_GENERIC_DATA_SIZE];
+};
+
+}
+
+void
+Vcon_stream::lock_out() throw()
+{
+  while (__atomic_test_and_set(&_out_lock, __ATOMIC_ACQUIRE))
+    l4_thread_yield();
+}
+
+void
+Vcon_stream::unlock_out() throw()
+{
+  __atomic_clear(&_out_lock, __ATOMIC_RELEASE);
+}
+
+void
+Vcon_stream::send(char const *b, unsigned long len) throw()
 {
-  l4_msg_regs_t store;
-  l4_msg_regs_t *mr = l4_utcb_mr();
+  for (; len > L4_VCON_WRITE_SIZE
+       ; len -= L4_VCON_WRITE_SIZE, b += L4_VCON_WRITE_SIZE)
+    _s->send(b, L4_VCON_WRITE_SIZE);
+
+  _s->send(b, len);
+}
 
-  Vfs_config::memcpy(&store, mr, sizeof(store));
+void
+Vcon_stream::flush_locked() throw()
+{
+  if (!_obuf || !_obuf->len)
+    return;
 
+  Vcon_mr_save mrs(_obuf->len);
+  send(_obuf->data, _obuf->len);
+  _obuf->len = 0;
+}
+
+void
+Vcon_stream::flush() throw()
+{
+  lock_out();
+  flush_locked();
+  unlock_out();
+}
+
+void
+Vcon_stream::set_buffered(bool on) throw()
+{
+  lock_out();
+  if (on && !_obuf)
+    {
+      _obuf = static_cast<Obuf *>(Vfs_config::malloc(sizeof(Obuf)));
+      if (_obuf)
+        _obuf->len = 0;
+    }
+  else if (!on && _obuf)
+    {
+      flush_locked();
+      Vfs_config::free(_obuf);
+      _obuf = 0;
+    }
+  unlock_out();
+}
+
+ssize_t
+Vcon_stream::send_iov(const struct iovec *iovec, int iovcnt) throw()
+{
   ssize_t written = 0;
-  while (iovcnt)
+  unsigned long max = 0;
+  for (int i = 0; i < iovcnt; ++i)
+    if (iovec[i].iov_len > max)
+      max = iovec[i].iov_len;
+
+  Vcon_mr_save mrs(max);
+  for (; iovcnt; ++iovec, --iovcnt)
     {
-      size_t sl = iovec->iov_len;
-      char const *b = (char const *)iovec->iov_base;
+      send((char const *)iovec->iov_base, iovec->iov_len);
+      written += iovec->iov_len;
+    }
 
-      for (; sl > L4_VCON_WRITE_SIZE
-           ; sl -= L4_VCON_WRITE_SIZE, b += L4_VCON_WRITE_SIZE)
-        _s->send(b, L4_VCON_WRITE_SIZE);
+  return written;
+}
 
-      _s->send(b, sl);
+ssize_t
+Vcon_stream::writev_unbuffered(const struct iovec *iovec, int iovcnt) throw()
+{
+  lock_out();
+  if (_obuf)
+    flush_locked();
+  ssize_t written = send_iov(iovec, iovcnt);
+  unlock_out();
+  return written;
+}
 
-      written += iovec->iov_len;
+ssize_t
+Vcon_stream::writev(const struct iovec *iovec, int iovcnt) throw()
+{
+  ssize_t written = 0;
+
+  lock_out();
+  if (!_obuf)
+    {
+      written = send_iov(iovec, iovcnt);
+      unlock_out();
+      return written;
+    }
 
-      ++iovec;
-      --iovcnt;
+  l4_cpu_time_t now = l4_kip_clock(l4re_kip());
+  if (_obuf->len && now - _obuf->since > Flush_timeout_us)
+    flush_locked();
+
+  bool newline = false;
+  for (; iovcnt; ++iovec, --iovcnt)
+    {
+      unsigned long sl = iovec->iov_len;
+      char const *b = (char const *)iovec->iov_base;
+      written += sl;
+
+      if (sl >= sizeof(_obuf->data))
+        {
+          // too large to gain anything from buffering
+          flush_locked();
+          Vcon_mr_save mrs(sl);
+          send(b, sl);
+          continue;
+        }
+
+      for (unsigned long i = 0; i < sl && !newline; ++i)
+        newline = b[i] == '\n';
+
+      while (sl)
+        {
+          unsigned long n = sizeof(_obuf->data) - _obuf->len;
+          if (n > sl)
+            n = sl;
+
+          if (!_obuf->len)
+            _obuf->since = now;
+
+          Vfs_config::memcpy(_obuf->data + _obuf->len, b, n);
+          _obuf->len += n;
+          b += n;
+          sl -= n;
+
+          if (_obuf->len == sizeof(_obuf->data))
+            flush_locked();
+        }
     }
-  Vfs_config::memcpy(mr, &store, sizeof(store));
+
+  if (newline)
+    flush_locked();
+
+  unlock_out();
   return written;
 }
 
+int
+Vcon_stream::fsync() const throw()
+{
+  const_cast<Vcon_stream *>(this)->flush();
+  return 0;
+}
+
 int
 Vcon_stream::fstat64(struct stat64 *buf) const throw()
 {
@@ -129,6 +319,38 @@ Vcon_stream::fstat64(struct stat64 *buf) const throw()
   return 0;
 }
 
+int
+Vcon_stream::check_ready(int events) throw()
+{
+  int ready = events & POLLOUT;
+  if (events & POLLIN)
+    {
+      // a zero-sized read only reports whether input is pending
+      int ret = _s->read(0, 0);
+      if (ret < 0)
+        return ready | POLLERR;
+      if (ret > 0)
+        ready |= POLLIN;
+    }
+
+  return ready;
+}
+
+int
+Vcon_stream::set_ready_notifier(L4::Cap<L4::Triggerable> irq) throw()
+{
+  L4::Cap<L4::Triggerable> target = _irq;
+  if (irq.is_valid())
+    target = irq;
+
+  int res = l4_error(_s->bind(0, target));
+  if (res < 0)
+    return res;
+
+  _notifier = irq;
+  return 0;
+}
+
 int
 Vcon_stream::ioctl(unsigned long request, va_list args) throw()
 {
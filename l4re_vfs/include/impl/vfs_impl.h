@@ -26,7 +26,9 @@
 #include <l4/re/rm>
 #include <l4/re/dataspace>
 #include <l4/cxx/hlist>
+#include <l4/cxx/minmax>
 #include <l4/cxx/std_alloc>
+#include <l4/sys/thread.h>
 
 #include <l4/l4re_vfs/backend>
 #include <l4/re/shared_cap>
@@ -68,7 +70,75 @@ public:
 class Std_stream : public L4Re::Core::Vcon_stream
 {
 public:
-  Std_stream(L4::Cap<L4::Vcon> c) : L4Re::Core::Vcon_stream(c) {}
+  Std_stream(L4::Cap<L4::Vcon> c)
+  : L4Re::Core::Vcon_stream(c), _probed(false)
+  {}
+
+  /**
+   * The first write decides whether output gets buffered. The environment
+   * might not be set up yet when the stream is created.
+   */
+  ssize_t writev(const struct iovec *iov, int iovcnt) throw()
+  {
+    if (L4_UNLIKELY(!_probed)
+        && !__atomic_exchange_n(&_probed, true, __ATOMIC_RELAXED))
+      {
+        _self = this;
+        if (Vfs_config::log_buffered(&at_exit))
+          set_buffered(true);
+      }
+
+    return L4Re::Core::Vcon_stream::writev(iov, iovcnt);
+  }
+
+private:
+  // output written while exiting is not buffered anymore
+  static void at_exit() { _self->set_buffered(false); }
+
+  static Std_stream *_self;
+  bool _probed;
+};
+
+Std_stream *Std_stream::_self;
+
+/**
+ * Standard error on the stream of stdin and stdout.
+ *
+ * Writes are never buffered, so messages of a program that aborts or gets
+ * killed are not lost. Everything else goes to the shared stream, which
+ * has the only input notification of the vcon.
+ */
+class Std_err : public L4Re::Vfs::Be_file_stream
+{
+public:
+  explicit Std_err(Std_stream *s) : _s(s) {}
+
+  ssize_t readv(const struct iovec *iov, int iovcnt) throw()
+  { return _s->readv(iov, iovcnt); }
+
+  ssize_t writev(const struct iovec *iov, int iovcnt) throw()
+  { return _s->writev_unbuffered(iov, iovcnt); }
+
+  int fsync() const throw() { return _s->fsync(); }
+
+  int fstat64(struct stat64 *buf) const throw()
+  { return _s->fstat64(buf); }
+
+  int get_status_flags() const throw() { return _s->get_status_flags(); }
+  int set_status_flags(long f) throw() { return _s->set_status_flags(f); }
+
+  int ioctl(unsigned long request, va_list args) throw()
+  { return _s->ioctl(request, args); }
+
+  int check_ready(int events) throw() { return _s->check_ready(events); }
+
+  int set_ready_notifier(L4::Cap<L4::Triggerable> irq) throw()
+  { return _s->set_ready_notifier(irq); }
+
+  void operator delete (void *) {}
+
+private:
+  Std_stream *_s;
 };
 
 Fd_store::Fd_store() throw()
@@ -76,12 +146,327 @@ Fd_store::Fd_store() throw()
   // use this strange way to prevent deletion of the stdio object
   // this depends on Fd_store to being a singleton !!!
   static char m[sizeof(Std_stream)] __attribute__((aligned(sizeof(long))));
+  static char me[sizeof(Std_err)] __attribute__((aligned(sizeof(long))));
   Std_stream *s = new (m) Std_stream(L4Re::Env::env()->log());
+  Std_err *e = new (me) Std_err(s);
   // make sure that we never delete the static io stream thing
   s->add_ref();
+  e->add_ref();
   set(0, cxx::ref_ptr(s)); // stdin
   set(1, cxx::ref_ptr(s)); // stdout
-  set(2, cxx::ref_ptr(s)); // stderr
+  set(2, cxx::ref_ptr(e)); // stderr
+}
+
+/**
+ * Free space of the pool dataspaces used for anonymous memory.
+ *
+ * Each pool keeps a bitmap with one bit per page, set for used pages.
+ * Pages are returned when the memory is unmapped, so programs that map and
+ * unmap anonymous memory all the time reuse their pools instead of leaking
+ * address space. The arena must not allocate memory itself as malloc()
+ * calls mmap(), the bitmap lives in the first pages of the pool dataspace.
+ * Pools are never replaced, once all slots are taken anonymous memory gets
+ * dataspaces of its own.
+ *
+ * The arena also knows which memory is anonymous, i.e. may be dropped by
+ * madvise(): pool pages that do not hold a private copy of a file, see
+ * mark_copy(), and dataspaces of their own recorded with add_anon_ds().
+ */
+class Anon_arena
+{
+public:
+  enum
+  {
+    Max_pools   = 4,
+    Max_anon_ds = 32,
+  };
+
+  Anon_arena() : _lock(false) {}
+
+  /// Size of the bitmaps at the start of a pool of `size` bytes.
+  static unsigned long map_size(unsigned long size) throw()
+  { return l4_round_page(2 * (size >> L4_PAGESHIFT) / 8); }
+
+  /// Check whether add_pool() can take another pool.
+  bool has_free_slot() throw();
+
+  bool alloc(l4_umword_t size, L4Re::Shared_cap<L4Re::Dataspace> *ds,
+             l4_addr_t *offset) throw();
+
+  /**
+   * Add a pool dataspace.
+   *
+   * \param ds    The pool dataspace.
+   * \param size  Size of the pool in bytes.
+   * \param map   The bitmap, the first map_size() bytes of the pool
+   *              attached writable. Must read as zero.
+   * \param used  Bytes at the start of the pool that are in use, including
+   *              the bitmap.
+   *
+   * \retval true   The pool was added.
+   * \retval false  All slots are taken.
+   */
+  bool add_pool(L4Re::Shared_cap<L4Re::Dataspace> const &ds,
+                l4_umword_t size, l4_umword_t *map, l4_umword_t used) throw();
+  void free(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+            unsigned long size) throw();
+
+  /// Record that pool memory holds a private copy of a file.
+  void mark_copy(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+                 unsigned long size) throw();
+
+  /**
+   * Record a dataspace of its own that holds anonymous memory.
+   *
+   * Dataspaces that do not fit into the table are not recorded, madvise()
+   * then keeps their pages.
+   */
+  void add_anon_ds(L4::Cap<L4Re::Dataspace> ds) throw();
+
+  /// Forget `ds` before its capability slot gets reused.
+  void forget_ds(L4::Cap<L4Re::Dataspace> ds) throw();
+
+  /// Check whether the given part of `ds` is known to be anonymous memory.
+  bool is_anon(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+               unsigned long size) throw();
+
+private:
+  enum { Bpw = sizeof(l4_umword_t) * 8 };
+
+  struct Pool
+  {
+    L4Re::Shared_cap<L4Re::Dataspace> ds;
+    /// Bitmap of used pages.
+    l4_umword_t *map;
+    /// Bitmap of pages that hold a private copy of a file.
+    l4_umword_t *copy;
+    unsigned long pages;
+    unsigned long free;
+  };
+
+  void lock() throw()
+  {
+    while (__atomic_test_and_set(&_lock, __ATOMIC_ACQUIRE))
+      l4_thread_yield();
+  }
+
+  void unlock() throw()
+  { __atomic_clear(&_lock, __ATOMIC_RELEASE); }
+
+  static bool test(l4_umword_t const *map, unsigned long page) throw()
+  { return map[page / Bpw] & (l4_umword_t(1) << (page % Bpw)); }
+
+  static bool find(Pool const *p, unsigned long n,
+                   unsigned long *first) throw();
+  static void mark(l4_umword_t *map, unsigned long first, unsigned long n,
+                   bool set) throw();
+
+  Pool *pool(L4::Cap<L4Re::Dataspace> ds) throw()
+  {
+    for (Pool &p: _pools)
+      if (p.ds.is_valid() && p.ds.cap() == ds.cap())
+        return &p;
+    return 0;
+  }
+
+  Pool _pools[Max_pools];
+  L4::Cap<L4Re::Dataspace> _anon_ds[Max_anon_ds];
+  bool _lock;
+};
+
+/**
+ * Find the first run of `n` free pages in a pool.
+ */
+bool
+Anon_arena::find(Pool const *p, unsigned long n, unsigned long *first) throw()
+{
+  unsigned long run = 0;
+  for (unsigned long i = 0; i < p->pages; ++i)
+    {
+      // skip whole words that are completely used or free
+      if (!(i % Bpw) && i + Bpw <= p->pages)
+        {
+          l4_umword_t w = p->map[i / Bpw];
+          if (w == ~l4_umword_t(0))
+            {
+              run = 0;
+              i += Bpw - 1;
+              continue;
+            }
+
+          if (!w)
+            {
+              run += Bpw;
+              i += Bpw - 1;
+              if (run >= n)
+                {
+                  *first = i + 1 - run;
+                  return true;
+                }
+              continue;
+            }
+        }
+
+      if (test(p->map, i))
+        run = 0;
+      else if (++run == n)
+        {
+          *first = i + 1 - n;
+          return true;
+        }
+    }
+
+  return false;
+}
+
+void
+Anon_arena::mark(l4_umword_t *map, unsigned long first, unsigned long n,
+                 bool set) throw()
+{
+  for (unsigned long i = first; i < first + n; ++i)
+    {
+      l4_umword_t b = l4_umword_t(1) << (i % Bpw);
+      if (set)
+        map[i / Bpw] |= b;
+      else
+        map[i / Bpw] &= ~b;
+    }
+}
+
+bool
+Anon_arena::has_free_slot() throw()
+{
+  lock();
+  bool res = false;
+  for (Pool &p: _pools)
+    if (!p.ds.is_valid())
+      res = true;
+  unlock();
+  return res;
+}
+
+bool
+Anon_arena::alloc(l4_umword_t size, L4Re::Shared_cap<L4Re::Dataspace> *ds,
+                  l4_addr_t *offset) throw()
+{
+  unsigned long n = size >> L4_PAGESHIFT;
+  unsigned long first;
+
+  lock();
+  for (Pool &p: _pools)
+    {
+      // first fit keeps the used part of the pool compact
+      if (!p.ds.is_valid() || p.free < n || !find(&p, n, &first))
+        continue;
+
+      mark(p.map, first, n, true);
+      p.free -= n;
+      *offset = first << L4_PAGESHIFT;
+      *ds = p.ds;
+      unlock();
+      return true;
+    }
+
+  unlock();
+  return false;
+}
+
+bool
+Anon_arena::add_pool(L4Re::Shared_cap<L4Re::Dataspace> const &ds,
+                     l4_umword_t size, l4_umword_t *map,
+                     l4_umword_t used) throw()
+{
+  lock();
+  for (Pool &p: _pools)
+    {
+      if (p.ds.is_valid())
+        continue;
+
+      p.ds = ds;
+      p.map = map;
+      p.pages = size >> L4_PAGESHIFT;
+      p.copy = map + p.pages / Bpw;
+      mark(p.map, 0, used >> L4_PAGESHIFT, true);
+      p.free = p.pages - (used >> L4_PAGESHIFT);
+      unlock();
+      return true;
+    }
+
+  unlock();
+  return false;
+}
+
+void
+Anon_arena::free(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+                 unsigned long size) throw()
+{
+  lock();
+  if (Pool *p = pool(ds))
+    {
+      mark(p->map, offset >> L4_PAGESHIFT, size >> L4_PAGESHIFT, false);
+      mark(p->copy, offset >> L4_PAGESHIFT, size >> L4_PAGESHIFT, false);
+      p->free += size >> L4_PAGESHIFT;
+    }
+  unlock();
+}
+
+void
+Anon_arena::mark_copy(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+                      unsigned long size) throw()
+{
+  lock();
+  if (Pool *p = pool(ds))
+    mark(p->copy, offset >> L4_PAGESHIFT, size >> L4_PAGESHIFT, true);
+  unlock();
+}
+
+void
+Anon_arena::add_anon_ds(L4::Cap<L4Re::Dataspace> ds) throw()
+{
+  lock();
+  if (!pool(ds))
+    for (L4::Cap<L4Re::Dataspace> &a: _anon_ds)
+      if (!a.is_valid())
+        {
+          a = ds;
+          break;
+        }
+  unlock();
+}
+
+void
+Anon_arena::forget_ds(L4::Cap<L4Re::Dataspace> ds) throw()
+{
+  lock();
+  for (L4::Cap<L4Re::Dataspace> &a: _anon_ds)
+    if (a.cap() == ds.cap())
+      a = L4::Cap<L4Re::Dataspace>::Invalid;
+  unlock();
+}
+
+bool
+Anon_arena::is_anon(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+                    unsigned long size) throw()
+{
+  bool res = false;
+  lock();
+  if (Pool *p = pool(ds))
+    {
+      res = true;
+      unsigned long end = (offset + size + L4_PAGESIZE - 1) >> L4_PAGESHIFT;
+      for (unsigned long i = offset >> L4_PAGESHIFT; i < end; ++i)
+        if (test(p->copy, i))
+          {
+            res = false;
+            break;
+          }
+    }
+  else
+    for (L4::Cap<L4Re::Dataspace> const &a: _anon_ds)
+      if (a.is_valid() && a.cap() == ds.cap())
+        res = true;
+  unlock();
+  return res;
 }
 
 class Root_mount_tree : public L4Re::Vfs::Mount_tree
@@ -170,12 +555,16 @@ private:
 
   cxx::H_list_t<File_factory_item> _file_factories;
 
-  l4_addr_t _anon_offset;
-  L4Re::Shared_cap<L4Re::Dataspace> _anon_ds;
+  Anon_arena _anon;
 
+  int drop_pages(l4_addr_t a, l4_addr_t end) throw();
   int alloc_ds(unsigned long size, L4Re::Shared_cap<L4Re::Dataspace> *ds);
   int alloc_anon_mem(l4_umword_t size, L4Re::Shared_cap<L4Re::Dataspace> *ds,
                      l4_addr_t *offset);
+  int add_anon_pool(unsigned long pool_size, l4_umword_t size,
+                    L4Re::Shared_cap<L4Re::Dataspace> *ds, l4_addr_t *offset);
+  void free_anon_mem(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+                     l4_umword_t size, bool dirty) throw();
 };
 
 static inline bool strequal(char const *a, char const *b)
@@ -313,26 +702,13 @@ Vfs::get_file_factory(char const *proto_name) throw()
 int
 Vfs::alloc_fd(Ref_ptr<L4Re::Vfs::File> const &f) throw()
 {
-  int fd = fds.alloc();
-  if (fd < 0)
-    return -EMFILE;
-
-  if (f)
-    fds.set(fd, f);
-
-  return fd;
+  return fds.alloc(f);
 }
 
 Ref_ptr<L4Re::Vfs::File>
 Vfs::free_fd(int fd) throw()
 {
-  Ref_ptr<L4Re::Vfs::File> f = fds.get(fd);
-
-  if (!f)
-    return Ref_ptr<>::Nil;
-
-  fds.free(fd);
-  return f;
+  return fds.free(fd);
 }
 
 
@@ -365,8 +741,10 @@ Vfs::get_file(int fd) throw()
 Ref_ptr<L4Re::Vfs::File>
 Vfs::set_fd(int fd, Ref_ptr<L4Re::Vfs::File> const &f) throw()
 {
-  Ref_ptr<L4Re::Vfs::File> old = fds.get(fd);
-  fds.set(fd, f);
+  Ref_ptr<L4Re::Vfs::File> old;
+  if (fds.set(fd, f, &old) < 0)
+    return Ref_ptr<>::Nil;
+
   return old;
 }
 
@@ -403,10 +781,29 @@ Vfs::munmap(void *start, size_t len) L4_NOTHROW
 	  outhex32(len);
 	  outstring("\n");
       });
+
+      // detach() looks up the same region, remember where it points to so
+      // that anonymous memory can be reused afterwards
+      l4_addr_t ra = l4_addr_t(start);
+      unsigned long rs = len;
+      l4_addr_t ro;
+      unsigned rf;
+      Cap<Dataspace> rds;
+      bool anon = r->find(&ra, &rs, &ro, &rf, &rds) >= 0
+                  && !(rf & Rm::In_area) && (rf & Rm::Detach_free);
+
       err = r->detach(l4_addr_t(start), len, &ds, This_task);
       if (err < 0)
 	return err;
 
+      if (anon)
+        {
+          // Detach_free already cleared the pages
+          l4_addr_t b = cxx::max(ra, l4_addr_t(start));
+          l4_addr_t e = cxx::min(ra + rs, l4_addr_t(start) + len);
+          _anon.free(rds, ro + (b - ra), e - b);
+        }
+
       switch (err & Rm::Detach_result_mask)
 	{
 	case Rm::Split_ds:
@@ -415,7 +812,10 @@ Vfs::munmap(void *start, size_t len) L4_NOTHROW
 	  return 0;
 	case Rm::Detached_ds:
 	  if (ds.is_valid())
-	    L4Re::virt_cap_alloc->release(ds);
+	    {
+	      _anon.forget_ds(ds);
+	      L4Re::virt_cap_alloc->release(ds);
+	    }
 	  break;
 	default:
 	  break;
@@ -467,7 +867,15 @@ Vfs::alloc_anon_mem(l4_umword_t size, L4Re::Shared_cap<L4Re::Dataspace> *ds,
   };
 #endif
 
-  if (size >= ANON_MEM_MAX_SIZE)
+  if (size < ANON_MEM_MAX_SIZE && !_anon.alloc(size, ds, offset)
+      && _anon.has_free_slot())
+    {
+      int err = add_anon_pool(ANON_MEM_DS_POOL_SIZE, size, ds, offset);
+      if (err < 0)
+        return err;
+    }
+
+  if (!ds->is_valid())
     {
       int err;
       if ((err = alloc_ds(size, ds)) < 0)
@@ -481,29 +889,68 @@ Vfs::alloc_anon_mem(l4_umword_t size, L4Re::Shared_cap<L4Re::Dataspace> *ds,
       return (*ds)->allocate(0, size);
     }
 
-  if (!_anon_ds.is_valid() || _anon_offset + size >= ANON_MEM_DS_POOL_SIZE)
+  if (_early_oom)
     {
-      int err;
-      if ((err = alloc_ds(ANON_MEM_DS_POOL_SIZE, ds)) < 0)
-        return err;
-
-      _anon_offset = 0;
-      _anon_ds = *ds;
+      if (int err = (*ds)->allocate(*offset, size))
+        {
+          _anon.free(ds->get(), *offset, size);
+          return err;
+        }
     }
-  else
-    *ds = _anon_ds;
 
-  if (_early_oom)
+  return 0;
+}
+
+/**
+ * Create a new pool for anonymous memory and allocate `size` bytes from it.
+ *
+ * \a ds stays invalid if all pool slots were taken in the meantime.
+ */
+int
+Vfs::add_anon_pool(unsigned long pool_size, l4_umword_t size,
+                   L4Re::Shared_cap<L4Re::Dataspace> *ds, l4_addr_t *offset)
+{
+  L4Re::Shared_cap<L4Re::Dataspace> pool;
+  int err;
+  if ((err = alloc_ds(pool_size, &pool)) < 0)
+    return err;
+
+  // the bitmap of the pool lives in its first pages
+  L4::Cap<Rm> r = L4Re::Env::env()->rm();
+  unsigned long map_size = Anon_arena::map_size(pool_size);
+  l4_addr_t map = 0;
+  err = r->attach(&map, map_size, Rm::Search_addr,
+                  L4::Ipc::make_cap_rw(pool.get()));
+  if (err < 0)
+    return err;
+
+  if (!_anon.add_pool(pool, pool_size, reinterpret_cast<l4_umword_t *>(map),
+                      map_size + size))
     {
-      if (int err = (*ds)->allocate(_anon_offset, size))
-        return err;
+      r->detach(map, 0);
+      return 0;
     }
 
-  *offset = _anon_offset;
-  _anon_offset += size;
+  *ds = pool;
+  *offset = map_size;
   return 0;
 }
 
+/**
+ * Give anonymous memory that never got attached back to the arena.
+ *
+ * \param dirty  The memory was written and must be cleared first.
+ */
+void
+Vfs::free_anon_mem(L4::Cap<L4Re::Dataspace> ds, l4_addr_t offset,
+                   l4_umword_t size, bool dirty) throw()
+{
+  if (dirty)
+    ds->clear(offset, size);
+
+  _anon.free(ds, offset, size);
+}
+
 int
 Vfs::mmap2(void *start, size_t len, int prot, int flags, int fd, off_t _offset,
            void **resptr) L4_NOTHROW
@@ -539,23 +986,14 @@ Vfs::mmap2(void *start, size_t len, int prot, int flags, int fd, off_t _offset,
   l4_addr_t anon_offset = 0;
   unsigned rm_flags = 0;
 
-  if (flags & (MAP_ANONYMOUS | MAP_PRIVATE))
-    {
-      rm_flags |= L4Re::Rm::Detach_free;
-
-      int err = alloc_anon_mem(size, &ds, &anon_offset);
-      if (err)
-	return err;
-
-      DEBUG_LOG(debug_mmap, {
-	  outstring("USE ANON MEM: ");
-	  outhex32(ds.cap());
-	  outstring(" offs=");
-	  outhex32(anon_offset);
-	  outstring("\n");
-      });
-    }
+  // Read-only file mappings, private or shared, attach the file's data
+  // space directly. Nobody can write to them (see mprotect), so a private
+  // copy is only needed for writable private mappings.
+  bool direct = !(flags & MAP_ANONYMOUS) && !(prot & PROT_WRITE);
+  bool anon = !direct && (flags & (MAP_ANONYMOUS | MAP_PRIVATE));
 
+  // check the file before allocating anything for the mapping
+  L4::Cap<L4Re::Dataspace> file_ds;
   if (!(flags & MAP_ANONYMOUS))
     {
       Ref_ptr<L4Re::Vfs::File> fi = fds.get(fd);
@@ -564,28 +1002,54 @@ Vfs::mmap2(void *start, size_t len, int prot, int flags, int fd, off_t _offset,
 	  return -EBADF;
 	}
 
-      L4::Cap<L4Re::Dataspace> fds = fi->data_space();
+      file_ds = fi->data_space();
 
-      if (!fds.is_valid())
+      if (!file_ds.is_valid())
 	{
 	  return -EINVAL;
 	}
 
-      if (size + offset > l4_round_page(fds->size()))
+      if (size + offset > l4_round_page(file_ds->size()))
 	{
 	  return -EINVAL;
 	}
+    }
+
+  if (anon)
+    {
+      rm_flags |= L4Re::Rm::Detach_free;
+
+      int err = alloc_anon_mem(size, &ds, &anon_offset);
+      if (err)
+	return err;
 
-      if (flags & MAP_PRIVATE)
+      DEBUG_LOG(debug_mmap, {
+	  outstring("USE ANON MEM: ");
+	  outhex32(ds.cap());
+	  outstring(" offs=");
+	  outhex32(anon_offset);
+	  outstring("\n");
+      });
+    }
+
+  // the anonymous memory holds a copy of the file from here on, it must be
+  // cleared before it goes back to the arena
+  bool copied = false;
+  if (!(flags & MAP_ANONYMOUS))
+    {
+      if (anon)
 	{
 	  DEBUG_LOG(debug_mmap, outstring("COW\n"););
-	  ds->copy_in(anon_offset, fds, l4_trunc_page(offset), l4_round_page(size));
+	  ds->copy_in(anon_offset, file_ds, l4_trunc_page(offset),
+	              l4_round_page(size));
+	  _anon.mark_copy(ds.get(), anon_offset, size);
 	  offset = anon_offset;
+	  copied = true;
 	}
       else
 	{
-          L4Re::virt_cap_alloc->take(fds);
-          ds = L4Re::Shared_cap<L4Re::Dataspace>(fds, L4Re::virt_cap_alloc);
+          L4Re::virt_cap_alloc->take(file_ds);
+          ds = L4Re::Shared_cap<L4Re::Dataspace>(file_ds, L4Re::virt_cap_alloc);
 	}
     }
   else
@@ -612,7 +1076,13 @@ Vfs::mmap2(void *start, size_t len, int prot, int flags, int fd, off_t _offset,
 
       err = munmap(start, len);
       if (err && err != -ENOENT)
-	return err;
+	{
+	  if (overmap_area != L4_INVALID_ADDR)
+	    r->free_area(overmap_area);
+	  if (anon)
+	    free_anon_mem(ds.get(), anon_offset, size, copied);
+	  return err;
+	}
     }
 
   if (!(flags & MAP_FIXED))  rm_flags |= Rm::Search_addr;
@@ -643,10 +1113,17 @@ Vfs::mmap2(void *start, size_t len, int prot, int flags, int fd, off_t _offset,
     r->free_area(overmap_area);
 
   if (err < 0)
-    return err;
+    {
+      if (anon)
+        free_anon_mem(ds.get(), anon_offset, size, copied);
+      return err;
+    }
 
   l4_assert (!(start && !data));
 
+  if (anon && !copied)
+    _anon.add_anon_ds(ds.get());
+
   // release ownership of the attached DS
   ds.release();
   *resptr = data;
@@ -841,7 +1318,10 @@ Vfs::mremap(void *old_addr, size_t old_size, size_t new_size, int flags,
               break;
             case Rm::Detached_ds:
               if (ds.is_valid())
-                L4Re::virt_cap_alloc->release(ds);
+                {
+                  _anon.forget_ds(ds);
+                  L4Re::virt_cap_alloc->release(ds);
+                }
               break;
             default:
               break;
@@ -862,7 +1342,12 @@ Vfs::mremap(void *old_addr, size_t old_size, size_t new_size, int flags,
       err = r->attach(&pad_addr, pad_sz, Rm::In_area | Rm::Detach_free,
                       L4::Ipc::make_cap_rw(tds.get()), toffs);
       if (err < 0)
-        return err;
+        {
+          free_anon_mem(tds.get(), toffs, pad_sz, false);
+          return err;
+        }
+
+      _anon.add_anon_ds(tds.get());
 
       // release ownership of tds, the region map is now the new owner
       tds.release();
@@ -884,8 +1369,71 @@ Vfs::msync(void *, size_t, int) L4_NOTHROW
 { return 0; }
 
 int
-Vfs::madvise(void *, size_t, int) L4_NOTHROW
-{ return 0; }
+Vfs::madvise(void *addr, size_t len, int advice) L4_NOTHROW
+{
+  using namespace L4Re;
+
+  switch (advice)
+    {
+    case MADV_DONTNEED:
+#ifdef MADV_FREE
+    case MADV_FREE:
+#endif
+      break;
+    default:
+      return 0;
+    }
+
+  l4_addr_t a = l4_trunc_page(l4_addr_t(addr));
+  l4_addr_t end = l4_round_page(l4_addr_t(addr) + len);
+  return drop_pages(a, end);
+}
+
+/**
+ * Release the pages of all anonymous mappings in [a, end).
+ *
+ * The pages read as zero afterwards. Other mappings, private copies of
+ * files included, keep their content.
+ */
+int
+Vfs::drop_pages(l4_addr_t a, l4_addr_t end) L4_NOTHROW
+{
+  using namespace L4Re;
+
+  L4::Cap<Rm> r = Env::env()->rm();
+  while (a < end)
+    {
+      l4_addr_t ra = a;
+      unsigned long rs = end - a;
+      l4_addr_t ro;
+      unsigned rf;
+      L4::Cap<Dataspace> ds;
+      int err = r->find(&ra, &rs, &ro, &rf, &ds);
+      if (err == -L4_ENOENT || (err >= 0 && (rf & Rm::In_area)))
+        return 0;
+      if (err < 0)
+        return err;
+
+      // find() returns any region in the range, so the part before it
+      // might still contain other regions
+      if (ra > a && (err = drop_pages(a, ra)) < 0)
+        return err;
+
+      l4_addr_t b = cxx::max(ra, a);
+      l4_addr_t e = cxx::min(ra + rs, end);
+      // only anonymous memory may read as zero afterwards, shared and
+      // private file mappings keep their content
+      l4_addr_t o = ro + (b - ra);
+      if ((rf & Rm::Detach_free) && !(rf & Rm::Read_only)
+          && _anon.is_anon(ds, o, e - b))
+        if ((err = ds->clear(o, e - b)) < 0)
+          return err;
+
+      a = e;
+    }
+
+  return 0;
+}
 
 }
 
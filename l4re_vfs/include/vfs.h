@@ -36,6 +36,7 @@
 #ifdef __cplusplus
 
 #include <l4/sys/capability>
+#include <l4/sys/irq>
 #include <l4/re/cap_alloc>
 #include <l4/re/dataspace>
 #include <l4/cxx/ref_ptr>
@@ -123,6 +124,35 @@ public:
   virtual int utime(const struct utimbuf *) throw() = 0;
   virtual int utimes(const struct timeval [2]) throw() = 0;
   virtual ssize_t readlink(char *, size_t) = 0;
+
+  /**
+   * \brief Check whether I/O on the file would block.
+   *
+   * This is the backend for POSIX select, poll and the epoll functions.
+   *
+   * \param events The events to check for, a combination of `POLLIN`,
+   *               `POLLPRI` and `POLLOUT`.
+   * \return The subset of \a events that is pending, plus `POLLERR` or
+   *         `POLLHUP` if these conditions apply, or <0 on error.
+   */
+  virtual int check_ready(int events) throw() = 0;
+
+  /**
+   * \brief Set the object to trigger when the readiness of the file changes.
+   *
+   * A waiter in select, poll or epoll_wait registers a notifier at all
+   * files it waits for and blocks on it. The file triggers the notifier
+   * whenever a check_ready() call might return a different result.
+   * Spurious triggers are allowed, the waiter checks all files again.
+   *
+   * \param irq The object to trigger, or an invalid capability to remove
+   *            the notifier. A file has at most one notifier, setting a
+   *            new one replaces the previous one.
+   * \return 0 on success, -EOPNOTSUPP if the file cannot notify about
+   *         changes (waiters then poll the file periodically), or <0 on
+   *         error.
+   */
+  virtual int set_ready_notifier(L4::Cap<L4::Triggerable> irq) throw() = 0;
 };
 
 inline
@@ -333,6 +363,17 @@ public:
    */
   virtual int fdatasync() const throw() = 0;
 
+  /**
+   * \brief Announce the intended access pattern for a range of the file.
+   *
+   * This is the backend for POSIX posix_fadvise.
+   * \param offset  Start of the range.
+   * \param len     Length of the range, 0 means up to the end of the file.
+   * \param advice  One of the POSIX_FADV_* constants.
+   * \return 0 on success, or <0 on error.
+   */
+  virtual int fadvise(off64_t offset, off64_t len, int advice) throw() = 0;
+
   /**
    * \brief Test if the given lock can be placed in the file.
    *
@@ -451,8 +492,12 @@ public:
   int openat(const char *path, int flags, mode_t mode,
              cxx::Ref_ptr<File> *f) throw();
 
-  void add_ref() throw() { ++_ref_cnt; }
-  int remove_ref() throw() { return --_ref_cnt; }
+  // files are shared between threads through the descriptor table
+  void add_ref() throw()
+  { __atomic_add_fetch(&_ref_cnt, 1, __ATOMIC_RELAXED); }
+
+  int remove_ref() throw()
+  { return __atomic_sub_fetch(&_ref_cnt, 1, __ATOMIC_ACQ_REL); }
 
   virtual ~File() throw() = 0;
 
@@ -38,6 +38,28 @@ inline int
 load_module(char const *)
 { return -1; }
 
+/**
+ * Check whether output to the log should be buffered.
+ *
+ * Buffering is enabled by setting L4RE_LOG_BUFFERED in the environment
+ * to a non-zero value. `at_exit` is called on exit to send the remaining
+ * output then.
+ *
+ * Output is sent at each newline, when the buffer is full, or with the
+ * next write once it is older than 50 ms. Output without a newline is not
+ * sent in the background: it waits for the next write, a read from the
+ * stream, fsync() or exit.
+ */
+inline bool
+log_buffered(void (*at_exit)())
+{
+  char const *b = getenv("L4RE_LOG_BUFFERED");
+  if (!b || !*b || *b == '0')
+    return false;
+
+  return atexit(at_exit) == 0;
+}
+
 }
 
 #include <l4/l4re_vfs/impl/ns_fs_impl.h>
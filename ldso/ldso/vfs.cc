@@ -89,6 +89,9 @@ namespace Vfs_config {
   inline void *malloc(size_t size) { return _dl_malloc(size); }
   inline void free(void *p) { _dl_free(p); }
 
+  // no buffering, the loader cannot flush on exit
+  inline bool log_buffered(void (*)()) { return false; }
+
 }
 namespace L4Re {
 L4Re::Cap_alloc *virt_cap_alloc = &Vfs_config::__cap_alloc;
@@ -287,7 +287,18 @@ extern "C" int dup2(int oldfd, int newfd) L4_NOTHROW
     }
 
   Ref_ptr<File> newf = o->set_fd(newfd, oldf);
-  if (!newf || newf == oldf)
+  if (!newf)
+    {
+      // set_fd() has no error code, check that newfd was in range
+      if (o->get_file(newfd) != oldf)
+        {
+          errno = EBADF;
+          return -1;
+        }
+      return newfd;
+    }
+
+  if (newf == oldf)
     return newfd;
 
   // do the stuff for close;
@@ -470,30 +481,6 @@ L4B_REDIRECT_4(int,       faccessat,   int, const char *, int, int)
 
 // ------------------------------------------------------
 
-//#include <stdio.h>
-#include <l4/util/util.h>
-
-int select(int nfds, fd_set *readfds, fd_set *writefds,
-           fd_set *exceptfds, struct timeval *timeout)
-{
-  (void)nfds; (void)readfds; (void)writefds; (void)exceptfds;
-  //printf("Call: %s(%d, %p, %p, %p, %p[%ld])\n", __func__, nfds, readfds, writefds, exceptfds, timeout, timeout->tv_usec + timeout->tv_sec * 1000000);
-
-#if 0
-  int us = timeout->tv_usec + timeout->tv_sec * 1000000;
-  l4_timeout_t to = l4_timeout(L4_IPC_TIMEOUT_NEVER,
-                               l4util_micros2l4to(us));
-#endif
-
-  // only the timeout for now
-  if (timeout)
-    l4_usleep(timeout->tv_usec + timeout->tv_sec * 1000000);
-  else
-    l4_sleep_forever();
-
-  return 0;
-}
-
 #undef L4B_REDIRECT
 
 #define L4B_REDIRECT(ret, func, ptlist, plist) \
@@ -0,0 +1,710 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU Lesser General Public License 2.1.
+ * Please see the COPYING-LGPL-2.1 file for details.
+ */
+
+/*
+ * select, poll and epoll on top of the readiness interface of
+ * L4Re::Vfs::File.
+ *
+ * A waiter uses a semaphore as notifier for all files it waits for and
+ * blocks with a single down() on it. After each wakeup it checks all files
+ * again. Files that cannot notify about changes are polled periodically.
+ *
+ * A file triggers only one notifier, but several threads may wait for the
+ * same file. All registrations are kept in one list, see Watch.
+ */
+
+#include <l4/re/env>
+#include <l4/re/env.h>
+#include <l4/sys/factory>
+#include <l4/sys/kip.h>
+#include <l4/sys/semaphore>
+#include <l4/util/util.h>
+#include <l4/cxx/avl_map>
+#include <l4/l4re_vfs/backend>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+using namespace L4Re::Vfs;
+using cxx::Ref_ptr;
+
+// programs without pthread can still use poll
+#pragma weak pthread_mutex_lock
+#pragma weak pthread_mutex_unlock
+
+namespace {
+
+enum
+{
+  /// Interval for polling files that cannot notify, in microseconds.
+  Poll_interval = 10000,
+};
+
+class Mutex
+{
+public:
+  void lock()
+  {
+    if (pthread_mutex_lock)
+      pthread_mutex_lock(&_m);
+  }
+
+  void unlock()
+  {
+    if (pthread_mutex_unlock)
+      pthread_mutex_unlock(&_m);
+  }
+
+private:
+  pthread_mutex_t _m = PTHREAD_MUTEX_INITIALIZER;
+};
+
+class Lock_guard
+{
+public:
+  explicit Lock_guard(Mutex &m) : _m(m) { _m.lock(); }
+  ~Lock_guard() { _m.unlock(); }
+
+private:
+  Lock_guard(Lock_guard const &);
+  void operator = (Lock_guard const &);
+
+  Mutex &_m;
+};
+
+/**
+ * Semaphore that waiters block on.
+ */
+class Notifier
+{
+public:
+  Notifier() : _sem(L4::Cap<L4::Semaphore>::Invalid) {}
+
+  ~Notifier()
+  {
+    if (_sem.is_valid())
+      vfs_cap_alloc->free(_sem, L4Re::This_task,
+                          L4_FP_ALL_SPACES | L4_FP_DELETE_OBJ);
+  }
+
+  int init()
+  {
+    _sem = vfs_cap_alloc->alloc<L4::Semaphore>();
+    if (!_sem.is_valid())
+      return -ENOMEM;
+
+    int r = l4_error(L4Re::Env::env()->factory()->create(_sem));
+    if (r < 0)
+      {
+        vfs_cap_alloc->free(_sem);
+        _sem = L4::Cap<L4::Semaphore>::Invalid;
+      }
+    return r;
+  }
+
+  L4::Cap<L4::Semaphore> cap() const { return _sem; }
+
+  /**
+   * Block until the semaphore is triggered or the deadline passes.
+   *
+   * \param deadline  Absolute KIP clock value, 0 for no deadline.
+   * \param poll      Return after Poll_interval at the latest.
+   *
+   * \return true if the semaphore was triggered.
+   */
+  bool wait(l4_cpu_time_t deadline, bool poll)
+  {
+    l4_timeout_t to = L4_IPC_NEVER;
+    if (deadline || poll)
+      {
+        l4_cpu_time_t now = l4_kip_clock(l4re_kip());
+        l4_cpu_time_t us = deadline > now ? deadline - now : 0;
+        if (poll && (!deadline || us > Poll_interval))
+          us = Poll_interval;
+        if (!us)
+          return false;
+
+        // callers loop until the deadline, so waiting less is fine
+        if (us > 1000000000)
+          us = 1000000000;
+
+        to = l4_timeout(L4_IPC_TIMEOUT_NEVER, l4util_micros2l4to(us));
+      }
+
+    return l4_error(_sem->down(to)) >= 0;
+  }
+
+private:
+  L4::Cap<L4::Semaphore> _sem;
+};
+
+l4_cpu_time_t deadline_us(long long us)
+{
+  if (us < 0)
+    return 0;
+
+  return l4_kip_clock(l4re_kip()) + us + (us == 0);
+}
+
+bool expired(l4_cpu_time_t deadline)
+{ return deadline && l4_kip_clock(l4re_kip()) >= deadline; }
+
+/**
+ * A notifier registered at a file by a waiter.
+ *
+ * The registrations of all waiters are kept in one list, the newest first.
+ * The file triggers the newest registration for it. A waiter that wakes up
+ * passes the trigger on to the next older registration of each of its
+ * files, and removing the newest registration hands the file back to the
+ * next older one. Registrations only exist while their waiter is waiting,
+ * so every trigger reaches all waiters of a file.
+ */
+struct Watch
+{
+  Ref_ptr<File> file;
+  L4::Cap<L4::Triggerable> notifier;
+  Watch *next;
+  /// The file supports notification.
+  bool notify;
+
+  Watch()
+  : notifier(L4::Cap<L4::Triggerable>::Invalid), next(0), notify(false)
+  {}
+
+  /// Register at the file, \return true if the file can notify.
+  bool add();
+  /// Remove the registration from the file.
+  void remove();
+  /// Trigger the next older registration for the file.
+  void pass_on();
+
+private:
+  Watch *older() const
+  {
+    for (Watch *o = next; o; o = o->next)
+      if (o->file == file)
+        return o;
+    return 0;
+  }
+
+  static Mutex _lock;
+  static Watch *_first;
+};
+
+Mutex Watch::_lock;
+Watch *Watch::_first;
+
+bool
+Watch::add()
+{
+  if (!file)
+    return true;
+
+  Lock_guard g(_lock);
+  next = _first;
+  _first = this;
+  notify = file->set_ready_notifier(notifier) >= 0;
+  return notify;
+}
+
+void
+Watch::remove()
+{
+  if (!file)
+    return;
+
+  Lock_guard g(_lock);
+  bool newest = true;
+  Watch **p = &_first;
+  for (; *p != this; p = &(*p)->next)
+    if ((*p)->file == file)
+      newest = false;
+
+  *p = next;
+  if (!newest || !notify)
+    return;
+
+  // the older waiter might have missed events while not registered
+  Watch *o = older();
+  if (o)
+    {
+      file->set_ready_notifier(o->notifier);
+      o->notifier->trigger();
+    }
+  else
+    file->set_ready_notifier(L4::Cap<L4::Triggerable>::Invalid);
+}
+
+void
+Watch::pass_on()
+{
+  if (!file || !notify)
+    return;
+
+  Lock_guard g(_lock);
+  if (Watch *o = older())
+    o->notifier->trigger();
+}
+
+/**
+ * Check readiness of all entries of a pollfd array.
+ *
+ * \return Number of entries with a non-zero `revents`.
+ */
+int check_fds(struct pollfd *fds, nfds_t nfds)
+{
+  int cnt = 0;
+  for (nfds_t i = 0; i < nfds; ++i)
+    {
+      fds[i].revents = 0;
+      if (fds[i].fd < 0)
+        continue;
+
+      Ref_ptr<File> f = vfs_ops->get_file(fds[i].fd);
+      if (!f)
+        fds[i].revents = POLLNVAL;
+      else
+        {
+          int r = f->check_ready(fds[i].events);
+          fds[i].revents = r < 0 ? POLLERR : r;
+        }
+
+      if (fds[i].revents)
+        ++cnt;
+    }
+
+  return cnt;
+}
+
+/**
+ * Register a notifier at all files of a pollfd array.
+ *
+ * \return true if all files support notification.
+ */
+bool watch_fds(struct pollfd *fds, nfds_t nfds, Watch *w,
+               L4::Cap<L4::Triggerable> n)
+{
+  bool all = true;
+  for (nfds_t i = 0; i < nfds; ++i)
+    {
+      if (fds[i].fd < 0)
+        continue;
+
+      w[i].file = vfs_ops->get_file(fds[i].fd);
+      w[i].notifier = n;
+      if (!w[i].add())
+        all = false;
+    }
+
+  return all;
+}
+
+int do_poll(struct pollfd *fds, nfds_t nfds, long long timeout_us)
+{
+  int cnt = check_fds(fds, nfds);
+  if (cnt || timeout_us == 0)
+    return cnt;
+
+  l4_cpu_time_t deadline = deadline_us(timeout_us);
+  Notifier n;
+  Watch w[nfds];
+  bool all = false;
+  if (n.init() >= 0)
+    all = watch_fds(fds, nfds, w, n.cap());
+
+  while (!(cnt = check_fds(fds, nfds)) && !expired(deadline))
+    {
+      if (!n.cap().is_valid())
+        l4_usleep(Poll_interval);
+      else if (n.wait(deadline, !all))
+        for (nfds_t i = 0; i < nfds; ++i)
+          w[i].pass_on();
+    }
+
+  for (nfds_t i = 0; i < nfds; ++i)
+    w[i].remove();
+
+  return cnt;
+}
+
+/**
+ * An epoll instance.
+ *
+ * The instance is registered as notifier at all its files while at least
+ * one thread waits in epoll_wait(). All events are reported
+ * level-triggered, `EPOLLET` is accepted but has no effect.
+ */
+class Epoll_file : public Be_file
+{
+public:
+  Epoll_file() : _waiters(0) {}
+
+  int init() { return _notifier.init(); }
+
+  int fstat64(struct stat64 *buf) const throw()
+  {
+    memset(buf, 0, sizeof(*buf));
+    buf->st_mode = S_IFREG | 0600;
+    return 0;
+  }
+
+  int check_ready(int events) throw()
+  {
+    Lock_guard g(_lock);
+    for (auto &i: _items)
+      if (check(i.first, &i.second))
+        return events & POLLIN;
+
+    return 0;
+  }
+
+  int ctl(int op, int fd, struct epoll_event *event);
+  int wait(struct epoll_event *events, int maxevents, int timeout);
+
+private:
+  struct Item
+  {
+    struct epoll_event event;
+    /// Registration at the file, Watch::file is the file.
+    Watch watch;
+  };
+
+  typedef cxx::Avl_map<int, Item> Items;
+
+  void remove(int fd, Item *i)
+  {
+    if (_waiters)
+      i->watch.remove();
+    _items.remove(fd);
+  }
+
+  /**
+   * Get the pending events of a registered file.
+   *
+   * \return The pending events, 0 if there are none or the file was closed
+   *         in the meantime.
+   */
+  int check(int fd, Item *i)
+  {
+    if (!(i->event.events & ~(EPOLLET | EPOLLONESHOT)))
+      return 0;
+
+    if (vfs_ops->get_file(fd) != i->watch.file)
+      return 0;
+
+    int ev = i->event.events & (POLLIN | POLLPRI | POLLOUT);
+    int r = i->watch.file->check_ready(ev);
+    return r < 0 ? EPOLLERR : r;
+  }
+
+  Notifier _notifier;
+  /// Protects _items and _waiters.
+  Mutex _lock;
+  Items _items;
+  unsigned _waiters;
+};
+
+int
+Epoll_file::ctl(int op, int fd, struct epoll_event *event)
+{
+  Ref_ptr<File> f = vfs_ops->get_file(fd);
+  if (!f)
+    return -EBADF;
+
+  if (f.get() == this)
+    return -EINVAL;
+
+  Lock_guard g(_lock);
+  Items::Node n = _items.find_node(fd);
+  if (n && n->second.watch.file != f)
+    {
+      // the fd was closed and reused since it was added
+      remove(fd, const_cast<Item *>(&n->second));
+      n = Items::Node();
+    }
+
+  switch (op)
+    {
+    case EPOLL_CTL_ADD:
+      {
+        if (n)
+          return -EEXIST;
+
+        Item it;
+        it.event = *event;
+        it.watch.file = f;
+        it.watch.notifier = _notifier.cap();
+        auto r = _items.insert(fd, it);
+        if (r.second < 0)
+          return -ENOMEM;
+
+        if (_waiters)
+          {
+            r.first->second.watch.add();
+            // let the waiters check the new file
+            _notifier.cap()->trigger();
+          }
+        return 0;
+      }
+
+    case EPOLL_CTL_MOD:
+      if (!n)
+        return -ENOENT;
+
+      const_cast<Item &>(n->second).event = *event;
+      if (_waiters)
+        _notifier.cap()->trigger();
+      return 0;
+
+    case EPOLL_CTL_DEL:
+      if (!n)
+        return -ENOENT;
+
+      remove(fd, const_cast<Item *>(&n->second));
+      return 0;
+
+    default:
+      return -EINVAL;
+    }
+}
+
+int
+Epoll_file::wait(struct epoll_event *events, int maxevents, int timeout)
+{
+  if (maxevents <= 0)
+    return -EINVAL;
+
+  l4_cpu_time_t deadline = deadline_us(timeout < 0 ? -1 : timeout * 1000LL);
+  int cnt;
+
+  _lock.lock();
+  if (timeout != 0 && _waiters++ == 0)
+    for (auto &i: _items)
+      i.second.watch.add();
+
+  for (;;)
+    {
+      cnt = 0;
+      bool all = true;
+      for (Items::Iterator i = _items.begin();
+           i != _items.end() && cnt < maxevents; ++i)
+        {
+          all = all && i->second.watch.notify;
+          int r = check(i->first, &i->second);
+          if (!r)
+            continue;
+
+          events[cnt].events = r;
+          events[cnt].data = i->second.event.data;
+          ++cnt;
+
+          if (i->second.event.events & EPOLLONESHOT)
+            i->second.event.events = 0;
+        }
+
+      if (cnt || timeout == 0 || expired(deadline))
+        break;
+
+      _lock.unlock();
+      bool triggered = _notifier.wait(deadline, !all);
+      _lock.lock();
+
+      if (triggered)
+        for (auto &i: _items)
+          i.second.watch.pass_on();
+    }
+
+  if (timeout != 0 && --_waiters == 0)
+    for (auto &i: _items)
+      i.second.watch.remove();
+  _lock.unlock();
+
+  return cnt;
+}
+
+Ref_ptr<Epoll_file> get_epoll(int epfd)
+{ return cxx::dynamic_pointer_cast<Epoll_file>(vfs_ops->get_file(epfd)); }
+
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  int r = do_poll(fds, nfds, timeout < 0 ? -1 : timeout * 1000LL);
+  if (r < 0)
+    {
+      errno = -r;
+      return -1;
+    }
+  return r;
+}
+
+int select(int nfds, fd_set *readfds, fd_set *writefds,
+           fd_set *exceptfds, struct timeval *timeout)
+{
+  if (nfds < 0 || nfds > FD_SETSIZE)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  struct pollfd fds[nfds];
+  nfds_t n = 0;
+  for (int fd = 0; fd < nfds; ++fd)
+    {
+      short events = 0;
+      if (readfds && FD_ISSET(fd, readfds))
+        events |= POLLIN;
+      if (writefds && FD_ISSET(fd, writefds))
+        events |= POLLOUT;
+      if (exceptfds && FD_ISSET(fd, exceptfds))
+        events |= POLLPRI;
+
+      if (!events)
+        continue;
+
+      fds[n].fd = fd;
+      fds[n].events = events;
+      ++n;
+    }
+
+  long long us = -1;
+  if (timeout)
+    us = timeout->tv_sec * 1000000LL + timeout->tv_usec;
+
+  int r = do_poll(fds, n, us);
+  if (r < 0)
+    {
+      errno = -r;
+      return -1;
+    }
+
+  for (nfds_t i = 0; i < n; ++i)
+    if (fds[i].revents & POLLNVAL)
+      {
+        errno = EBADF;
+        return -1;
+      }
+
+  if (readfds)
+    FD_ZERO(readfds);
+  if (writefds)
+    FD_ZERO(writefds);
+  if (exceptfds)
+    FD_ZERO(exceptfds);
+
+  int cnt = 0;
+  for (nfds_t i = 0; i < n; ++i)
+    {
+      int fd = fds[i].fd;
+      short re = fds[i].revents;
+      if (readfds && (re & (POLLIN | POLLHUP | POLLERR)) && (fds[i].events & POLLIN))
+        {
+          FD_SET(fd, readfds);
+          ++cnt;
+        }
+      if (writefds && (re & (POLLOUT | POLLERR)) && (fds[i].events & POLLOUT))
+        {
+          FD_SET(fd, writefds);
+          ++cnt;
+        }
+      if (exceptfds && (re & POLLPRI) && (fds[i].events & POLLPRI))
+        {
+          FD_SET(fd, exceptfds);
+          ++cnt;
+        }
+    }
+
+  return cnt;
+}
+
+int epoll_create1(int flags)
+{
+  if (flags & ~EPOLL_CLOEXEC)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  Ref_ptr<Epoll_file> f(new Epoll_file());
+  if (!f)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+  int r = f->init();
+  if (r >= 0)
+    r = vfs_ops->alloc_fd(f);
+
+  if (r < 0)
+    {
+      errno = -r;
+      return -1;
+    }
+
+  return r;
+}
+
+int epoll_create(int size)
+{
+  if (size <= 0)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return epoll_create1(0);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+  Ref_ptr<Epoll_file> ep = get_epoll(epfd);
+  if (!ep)
+    {
+      errno = vfs_ops->get_file(epfd) ? EINVAL : EBADF;
+      return -1;
+    }
+
+  if (op != EPOLL_CTL_DEL && !event)
+    {
+      errno = EFAULT;
+      return -1;
+    }
+
+  int r = ep->ctl(op, fd, event);
+  if (r < 0)
+    {
+      errno = -r;
+      return -1;
+    }
+  return 0;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+               int timeout)
+{
+  Ref_ptr<Epoll_file> ep = get_epoll(epfd);
+  if (!ep)
+    {
+      errno = vfs_ops->get_file(epfd) ? EINVAL : EBADF;
+      return -1;
+    }
+
+  int r = ep->wait(events, maxevents, timeout);
+  if (r < 0)
+    {
+      errno = -r;
+      return -1;
+    }
+  return r;
+}
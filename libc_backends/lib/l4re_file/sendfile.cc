@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU Lesser General Public License 2.1.
+ * Please see the COPYING-LGPL-2.1 file for details.
+ */
+
+/*
+ * sendfile, copy_file_range and the file access hints.
+ *
+ * Copies between files that are both backed by dataspaces are done by the
+ * dataspace manager with Dataspace::copy_in, the data never passes through
+ * the caller. If only the source has a dataspace, it is attached in windows
+ * and written from there. Anything else falls back to a bounce buffer.
+ */
+
+#include <l4/re/env>
+#include <l4/re/dataspace>
+#include <l4/re/rm>
+#include <l4/cxx/minmax>
+#include <l4/l4re_vfs/backend>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace L4Re::Vfs;
+using cxx::Ref_ptr;
+
+namespace {
+
+enum
+{
+  /// Size of the source windows attached by copy_mapped().
+  Window_size = 1 << 20,
+  /// Size of the on-stack buffer used by copy_bounce().
+  Bounce_size = 4096,
+};
+
+/**
+ * Write `len` bytes to `out`, either at `*out_off` or at the current file
+ * position if `out_off` is 0.
+ *
+ * \return The number of bytes written, less than `len` only if the file
+ *         did not accept more, or <0 on error if nothing was written.
+ */
+ssize_t
+write_out(Ref_ptr<File> const &out, off64_t *out_off,
+          char const *buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len)
+    {
+      struct iovec iov;
+      iov.iov_base = const_cast<char *>(buf + done);
+      iov.iov_len = len - done;
+
+      ssize_t r = out_off ? out->pwritev(&iov, 1, *out_off)
+                          : out->writev(&iov, 1);
+      if (r < 0)
+        return done ? (ssize_t)done : r;
+      if (r == 0)
+        break;
+
+      if (out_off)
+        *out_off += r;
+      done += r;
+    }
+
+  return done;
+}
+
+/**
+ * Let the dataspace manager copy from the data space of `in` to the data
+ * space of `out`.
+ *
+ * Only done if the target range lies within the current size of `out`, so
+ * that the file size stays untouched.
+ *
+ * \retval -EOPNOTSUPP  The files do not allow a copy between their data
+ *                      spaces, nothing was copied.
+ */
+ssize_t
+copy_ds(Ref_ptr<File> const &in, off64_t in_pos,
+        Ref_ptr<File> const &out, off64_t *out_off, size_t count)
+{
+  L4::Cap<L4Re::Dataspace> src = in->data_space();
+  L4::Cap<L4Re::Dataspace> dst = out->data_space();
+
+  if (!dst.is_valid() || (out->get_status_flags() & O_APPEND))
+    return -EOPNOTSUPP;
+
+  off64_t out_pos = out_off ? *out_off : out->lseek64(0, SEEK_CUR);
+  if (out_pos < 0)
+    return -EOPNOTSUPP;
+
+  struct stat64 st;
+  if (out->fstat64(&st) < 0 || out_pos + (off64_t)count > st.st_size)
+    return -EOPNOTSUPP;
+
+  if (src == dst && in_pos < out_pos + (off64_t)count
+      && out_pos < in_pos + (off64_t)count)
+    return -EINVAL;
+
+  if (dst->copy_in(out_pos, src, in_pos, count) < 0)
+    return -EOPNOTSUPP;
+
+  if (out_off)
+    *out_off += count;
+  else
+    out->lseek64(out_pos + count, SEEK_SET);
+
+  return count;
+}
+
+/**
+ * Write from read-only windows of the data space of `in` to `out`.
+ */
+ssize_t
+copy_mapped(Ref_ptr<File> const &in, off64_t in_pos,
+            Ref_ptr<File> const &out, off64_t *out_off, size_t count)
+{
+  L4::Cap<L4Re::Dataspace> src = in->data_space();
+  L4::Cap<L4Re::Rm> rm = L4Re::Env::env()->rm();
+  size_t done = 0;
+
+  while (done < count)
+    {
+      off64_t pos = in_pos + done;
+      l4_addr_t base = l4_trunc_page(pos);
+      unsigned long sz = cxx::min<unsigned long>(Window_size,
+                                                 l4_round_page(in_pos + count)
+                                                 - base);
+
+      char *win = 0;
+      long err = rm->attach(&win, sz, L4Re::Rm::Search_addr
+                                      | L4Re::Rm::Read_only,
+                            L4::Ipc::make_cap(src, L4_CAP_FPAGE_RO), base);
+      if (err < 0)
+        return done ? (ssize_t)done : err;
+
+      // map the whole window at once instead of faulting page by page
+      src->map_region(base, L4Re::Dataspace::Map_ro, l4_addr_t(win),
+                      l4_addr_t(win) + sz);
+
+      size_t chunk = cxx::min<size_t>(sz - (pos - base), count - done);
+      ssize_t w = write_out(out, out_off, win + (pos - base), chunk);
+      rm->detach(win, 0);
+
+      if (w < 0)
+        return done ? (ssize_t)done : w;
+
+      done += w;
+      if ((size_t)w < chunk)
+        break;
+    }
+
+  return done;
+}
+
+/**
+ * Copy through a buffer on the stack, for files without data spaces.
+ */
+ssize_t
+copy_bounce(Ref_ptr<File> const &in, off64_t *in_off,
+            Ref_ptr<File> const &out, off64_t *out_off, size_t count)
+{
+  char buf[Bounce_size];
+  size_t done = 0;
+
+  while (done < count)
+    {
+      struct iovec iov;
+      iov.iov_base = buf;
+      iov.iov_len = cxx::min<size_t>(sizeof(buf), count - done);
+
+      ssize_t r = in_off ? in->preadv(&iov, 1, *in_off) : in->readv(&iov, 1);
+      if (r <= 0)
+        return done ? (ssize_t)done : r;
+
+      if (in_off)
+        *in_off += r;
+
+      ssize_t w = write_out(out, out_off, buf, r);
+      if (w < 0)
+        return done ? (ssize_t)done : w;
+
+      done += w;
+      if (w < r)
+        break;
+    }
+
+  return done;
+}
+
+/**
+ * Copy `count` bytes from `in` to `out`.
+ *
+ * The offsets are used and updated if given, otherwise the file positions.
+ */
+ssize_t
+transfer(Ref_ptr<File> const &in, off64_t *in_off,
+         Ref_ptr<File> const &out, off64_t *out_off, size_t count)
+{
+  off64_t in_pos = in_off ? *in_off : in->lseek64(0, SEEK_CUR);
+  if (in_pos < 0 || !in->data_space().is_valid())
+    return copy_bounce(in, in_off, out, out_off, count);
+
+  struct stat64 st;
+  if (in->fstat64(&st) < 0)
+    return copy_bounce(in, in_off, out, out_off, count);
+
+  if (in_pos >= st.st_size)
+    return 0;
+
+  if ((off64_t)count > st.st_size - in_pos)
+    count = st.st_size - in_pos;
+
+  ssize_t r = copy_ds(in, in_pos, out, out_off, count);
+  if (r == -EOPNOTSUPP)
+    r = copy_mapped(in, in_pos, out, out_off, count);
+
+  if (r > 0)
+    {
+      if (in_off)
+        *in_off += r;
+      else
+        in->lseek64(in_pos + r, SEEK_SET);
+    }
+
+  return r;
+}
+
+ssize_t
+do_transfer(int in_fd, off64_t *in_off, int out_fd, off64_t *out_off,
+            size_t count)
+{
+  Ops *o = L4Re::Vfs::vfs_ops;
+  Ref_ptr<File> in = o->get_file(in_fd);
+  Ref_ptr<File> out = o->get_file(out_fd);
+  if (!in || !out)
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  ssize_t r = transfer(in, in_off, out, out_off, count);
+  if (r < 0)
+    {
+      errno = -r;
+      return -1;
+    }
+
+  return r;
+}
+
+int
+do_fadvise(int fd, off64_t offset, off64_t len, int advice)
+{
+  Ref_ptr<File> f = L4Re::Vfs::vfs_ops->get_file(fd);
+  if (!f)
+    return EBADF;
+
+  switch (advice)
+    {
+    case POSIX_FADV_NORMAL:
+    case POSIX_FADV_RANDOM:
+    case POSIX_FADV_SEQUENTIAL:
+    case POSIX_FADV_WILLNEED:
+    case POSIX_FADV_DONTNEED:
+    case POSIX_FADV_NOREUSE:
+      break;
+    default:
+      return EINVAL;
+    }
+
+  return -f->fadvise(offset, len, advice);
+}
+
+}
+
+extern "C"
+ssize_t sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count)
+L4_NOTHROW
+{
+  return do_transfer(in_fd, offset, out_fd, 0, count);
+}
+
+extern "C"
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+L4_NOTHROW
+{
+  if (!offset)
+    return do_transfer(in_fd, 0, out_fd, 0, count);
+
+  off64_t off = *offset;
+  ssize_t r = do_transfer(in_fd, &off, out_fd, 0, count);
+  *offset = off;
+  return r;
+}
+
+extern "C"
+ssize_t copy_file_range(int fd_in, off64_t *off_in, int fd_out,
+                        off64_t *off_out, size_t len, unsigned flags)
+{
+  if (flags)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return do_transfer(fd_in, off_in, fd_out, off_out, len);
+}
+
+extern "C"
+int posix_fadvise64(int fd, off64_t offset, off64_t len, int advice)
+L4_NOTHROW
+{
+  return do_fadvise(fd, offset, len, advice);
+}
+
+extern "C"
+int posix_fadvise(int fd, off_t offset, off_t len, int advice) L4_NOTHROW
+{
+  return do_fadvise(fd, offset, len, advice);
+}
+
+extern "C"
+ssize_t readahead(int fd, off64_t offset, size_t count) L4_NOTHROW
+{
+  int err = do_fadvise(fd, offset, count, POSIX_FADV_WILLNEED);
+  if (err)
+    {
+      errno = err;
+      return -1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,911 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU Lesser General Public License 2.1.
+ * Please see the COPYING-LGPL-2.1 file for details.
+ */
+
+/*
+ * Thread-caching malloc.
+ *
+ * Linking against libc_be_mem_tcache replaces the malloc family of the C
+ * library.
+ *
+ * - Small requests (up to Max_small bytes) are rounded up to one of
+ *   Num_classes size classes. Objects of one class are carved out of
+ *   spans, Span_size-aligned blocks with a header at their start, so the
+ *   span of an object is found by masking its address.
+ * - Every thread keeps a cache of free objects per class that it allocates
+ *   from and frees to without taking a lock.
+ * - A thread cache refills from and drains to the central depot of the
+ *   class in batches. The depot keeps some full batches so that they can
+ *   move between threads as a whole; other objects go back to their span.
+ * - Spans come from the page heap, which maps them from the anonymous
+ *   memory arena in groups and unmaps spans that became completely free,
+ *   except for a few it keeps for reuse. malloc_trim() also empties the
+ *   depots and unmaps all free spans.
+ * - Large requests are mapped directly. Their user pointer is
+ *   Span_size-aligned (no small object ever is) and the page before it
+ *   holds the size of the mapping.
+ *
+ * An object freed by another thread than the one that allocated it goes to
+ * the cache of the freeing thread and travels back through the depot.
+ *
+ * Locking uses weak references to the pthread functions, programs that do
+ * not link libpthread are single-threaded and do not need it.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <l4/sys/compiler.h>
+#include <l4/sys/consts.h>
+
+#pragma weak pthread_mutex_lock
+#pragma weak pthread_mutex_unlock
+#pragma weak pthread_once
+#pragma weak pthread_key_create
+#pragma weak pthread_setspecific
+
+enum
+{
+  Span_shift      = 18,
+  Span_size       = 1UL << Span_shift,
+  Arena_spans     = 16,   /* spans mapped from the arena at once */
+  Keep_free_spans = 4,    /* completely free spans kept for reuse */
+  Max_small       = 32 << 10,
+  Min_align       = 16,
+  Max_class_align = L4_PAGESIZE,
+  Num_classes     = 8 + 8 * 4,
+  Max_batch       = 32,
+  Depot_batches   = 16,
+};
+
+/* Span header, objects start behind it at the alignment of the class. */
+struct span
+{
+  struct span *next, *prev;     /* central list of spans with free objects */
+  void *free;                   /* objects returned to this span */
+  char *bump, *end;             /* never handed out objects */
+  unsigned cls;
+  unsigned used;                /* objects handed out */
+  unsigned capacity;
+  int listed;
+};
+
+struct central
+{
+  pthread_mutex_t lock;
+  struct span *partial;
+  void *batches[Depot_batches]; /* full batches, linked through objects */
+  unsigned nbatches;
+  unsigned long spans;
+  unsigned long used;           /* objects handed out from spans */
+};
+
+struct cache_list
+{
+  void *head;
+  unsigned count;
+};
+
+struct thread_cache
+{
+  struct cache_list lists[Num_classes];
+  struct thread_cache *next;    /* all thread caches, for statistics */
+  int live;
+};
+
+struct large_hdr
+{
+  size_t len;                   /* length of the mapping incl. this page */
+};
+
+static struct central central[Num_classes] =
+{ [0 ... Num_classes - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER } };
+
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct span *free_spans;
+static unsigned nfree_spans;
+static unsigned long span_bytes;    /* small-object spans in use */
+static unsigned long large_bytes;
+static unsigned long large_count;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_cache *all_caches;
+static char *cache_bump, *cache_end;
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+static int cache_key_valid;
+
+enum { Tc_none, Tc_busy, Tc_dead };
+
+#define TLS_IE __attribute__((tls_model("initial-exec")))
+static __thread struct thread_cache *tcache TLS_IE;
+static __thread int tcache_state TLS_IE;
+
+static inline void lock(pthread_mutex_t *m)
+{
+  if (pthread_mutex_lock)
+    pthread_mutex_lock(m);
+}
+
+static inline void unlock(pthread_mutex_t *m)
+{
+  if (pthread_mutex_unlock)
+    pthread_mutex_unlock(m);
+}
+
+static inline void *obj_next(void *o)
+{ return *(void **)o; }
+
+static inline void obj_set_next(void *o, void *n)
+{ *(void **)o = n; }
+
+/*
+ * Size classes: 16-byte steps up to 128 bytes, then four classes per power
+ * of two up to Max_small.
+ */
+static inline unsigned size_class(size_t n)
+{
+  unsigned k;
+
+  if (n <= 128)
+    return n ? (n - 1) / 16 : 0;
+
+  k = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(n - 1);
+  return 8 + (k - 7) * 4 + ((n - 1 - (1UL << k)) >> (k - 2));
+}
+
+static inline size_t class_size(unsigned c)
+{
+  unsigned k;
+
+  if (c < 8)
+    return (c + 1) * 16;
+
+  k = 7 + (c - 8) / 4;
+  return (1UL << k) + ((c - 8) % 4 + 1) * (1UL << (k - 2));
+}
+
+static inline size_t class_align(unsigned c)
+{
+  size_t s = class_size(c);
+  s &= -s;
+  return s > Max_class_align ? Max_class_align : s;
+}
+
+/* Offset of the first object in a span of class `c`. */
+static inline size_t class_first(unsigned c)
+{
+  return (sizeof(struct span) + class_align(c) - 1) & ~(class_align(c) - 1);
+}
+
+static inline unsigned class_capacity(unsigned c)
+{ return (Span_size - class_first(c)) / class_size(c); }
+
+/* Objects moved between a thread cache and the depot at once. */
+static inline unsigned class_batch(unsigned c)
+{
+  size_t n = (Span_size / 8) / class_size(c);
+  if (n > Max_batch)
+    return Max_batch;
+  return n < 2 ? 2 : n;
+}
+
+/* Full batches the depot of class `c` keeps, about half a span's worth. */
+static inline unsigned class_depot(unsigned c)
+{
+  size_t n = (Span_size / 2) / (class_batch(c) * class_size(c));
+  if (n > Depot_batches)
+    return Depot_batches;
+  return n < 2 ? 2 : n;
+}
+
+static inline int is_large(void const *p)
+{ return ((uintptr_t)p & (Span_size - 1)) == 0; }
+
+static inline struct span *span_of(void const *p)
+{ return (struct span *)((uintptr_t)p & ~(uintptr_t)(Span_size - 1)); }
+
+/* ---- page heap ---- */
+
+static int heap_grow(void)
+{
+  size_t len = (Arena_spans + 1) * Span_size;
+  char *m, *a, *e;
+  unsigned i;
+
+  m = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED)
+    return -1;
+
+  a = (char *)(((uintptr_t)m + Span_size - 1) & ~(uintptr_t)(Span_size - 1));
+  e = a + Arena_spans * Span_size;
+  if (a > m)
+    munmap(m, a - m);
+  if (m + len > e)
+    munmap(e, m + len - e);
+
+  for (i = 0; i < Arena_spans; i++)
+    {
+      struct span *s = (struct span *)(a + i * Span_size);
+      s->next = free_spans;
+      free_spans = s;
+    }
+  nfree_spans += Arena_spans;
+  return 0;
+}
+
+static struct span *span_alloc(void)
+{
+  struct span *s;
+
+  lock(&heap_lock);
+  if (!free_spans && heap_grow() < 0)
+    {
+      unlock(&heap_lock);
+      return NULL;
+    }
+
+  s = free_spans;
+  free_spans = s->next;
+  --nfree_spans;
+  span_bytes += Span_size;
+  unlock(&heap_lock);
+  return s;
+}
+
+static void span_free(struct span *s)
+{
+  int keep;
+
+  lock(&heap_lock);
+  span_bytes -= Span_size;
+  keep = nfree_spans < Keep_free_spans;
+  if (keep)
+    ++nfree_spans;
+  unlock(&heap_lock);
+
+  /* Give the pages back to the anonymous memory arena. A span kept for
+     reuse only keeps its address range. */
+  if (!keep)
+    {
+      munmap(s, Span_size);
+      return;
+    }
+
+  madvise(s, Span_size, MADV_DONTNEED);
+
+  lock(&heap_lock);
+  s->next = free_spans;
+  free_spans = s;
+  unlock(&heap_lock);
+}
+
+/* ---- central depot ---- */
+
+static void span_init(struct span *s, unsigned c)
+{
+  s->cls = c;
+  s->free = NULL;
+  s->used = 0;
+  s->capacity = class_capacity(c);
+  s->bump = (char *)s + class_first(c);
+  s->end = s->bump + s->capacity * class_size(c);
+  s->listed = 0;
+}
+
+static void span_list(struct central *z, struct span *s)
+{
+  s->prev = NULL;
+  s->next = z->partial;
+  if (z->partial)
+    z->partial->prev = s;
+  z->partial = s;
+  s->listed = 1;
+}
+
+static void span_unlist(struct central *z, struct span *s)
+{
+  if (s->prev)
+    s->prev->next = s->next;
+  else
+    z->partial = s->next;
+  if (s->next)
+    s->next->prev = s->prev;
+  s->listed = 0;
+}
+
+/* Take up to `n` objects of class `c`, linked into a list at *head. */
+static unsigned central_fetch(unsigned c, unsigned n, void **head)
+{
+  struct central *z = &central[c];
+  size_t size = class_size(c);
+  void *list = NULL;
+  unsigned got = 0;
+
+  lock(&z->lock);
+  if (n == class_batch(c) && z->nbatches)
+    {
+      *head = z->batches[--z->nbatches];
+      unlock(&z->lock);
+      return n;
+    }
+
+  while (got < n)
+    {
+      struct span *s = z->partial;
+      void *o;
+
+      if (!s)
+        {
+          s = span_alloc();
+          if (!s)
+            break;
+          span_init(s, c);
+          span_list(z, s);
+          ++z->spans;
+        }
+
+      if (s->free)
+        {
+          o = s->free;
+          s->free = obj_next(o);
+        }
+      else
+        {
+          o = s->bump;
+          s->bump += size;
+        }
+
+      ++s->used;
+      ++z->used;
+      if (!s->free && s->bump == s->end)
+        span_unlist(z, s);
+
+      obj_set_next(o, list);
+      list = o;
+      ++got;
+    }
+  unlock(&z->lock);
+
+  *head = list;
+  return got;
+}
+
+static void central_put(struct central *z, void *o)
+{
+  struct span *s = span_of(o);
+
+  obj_set_next(o, s->free);
+  s->free = o;
+  --z->used;
+
+  if (!s->listed)
+    span_list(z, s);
+
+  /* Keep the only span of a class to avoid mapping it again and again. */
+  if (--s->used == 0 && (s->next || s->prev))
+    {
+      span_unlist(z, s);
+      --z->spans;
+      span_free(s);
+    }
+}
+
+/* Give back a list of `n` objects of class `c`. */
+static void central_release(unsigned c, void *head, unsigned n)
+{
+  struct central *z = &central[c];
+
+  lock(&z->lock);
+  if (n == class_batch(c) && z->nbatches < class_depot(c))
+    z->batches[z->nbatches++] = head;
+  else
+    while (head)
+      {
+        void *next = obj_next(head);
+        central_put(z, head);
+        head = next;
+      }
+  unlock(&z->lock);
+}
+
+/* ---- thread caches ---- */
+
+static void thread_cache_flush(struct thread_cache *tc, unsigned c,
+                               unsigned n)
+{
+  struct cache_list *l = &tc->lists[c];
+  void *head = l->head, *last = head;
+  unsigned i;
+
+  for (i = 1; i < n; i++)
+    last = obj_next(last);
+
+  l->head = obj_next(last);
+  l->count -= n;
+  obj_set_next(last, NULL);
+  central_release(c, head, n);
+}
+
+static void thread_cache_destroy(void *arg)
+{
+  struct thread_cache *tc = arg;
+  unsigned c;
+
+  tcache = NULL;
+  tcache_state = Tc_dead;
+
+  for (c = 0; c < Num_classes; c++)
+    {
+      unsigned b = class_batch(c);
+      while (tc->lists[c].count >= b)
+        thread_cache_flush(tc, c, b);
+      if (tc->lists[c].count)
+        thread_cache_flush(tc, c, tc->lists[c].count);
+    }
+
+  lock(&cache_lock);
+  tc->live = 0;
+  unlock(&cache_lock);
+}
+
+static void cache_key_init(void)
+{
+  if (pthread_key_create(&cache_key, thread_cache_destroy) == 0)
+    cache_key_valid = 1;
+}
+
+static struct thread_cache *thread_cache_create(void)
+{
+  struct thread_cache *tc;
+
+  tcache_state = Tc_busy;
+
+  if (pthread_once && pthread_key_create)
+    pthread_once(&cache_key_once, cache_key_init);
+
+  lock(&cache_lock);
+  for (tc = all_caches; tc; tc = tc->next)
+    if (!tc->live)
+      break;
+
+  if (!tc)
+    {
+      if (!cache_bump || cache_bump + sizeof(*tc) > cache_end)
+        {
+          struct span *s = span_alloc();
+          if (!s)
+            {
+              unlock(&cache_lock);
+              tcache_state = Tc_none;
+              return NULL;
+            }
+          cache_bump = (char *)s;
+          cache_end = cache_bump + Span_size;
+        }
+      tc = (struct thread_cache *)cache_bump;
+      cache_bump += sizeof(*tc);
+      tc->next = all_caches;
+      all_caches = tc;
+    }
+
+  memset(tc->lists, 0, sizeof(tc->lists));
+  tc->live = 1;
+  unlock(&cache_lock);
+
+  /* May allocate, which is served by the depot while we are busy. */
+  if (cache_key_valid)
+    pthread_setspecific(cache_key, tc);
+
+  tcache = tc;
+  tcache_state = Tc_none;
+  return tc;
+}
+
+static inline struct thread_cache *thread_cache(void)
+{
+  if (L4_LIKELY(tcache != NULL))
+    return tcache;
+  if (tcache_state != Tc_none)
+    return NULL;
+  return thread_cache_create();
+}
+
+/* ---- allocation ---- */
+
+static void *large_alloc(size_t n, size_t align)
+{
+  size_t size, len;
+  char *m, *p, *start, *end;
+  struct large_hdr *h;
+
+  if (align < Span_size)
+    align = Span_size;
+
+  size = l4_round_page(n);
+  len = L4_PAGESIZE + size + align;
+  if (size < n || len < size)
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+
+  m = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED)
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+
+  p = (char *)(((uintptr_t)m + L4_PAGESIZE + align - 1)
+               & ~(uintptr_t)(align - 1));
+  start = p - L4_PAGESIZE;
+  end = p + size;
+  if (start > m)
+    munmap(m, start - m);
+  if (m + len > end)
+    munmap(end, m + len - end);
+
+  h = (struct large_hdr *)start;
+  h->len = end - start;
+
+  __atomic_add_fetch(&large_bytes, h->len, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&large_count, 1, __ATOMIC_RELAXED);
+  return p;
+}
+
+static void large_free(void *p)
+{
+  struct large_hdr *h = (struct large_hdr *)((char *)p - L4_PAGESIZE);
+  size_t len = h->len;
+
+  __atomic_sub_fetch(&large_bytes, len, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&large_count, 1, __ATOMIC_RELAXED);
+  munmap(h, len);
+}
+
+static size_t usable_size(void const *p)
+{
+  if (is_large(p))
+    return ((struct large_hdr const *)((char const *)p - L4_PAGESIZE))->len
+           - L4_PAGESIZE;
+  return class_size(span_of(p)->cls);
+}
+
+static void *small_alloc(unsigned c)
+{
+  struct thread_cache *tc = thread_cache();
+  struct cache_list *l;
+  void *o;
+
+  if (L4_LIKELY(tc != NULL))
+    {
+      l = &tc->lists[c];
+      if (L4_LIKELY(l->head != NULL))
+        {
+          o = l->head;
+          l->head = obj_next(o);
+          --l->count;
+          return o;
+        }
+
+      l->count = central_fetch(c, class_batch(c), &l->head);
+      if (!l->count)
+        {
+          errno = ENOMEM;
+          return NULL;
+        }
+
+      o = l->head;
+      l->head = obj_next(o);
+      --l->count;
+      return o;
+    }
+
+  if (!central_fetch(c, 1, &o))
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+  return o;
+}
+
+void *malloc(size_t n)
+{
+  if (n > Max_small)
+    return large_alloc(n, Min_align);
+
+  return small_alloc(size_class(n));
+}
+
+void free(void *p)
+{
+  struct thread_cache *tc;
+  struct cache_list *l;
+  unsigned c;
+
+  if (!p)
+    return;
+
+  if (is_large(p))
+    {
+      large_free(p);
+      return;
+    }
+
+  c = span_of(p)->cls;
+  tc = thread_cache();
+  if (L4_UNLIKELY(tc == NULL))
+    {
+      obj_set_next(p, NULL);
+      central_release(c, p, 1);
+      return;
+    }
+
+  l = &tc->lists[c];
+  obj_set_next(p, l->head);
+  l->head = p;
+  if (++l->count > 2 * class_batch(c))
+    thread_cache_flush(tc, c, class_batch(c));
+}
+
+void *calloc(size_t n, size_t size)
+{
+  size_t bytes;
+  void *p;
+
+  if (__builtin_mul_overflow(n, size, &bytes))
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+
+  p = malloc(bytes);
+  /* Large allocations are fresh anonymous memory. */
+  if (p && !is_large(p))
+    memset(p, 0, bytes);
+  return p;
+}
+
+void *realloc(void *p, size_t n)
+{
+  size_t old;
+  void *np;
+
+  if (!p)
+    return malloc(n);
+
+  if (!n)
+    {
+      free(p);
+      return NULL;
+    }
+
+  old = usable_size(p);
+  if (n <= old && (is_large(p) ? n > old / 2 : size_class(n) == span_of(p)->cls))
+    return p;
+
+  np = malloc(n);
+  if (!np)
+    return NULL;
+
+  memcpy(np, p, n < old ? n : old);
+  free(p);
+  return np;
+}
+
+void *memalign(size_t align, size_t n)
+{
+  unsigned c;
+
+  if (align & (align - 1))
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  if (align <= Min_align)
+    return malloc(n);
+
+  if (n <= Max_small && align <= Max_class_align)
+    for (c = size_class(n < align ? align : n); c < Num_classes; c++)
+      if ((class_size(c) & (align - 1)) == 0)
+        return small_alloc(c);
+
+  return large_alloc(n, align);
+}
+
+int posix_memalign(void **res, size_t align, size_t n)
+{
+  void *p;
+
+  if (align % sizeof(void *) || (align & (align - 1)))
+    return EINVAL;
+
+  p = memalign(align, n);
+  if (!p)
+    return ENOMEM;
+
+  *res = p;
+  return 0;
+}
+
+void *valloc(size_t n)
+{
+  return memalign(L4_PAGESIZE, n);
+}
+
+int mallopt(int param, int value)
+{
+  (void)param;
+  (void)value;
+  return 0;
+}
+
+/* Return the objects in the depot of class `c` to their spans. */
+static void central_drain(unsigned c)
+{
+  struct central *z = &central[c];
+
+  lock(&z->lock);
+  while (z->nbatches)
+    {
+      void *o = z->batches[--z->nbatches];
+      while (o)
+        {
+          void *next = obj_next(o);
+          central_put(z, o);
+          o = next;
+        }
+    }
+  unlock(&z->lock);
+}
+
+int malloc_trim(size_t pad)
+{
+  struct span *s;
+  int released = 0;
+  unsigned c;
+
+  (void)pad;
+
+  for (c = 0; c < Num_classes; c++)
+    central_drain(c);
+
+  lock(&heap_lock);
+  while ((s = free_spans))
+    {
+      free_spans = s->next;
+      --nfree_spans;
+      unlock(&heap_lock);
+      munmap(s, Span_size);
+      released = 1;
+      lock(&heap_lock);
+    }
+  unlock(&heap_lock);
+
+  return released;
+}
+
+/* ---- statistics ---- */
+
+struct class_stats
+{
+  unsigned long spans, used, cached, depot;
+};
+
+static void class_stats(unsigned c, struct class_stats *st)
+{
+  struct central *z = &central[c];
+  struct thread_cache *tc;
+  unsigned long held;
+
+  lock(&z->lock);
+  st->spans = z->spans;
+  st->used = z->used;
+  st->depot = z->nbatches * class_batch(c);
+  unlock(&z->lock);
+
+  st->cached = 0;
+  lock(&cache_lock);
+  for (tc = all_caches; tc; tc = tc->next)
+    if (tc->live)
+      st->cached += __atomic_load_n(&tc->lists[c].count, __ATOMIC_RELAXED);
+  unlock(&cache_lock);
+
+  /* Objects in thread caches and the depot count as handed out from their
+     span, but are not in use. */
+  held = st->depot + st->cached;
+  st->used = st->used > held ? st->used - held : 0;
+}
+
+struct mallinfo mallinfo(void)
+{
+  struct mallinfo mi;
+  unsigned long used = 0, cached = 0, spans = 0;
+  unsigned c;
+
+  memset(&mi, 0, sizeof(mi));
+
+  for (c = 0; c < Num_classes; c++)
+    {
+      struct class_stats st;
+      class_stats(c, &st);
+      used += st.used * class_size(c);
+      cached += (st.cached + st.depot) * class_size(c);
+      spans += st.spans;
+    }
+
+  lock(&heap_lock);
+  mi.arena = span_bytes;
+  mi.keepcost = nfree_spans * Span_size;
+  unlock(&heap_lock);
+
+  mi.ordblks = spans;
+  mi.smblks = cached;
+  mi.hblks = __atomic_load_n(&large_count, __ATOMIC_RELAXED);
+  mi.hblkhd = __atomic_load_n(&large_bytes, __ATOMIC_RELAXED);
+  mi.uordblks = used + mi.hblkhd;
+  mi.fordblks = mi.arena - used;
+  return mi;
+}
+
+/*
+ * Fragmentation report: per size class, the mapped spans and how their
+ * objects split into used ones, ones cached in threads or the depot, and
+ * free ones.
+ */
+void malloc_stats(FILE *f)
+{
+  unsigned long used = 0, cached = 0, mapped = 0;
+  unsigned c;
+
+  if (!f)
+    f = stderr;
+
+  fprintf(f, "%5s %7s %6s %9s %9s %9s %6s\n",
+          "class", "size", "spans", "used", "cached", "free", "util");
+
+  for (c = 0; c < Num_classes; c++)
+    {
+      struct class_stats st;
+      unsigned long cap, free_objs;
+
+      class_stats(c, &st);
+      if (!st.spans)
+        continue;
+
+      cap = st.spans * class_capacity(c);
+      free_objs = cap - st.used - st.cached - st.depot;
+      fprintf(f, "%5u %7zu %6lu %9lu %9lu %9lu %5lu%%\n",
+              c, class_size(c), st.spans, st.used, st.cached + st.depot,
+              free_objs, st.used * 100 / cap);
+
+      used += st.used * class_size(c);
+      cached += (st.cached + st.depot) * class_size(c);
+      mapped += st.spans * Span_size;
+    }
+
+  fprintf(f, "small: %lu KiB mapped, %lu KiB used, %lu KiB cached, "
+             "%lu%% fragmentation\n",
+          mapped >> 10, used >> 10, cached >> 10,
+          mapped ? 100 - used * 100 / mapped : 0);
+  fprintf(f, "large: %lu allocations, %lu KiB mapped\n",
+          __atomic_load_n(&large_count, __ATOMIC_RELAXED),
+          __atomic_load_n(&large_bytes, __ATOMIC_RELAXED) >> 10);
+  fprintf(f, "free spans kept: %u (%lu KiB)\n",
+          nfree_spans, ((unsigned long)nfree_spans * Span_size) >> 10);
+}
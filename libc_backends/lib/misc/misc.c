@@ -484,12 +484,3 @@ char *secure_getenv(const char *name)
 {
   return getenv(name);
 }
-
-#include <fcntl.h>
-
-int posix_fadvise64(int fd, off64_t offset, off64_t len, int advice)
-{
-  printf("posix_fadvise64(%d, %lld, %lld, %d): void\n",
-         fd, (unsigned long long)offset, (unsigned long long)len, advice);
-  return 0;
-}
@@ -50,6 +50,7 @@
 #define SIGMA0_REQ_ID_TBUF		  0xB0     /**< TBUF */
 #define SIGMA0_REQ_ID_DEBUG_DUMP	  0xC0     /**< Debug dump */
 #define SIGMA0_REQ_ID_NEW_CLIENT	  0xD0     /**< New client */
+#define SIGMA0_REQ_ID_FPAGE_ANY_MULTI	  0xE0     /**< Any, several pages */
 
 #define SIGMA0_IS_MAGIC_REQ(d1)	\
   ((d1 & SIGMA0_REQ_MASK) == SIGMA0_REQ_MAGIC)     /**< Check if magic */
@@ -66,6 +67,7 @@
 #define SIGMA0_REQ_TBUF	                (SIGMA0_REQ(TBUF))               /**< TBUF */
 #define SIGMA0_REQ_DEBUG_DUMP           (SIGMA0_REQ(DEBUG_DUMP))         /**< Debug dump */
 #define SIGMA0_REQ_NEW_CLIENT           (SIGMA0_REQ(NEW_CLIENT))         /**< New client */
+#define SIGMA0_REQ_FPAGE_ANY_MULTI      (SIGMA0_REQ(FPAGE_ANY_MULTI))    /**< Any, several pages */
 /*@}*/
 
 /**
@@ -164,6 +166,31 @@ L4_CV int l4sigma0_map_anypage(l4_cap_idx_t sigma0, l4_addr_t map_area,
                                unsigned log2_map_size, l4_addr_t *base,
                                unsigned sz);
 
+/**
+ * \brief Request several arbitrary free pages of RAM with one IPC.
+ *
+ * This function is similar to l4sigma0_map_anypage() but asks sigma0 for up
+ * to `num` pages of the same size at once. All pages are received in the
+ * same receive window.
+ *
+ * \param sigma0        usually the thread id of sigma0.
+ * \param map_area      the base address of the local virtual memory area
+ *                      where the pages should be mapped.
+ * \param log2_map_size the size of the receive window log 2.
+ * \param[out] bases    physical addresses of the pages received, must have
+ *                      room for `num` entries.
+ * \param num           the maximum number of pages to request. Sigma0 may
+ *                      return fewer pages, at most one per two message
+ *                      registers.
+ * \param sz            Size of each page, in 2^sz bytes.
+ *
+ * \return The number of pages received, or a negative error code (see
+ *         l4sigma0_map_errstr()).
+ */
+L4_CV int l4sigma0_map_anypages(l4_cap_idx_t sigma0, l4_addr_t map_area,
+                                unsigned log2_map_size, l4_addr_t *bases,
+                                unsigned num, unsigned sz);
+
 /**
  * \brief Request Fiasco trace buffer.
  *
@@ -55,3 +55,52 @@ l4sigma0_map_anypage(l4_cap_idx_t pager, l4_addr_t map_area,
 
   return 0;
 }
+
+/**
+ * Map several pages of anonymous memory.
+ *
+ * \param pager          pager implementing the Sigma0 protocol
+ * \param map_area       virtual address of the map area
+ * \param log2_map_size  size of the map area
+ * \param bases          physical addresses of the received pages
+ * \param num            maximum number of pages
+ * \param sz             Size of each page from the server, in log2.
+ * \return           number of pages received on success
+ *                  -#L4SIGMA0_IPCERROR IPC error
+ *                  -#L4SIGMA0_NOFPAGE  no fpage received
+ */
+L4_CV int
+l4sigma0_map_anypages(l4_cap_idx_t pager, l4_addr_t map_area,
+                      unsigned log2_map_size, l4_addr_t *bases,
+                      unsigned num, unsigned sz)
+{
+  l4_msgtag_t tag = l4_msgtag(L4_PROTO_SIGMA0, 3, 0, 0);
+  l4_utcb_t *utcb = l4_utcb();
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  l4_buf_regs_t *b = l4_utcb_br_u(utcb);
+  unsigned i, items;
+
+  m->mr[0] = SIGMA0_REQ_FPAGE_ANY_MULTI;
+  m->mr[1] = l4_fpage(0, sz, 0).raw;
+  m->mr[2] = num;
+
+  b->bdr = 0;
+  b->br[0] = L4_ITEM_MAP;
+  b->br[1] = l4_fpage(map_area, log2_map_size, L4_FPAGE_RWX).raw;
+
+  tag = l4_ipc_call(pager, utcb, tag, L4_IPC_NEVER);
+  if (l4_ipc_error(tag, utcb))
+    return -L4SIGMA0_IPCERROR;
+
+  items = l4_msgtag_items(tag);
+  if (!items)
+    return -L4SIGMA0_NOFPAGE;
+
+  if (items > num)
+    items = num;
+
+  for (i = 0; i < items; ++i)
+    bases[i] = m->mr[2 * i] & (~0UL << L4_PAGESHIFT);
+
+  return items;
+}
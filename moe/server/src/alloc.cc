@@ -29,6 +29,8 @@
 #include "name_space.h"
 #include "log.h"
 #include "sched_proxy.h"
+#include "threads.h"
+#include "zero_pool.h"
 
 static Dbg dbg(Dbg::Warn | Dbg::Server);
 
@@ -55,8 +57,13 @@ Allocator::alloc(long size, unsigned long flags, unsigned long align)
       if (size < 0)
         throw L4::Bounds_error("invalid size");
 
-      mo = Moe::Dataspace_noncont::create(qalloc(), size);
-      Obj_list::insert_after(mo, Obj_list::iter(this));
+      // superpage-sized chunks are backed with superpages where possible,
+      // unless the client wants every first touch to stay small
+      bool superpages = !(flags & L4Re::Mem_alloc::No_super_pages);
+      mo = Moe::Dataspace_noncont::create(qalloc(), size,
+                                          Moe::Dataspace::Writable,
+                                          _fault_around_shift, superpages);
+      add_child(mo);
     }
 
   // L4::cout << "A: mo=" << mo << "\n";
@@ -77,6 +84,8 @@ Allocator::~Allocator()
          && Moe::Malloc_container::from_ptr(*it) == qalloc())
     delete *it;
 
+  // cached malloc pages still count towards the quota
+  qalloc()->flush_cache();
   if (qalloc()->quota()->used() > 0)
     dbg.printf("WARNING: destroyed allocator still holds resources.");
 
@@ -140,8 +149,23 @@ Allocator::op_create(L4::Factory::Rights, L4::Ipc::Cap<void> &res,
 
           if (!tag.is_of_int() || tag.value<long>() == 0) // ignore sign
             return -L4_EINVAL;
+
+          // optional fault-around window, inherited from this allocator
+          unsigned char fa_shift = _fault_around_shift;
+          L4::Ipc::Varg fa = args.next();
+          if (fa.is_of_int())
+            {
+              if (!valid_fault_around_shift(fa.value<l4_umword_t>()))
+                return -L4_EINVAL;
+
+              fa_shift = fa.value<l4_umword_t>();
+            }
+
           Moe::Quota_guard g(_qalloc.quota(), tag.value<long>());
-          cxx::unique_ptr<Allocator> o(make_obj<Allocator>(tag.value<long>()));
+          cxx::unique_ptr<Allocator> o(make_obj<Allocator>(tag.value<long>(),
+                                                           0, fa_shift));
+          // objects created by the new factory are served by its thread
+          o->server_thread(Moe::Threads::next_server());
           ko = object_pool.cap_alloc()->alloc(o.get());
           ko->dec_refcnt(1);
           o.release();
@@ -260,6 +284,17 @@ Allocator::op_debug(L4Re::Debug_obj::Rights, unsigned long)
                _qalloc.quota()->used(),  _qalloc.quota()->used()  / (1<<20),
                _qalloc.quota()->limit() - _qalloc.quota()->used(),
                (_qalloc.quota()->limit() - _qalloc.quota()->used()) / (1<<20));
+  _qalloc.dump_stats(out);
+  if (_fault_around_shift)
+    out.printf("fault-around: %lu KB\n", (1UL << _fault_around_shift) >> 10);
+  else
+    out.printf("fault-around: off\n");
+  typedef Moe::Dataspace_noncont::Fault_stats Stats;
+  Stats const &fs = Moe::Dataspace_noncont::fault_stats;
+  out.printf("noncont faults: %lu, windows: %lu (%lu pages), superpages: %lu\n",
+             Stats::get(fs.requests), Stats::get(fs.windows),
+             Stats::get(fs.window_pages), Stats::get(fs.superpages));
+  Moe::Zero_pool::dump(out);
   out.printf("global: avail: %lu bytes (%lu MB)\n",
              Single_page_alloc_base::_avail(),
              Single_page_alloc_base::_avail() / (1<<20));
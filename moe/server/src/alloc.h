@@ -33,22 +33,42 @@ private:
   Moe::Q_alloc _qalloc;
   long _sched_prio_limit;
   l4_umword_t _sched_cpu_mask;
+  unsigned char _fault_around_shift;
 
 public:
-  explicit Allocator(size_t limit, unsigned prio_limit = 0)
-  : _qalloc(limit), _sched_prio_limit(prio_limit), _sched_cpu_mask(~0UL)
+  explicit Allocator(size_t limit, unsigned prio_limit = 0,
+                     unsigned char fault_around_shift = 0)
+  : _qalloc(limit), _sched_prio_limit(prio_limit), _sched_cpu_mask(~0UL),
+    _fault_around_shift(fault_around_shift)
   {}
 
   template<typename T, typename ...ARGS>
   T *make_obj(ARGS &&...args)
   {
     T *o = qalloc()->make_obj<T>(cxx::forward<ARGS>(args)...);
-    Obj_list::insert_after(o, Obj_list::iter(this));
+    add_child(o);
     return o;
   }
 
   Moe::Q_alloc *qalloc() { return &_qalloc; }
 
+  /**
+   * Get the fault-around window of noncontiguous dataspaces.
+   *
+   * \return log2 of the window size, 0 if fault-around is disabled.
+   */
+  unsigned char fault_around_shift() const { return _fault_around_shift; }
+
+  /**
+   * Set the fault-around window for newly created noncontiguous dataspaces.
+   *
+   * \param shift  log2 of the window size, 0 disables fault-around.
+   */
+  void fault_around_shift(unsigned char shift) { _fault_around_shift = shift; }
+
+  static bool valid_fault_around_shift(unsigned long shift)
+  { return shift == 0 || (shift > L4_PAGESHIFT && shift <= L4_SUPERPAGESHIFT); }
+
   Moe::Dataspace *alloc(long size, unsigned long flags = 0,
                         unsigned long align = 0);
 
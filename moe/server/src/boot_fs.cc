@@ -17,6 +17,7 @@
 #include "boot_fs.h"
 #include "dataspace_static.h"
 #include "page_alloc.h"
+#include "pages.h"
 #include "globals.h"
 #include "name_space.h"
 #include "debug.h"
@@ -156,6 +157,10 @@ Moe::Boot_fs::init_stage2()
       if (m_high < l4_round_page(end))
         m_high = l4_round_page(end);
 
+      // the pages are requested from sigma0 in batches, but copy on write
+      // needs their descriptors right away
+      Moe::Pages::add_ram(l4_trunc_page(s), l4_round_page(end));
+
       cxx::String opts;
       cxx::String name = cmdline_to_name((char const *)(unsigned long)modules[mod].cmdline, &opts);
       unsigned flags = Dataspace::Cow_enabled;
@@ -46,6 +46,7 @@ Moe::Dataspace::map(l4_addr_t offs, l4_addr_t hot_spot, unsigned long flags,
     }
 
   Ds_rw rw = (flags & Writable) ? Writable : Read_only;
+  Lock_guard<Spin_lock> g(_lock);
   Address adr = address(offs, rw, hot_spot, min, max);
   if (adr.is_nil())
     return -L4_EPERM;
@@ -106,6 +107,20 @@ Moe::Dataspace::op_copy_in(L4Re::Dataspace::Rights obj,
   if (sz == 0)
     return L4_EOK;
 
+  if (src == this)
+    {
+      Lock_guard<Spin_lock> g(_lock);
+      Dataspace_util::copy(this, dst_offs, src, src_offs, sz);
+      return L4_EOK;
+    }
+
+  // lock both dataspaces in address order to avoid deadlocks with a copy
+  // in the opposite direction
+  Dataspace *first = cxx::min(this, src);
+  Dataspace *second = cxx::max(this, src);
+  Lock_guard<Spin_lock> g1(first->_lock);
+  Lock_guard<Spin_lock> g2(second->_lock);
+
   Dataspace_util::copy(this, dst_offs, src, src_offs, sz);
 
   return L4_EOK;
@@ -19,6 +19,7 @@
 #include "dma_space.h"
 #include "server_obj.h"
 #include "globals.h"
+#include "lock.h"
 #include "quota.h"
 
 namespace Moe {
@@ -91,6 +92,15 @@ public:
   virtual bool is_static() const throw() = 0;
   virtual long clear(unsigned long offs, unsigned long size) const throw();
 
+  /**
+   * Lock serializing changes to the pages of the dataspace.
+   *
+   * Page faults of regions attached to the dataspace and requests to the
+   * dataspace itself may be served by different server threads. The lock
+   * must be held while calling address(), clear() or pre_allocate().
+   */
+  Spin_lock &lock() const throw() { return _lock; }
+
 protected:
   void size(unsigned long size) throw() { _size = size; }
 
@@ -134,7 +144,10 @@ public:
 
   long op_allocate(L4Re::Dataspace::Rights rights,
                    l4_addr_t offset, l4_size_t size)
-  { return pre_allocate(offset, size, rights & 3); }
+  {
+    Lock_guard<Spin_lock> g(_lock);
+    return pre_allocate(offset, size, rights & 3);
+  }
 
   long op_phys(L4Re::Dataspace::Rights,
                l4_addr_t offset, l4_addr_t &phys_addr,
@@ -142,6 +155,7 @@ public:
   {
     phys_size = (l4_size_t)~0;
     L4Re::Dma_space::Dma_addr pa = phys_addr;
+    Lock_guard<Spin_lock> g(_lock);
     int r = dma_map(0, offset, &phys_size, Dma_attribs::None,
                     L4Re::Dma_space::Bidirectional, &pa);
     if (r < 0)
@@ -171,11 +185,13 @@ public:
         || !is_writable())
       return -L4_EACCESS;
 
+    Lock_guard<Spin_lock> g(_lock);
     return clear(offset, size);
   }
 
 
 private:
+  mutable Spin_lock _lock;
   unsigned long  _size;
   unsigned short _flags;
   unsigned char  _page_shift;
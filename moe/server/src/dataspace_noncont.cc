@@ -44,9 +44,88 @@ Moe::Dataspace_noncont::free_page(Page &p) const throw()
   p.set(0, 0);
 }
 
+Moe::Dataspace_noncont::Fault_stats Moe::Dataspace_noncont::fault_stats;
+
+bool
+Moe::Dataspace_noncont::window_fits(l4_addr_t offset, l4_addr_t hot_spot,
+                                    unsigned char order) const throw()
+{
+  l4_addr_t pg_offs = l4_trunc_size(offset, page_shift());
+
+  // the window must be congruent to the hot spot of the receive window
+  if ((pg_offs ^ l4_trunc_size(hot_spot, page_shift())) & ((1UL << order) - 1))
+    return false;
+
+  return l4_trunc_size(pg_offs, order) + (1UL << order) <= round_size();
+}
+
+Moe::Dataspace::Address
+Moe::Dataspace_noncont::map_window(l4_addr_t offset, Ds_rw rw,
+                                   unsigned char order) const
+{
+  unsigned long ps = page_size();
+  unsigned long w_size = 1UL << order;
+  l4_addr_t base = l4_trunc_size(offset, order);
+  char *w;
+
+  if (!page(base).valid())
+    {
+      // populate the window only if it is completely empty, this also
+      // allocates the meta data before we get the window memory
+      for (l4_addr_t o = base; o < base + w_size; o += ps)
+        if (alloc_page(o).valid())
+          return Address(-L4_EEXIST);
+
+      w = (char *)qalloc()->alloc_pages(w_size, w_size,
+                                        Single_page_alloc_base::nothrow);
+      if (!w)
+        return Address(-L4_ENOMEM);
+
+      memset(w, 0, w_size);
+      // No need for I cache coherence, as we just zero fill and assume that
+      // this is no executable code
+      l4_cache_clean_data((l4_addr_t)w, (l4_addr_t)w + w_size - 1);
+
+      // every page keeps its own descriptor, so that copy on write and
+      // clear() can still split the window into single pages
+      for (unsigned long i = 0; i < w_size; i += ps)
+        alloc_page(base + i).set(w + i, 0);
+
+      if (order == Moe::Pages::Chunk_shift)
+        Moe::Pages::share_superpage(w);
+      else
+        for (unsigned long i = 0; i < w_size; i += ps)
+          Moe::Pages::share(w + i);
+    }
+  else
+    {
+      // an already populated window can be mapped at once if it is backed
+      // by an aligned, physically contiguous run of pages, pages of shared
+      // page tables must not be mapped writable
+      if (rw == Writable)
+        own_page(base);
+
+      w = (char *)*page(base);
+      if ((l4_addr_t)w & (w_size - 1))
+        return Address(-L4_EINVAL);
+
+      for (unsigned long i = 0; i < w_size; i += ps)
+        {
+          Page const &p = page(base + i);
+          if (*p != w + i)
+            return Address(-L4_EINVAL);
+
+          if (rw == Writable && (p.flags() & Page_cow))
+            return Address(-L4_EINVAL);
+        }
+    }
+
+  return Address(l4_addr_t(w), order, rw, offset & (w_size - 1));
+}
+
 Moe::Dataspace::Address
 Moe::Dataspace_noncont::address(l4_addr_t offset,
-                                Ds_rw rw, l4_addr_t,
+                                Ds_rw rw, l4_addr_t hot_spot,
                                 l4_addr_t, l4_addr_t) const
 {
   // XXX: There may be a problem with data spaces with
@@ -55,11 +134,58 @@ Moe::Dataspace_noncont::address(l4_addr_t offset,
   if (!check_limit(offset))
     return Address(-L4_ERANGE);
 
-  Page &p = alloc_page(offset);
+  Fault_stats::inc(&fault_stats.requests);
 
   if (!is_writable())
     rw = Read_only;
 
+  if (_superpages && window_fits(offset, hot_spot, L4_SUPERPAGESHIFT))
+    {
+      Address a = map_window(offset, rw, L4_SUPERPAGESHIFT);
+      if (!a.is_nil())
+        {
+          if (rw == Writable)
+            mapped_writable(offset);
+
+          Fault_stats::inc(&fault_stats.superpages);
+          return a;
+        }
+    }
+
+  // use the largest fault-around window that fits the receive window
+  for (unsigned char order = _fault_around_shift; order > page_shift();
+       --order)
+    {
+      if (!window_fits(offset, hot_spot, order))
+        continue;
+
+      Address a = map_window(offset, rw, order);
+      if (!a.is_nil())
+        {
+          if (rw == Writable)
+            mapped_writable(offset);
+
+          Fault_stats::inc(&fault_stats.windows);
+          Fault_stats::inc(&fault_stats.window_pages,
+                           1UL << (order - page_shift()));
+          return a;
+        }
+
+      break;
+    }
+
+  if (rw == Read_only)
+    {
+      // existing pages can be mapped read-only without modifying any meta
+      // data, this keeps shared page tables shared
+      Page const &p = page(offset);
+      if (p.valid())
+        return Address(l4_addr_t(*p), page_shift(), rw,
+                       offset & (page_size() - 1));
+    }
+
+  Page &p = alloc_page(offset);
+
   if ((rw == Writable) && (p.flags() & Page_cow))
     {
       if (Moe::Pages::ref_count(*p) == 1)
@@ -86,14 +212,13 @@ Moe::Dataspace_noncont::address(l4_addr_t offset,
 
   if (!*p)
     {
-      p.set(qalloc()->alloc_pages(page_size(), page_size()), 0);
+      p.set(qalloc()->alloc_zeroed_page(), 0);
       Moe::Pages::share(*p);
-      memset(*p, 0, page_size());
-      // No need for I cache coherence, as we just zero fill and assume that
-      // this is no executable code
-      l4_cache_clean_data((l4_addr_t)*p, (l4_addr_t)(*p) + page_size() - 1);
     }
 
+  if (rw == Writable)
+    mapped_writable(offset);
+
   return Address(l4_addr_t(*p), page_shift(), rw, offset & (page_size()-1));
 }
 
@@ -144,7 +269,8 @@ Moe::Dataspace_noncont::clear(unsigned long offs, unsigned long _size) const thr
   while (u_sz)
     {
       // printf("ds free page offs %lx\n", offs);
-      free_page(page(offs));
+      if (page(offs).valid())
+        free_page(own_page(offs));
       offs += pg_sz;
       u_sz -= pg_sz;
     }
@@ -186,8 +312,9 @@ namespace {
   public:
     unsigned long meta_size() const throw()
     { return (l4_round_size(num_pages()*sizeof(unsigned long), Meta_align_bits)); }
-    Mem_small(unsigned long size, unsigned long flags)
-    : Moe::Dataspace_noncont(size, flags)
+    Mem_small(unsigned long size, unsigned long flags,
+              unsigned char fault_around_shift)
+    : Moe::Dataspace_noncont(size, flags, fault_around_shift)
     {
       _pages = (Page *)qalloc()->alloc_pages(meta_size(), Meta_align);
       memset(_pages, 0, meta_size());
@@ -221,20 +348,36 @@ namespace {
     { return meta2_size() / sizeof(Page *); }
 
   private:
+    /**
+     * First-level entry, pointing to a second-level table.
+     *
+     * Second-level tables may be shared between dataspaces. The reference
+     * count of the page holding the table counts the first-level entries
+     * referencing it.
+     */
     class L1
     {
     private:
       unsigned long p;
 
     public:
+      enum
+      {
+        /// Pages of the table may be mapped writable.
+        W_mapped = 0x1UL,
+      };
+
       Page *l2() const throw() { return (Page*)(p & ~0xfffUL); }
       Page &operator [] (unsigned idx) throw()
       { return l2()[idx]; }
       Page *operator * () const throw() { return l2(); }
-      unsigned long cnt() const throw() { return p & 0xfffUL; }
-      void inc() throw() { p = (p & ~0xfffUL) | (((p & 0xfffUL)+1) & 0xfffUL); }
-      void dec() throw() { p = (p & ~0xfffUL) | (((p & 0xfffUL)-1) & 0xfffUL); }
+      unsigned long flags() const throw() { return p & 0xfffUL; }
+      void flags(unsigned long add, unsigned long del = 0) throw()
+      { p = (p & ~(del & 0xfffUL)) | (add & 0xfffUL); }
       void set(void* _p) throw() { p = (unsigned long)_p; }
+
+      bool shared() const throw()
+      { return l2() && Moe::Pages::ref_count(l2()) > 1; }
     };
 
     L1 &__p(unsigned long offs) const throw()
@@ -250,24 +393,21 @@ namespace {
     long meta1_size() const throw()
     { return l4_round_size(entries1() * sizeof(L1 *), 10); }
 
-    Mem_big(unsigned long size, unsigned long flags)
-    : Moe::Dataspace_noncont(size, flags)
+    Mem_big(unsigned long size, unsigned long flags,
+            unsigned char fault_around_shift, bool superpages)
+    : Moe::Dataspace_noncont(size, flags, fault_around_shift)
     {
+      // transparently back superpage-sized chunks with superpages
+      _superpages = superpages && L4_SUPERPAGESHIFT > page_shift();
+
       _pages = (Page *)qalloc()->alloc_pages(meta1_size(), 1024);
       memset(_pages, 0, meta1_size());
     }
 
     ~Mem_big() throw()
     {
-      for (unsigned long i = 0; i < size(); i += page_size())
-        free_page(page(i));
-
       for (L1 *p = (L1 *)_pages; p != (L1 *)_pages + entries1(); ++p)
-        {
-          if (**p)
-            qalloc()->free_pages(**p, meta2_size());
-          p->set(0);
-        }
+        release_table(*p);
 
       qalloc()->free_pages(_pages, meta1_size());
     }
@@ -288,25 +428,154 @@ namespace {
         {
           void *a = qalloc()->alloc_pages(meta2_size(), meta2_size());
           assert (((l4_addr_t)a & 0xfff) == 0);
-          _p.set(a);
           memset(a, 0, meta2_size());
+          Moe::Pages::share(a);
+          _p.set(a);
         }
+      else
+        own_table(_p);
 
       return _p[l2_idx(offs)];
     }
+
+    Page &own_page(unsigned long offs) const
+    {
+      L1 &_p = __p(offs);
+      if (!*_p)
+        return page(offs);
+
+      return own_table(_p)[l2_idx(offs)];
+    }
+
+    unsigned long table_size() const throw()
+    { return entries2() << page_shift(); }
+
+    unsigned long share_tables(unsigned long offs,
+                               Moe::Dataspace_noncont const *src,
+                               unsigned long src_offs, unsigned long size)
+    {
+      Mem_big const *s = dynamic_cast<Mem_big const *>(src);
+      unsigned long ts = table_size();
+      if (!s || s->page_shift() != page_shift()
+          || ((offs | src_offs) & (ts - 1)))
+        return 0;
+
+      unsigned long done = 0;
+      for (; size - done >= ts
+             && offs + done + ts <= round_size()
+             && src_offs + done + ts <= s->round_size(); done += ts)
+        {
+          L1 &d = __p(offs + done);
+          L1 &e = s->__p(src_offs + done);
+          if (*d == *e)
+            continue;
+
+          release_table(d);
+
+          Page *t = *e;
+          if (!t)
+            continue;
+
+          // from now on the pages are copy on write for both dataspaces
+          if (e.flags() & L1::W_mapped)
+            {
+              unmap_table(t, true);
+              e.flags(0, L1::W_mapped);
+            }
+
+          Moe::Pages::share(t);
+          d.set(t);
+        }
+
+      return done;
+    }
+
+  protected:
+    void mapped_writable(unsigned long offs) const throw()
+    { __p(offs).flags(L1::W_mapped); }
+
+  private:
+    void unmap_table(Page const *t, bool ro) const throw()
+    {
+      for (unsigned i = 0; i < entries2(); ++i)
+        unmap_page(t[i], ro);
+    }
+
+    /**
+     * Make sure the table of `e` is not shared with other dataspaces.
+     *
+     * A shared table is copied and all its pages become copy on write,
+     * in the copy as well as in the table still used by the others.
+     */
+    Page *own_table(L1 &e) const
+    {
+      Page *t = *e;
+      if (!e.shared())
+        return t;
+
+      Page *n = (Page *)qalloc()->alloc_pages(meta2_size(), meta2_size());
+      Moe::Pages::share(n);
+
+      for (unsigned i = 0; i < entries2(); ++i)
+        {
+          if (t[i].valid())
+            {
+              t[i].set(*t[i], t[i].flags() | Page_cow);
+              Moe::Pages::share(*t[i]);
+            }
+
+          n[i] = t[i];
+        }
+
+      if (!Moe::Pages::unshare(t))
+        {
+          // all other dataspaces copied the table concurrently
+          for (unsigned i = 0; i < entries2(); ++i)
+            free_page(t[i]);
+
+          qalloc()->free_pages(t, meta2_size());
+        }
+
+      // pages of the new table were only mapped read-only so far
+      e.set(n);
+      return n;
+    }
+
+    /// Drop the reference of `e` to its table, free it if it was the last.
+    void release_table(L1 &e) const throw()
+    {
+      Page *t = *e;
+      if (!t)
+        return;
+
+      if (Moe::Pages::unshare(t))
+        // our clients may still have read-only mappings
+        unmap_table(t, false);
+      else
+        {
+          for (unsigned i = 0; i < entries2(); ++i)
+            free_page(t[i]);
+
+          qalloc()->free_pages(t, meta2_size());
+        }
+
+      e.set(0);
+    }
   };
 };
 
 
 Moe::Dataspace_noncont *
 Moe::Dataspace_noncont::create(Moe::Q_alloc *q, unsigned long size,
-                               unsigned long flags)
+                               unsigned long flags,
+                               unsigned char fault_around_shift,
+                               bool superpages)
 {
   if (size <= L4_PAGESIZE)
     return q->make_obj<Mem_one_page>(size, flags);
   else if (size <= L4_PAGESIZE * (L4_PAGESIZE / sizeof(unsigned long)))
-    return q->make_obj<Mem_small>(size, flags);
+    return q->make_obj<Mem_small>(size, flags, fault_around_shift);
   else
-    return q->make_obj<Mem_big>(size, flags);
+    return q->make_obj<Mem_big>(size, flags, fault_around_shift, superpages);
 }
 
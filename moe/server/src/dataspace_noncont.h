@@ -46,10 +46,41 @@ public:
     { p = (p & ~Page_addr_mask) | ((unsigned long)a & Page_addr_mask); }
   };
 
+  /**
+   * Page-fault statistics of all noncontiguous dataspaces.
+   *
+   * Updated by all server threads, use inc() and get().
+   */
+  struct Fault_stats
+  {
+    unsigned long requests;     ///< Number of address() requests.
+    unsigned long windows;      ///< Requests served with a fault-around window.
+    unsigned long window_pages; ///< Pages covered by those windows.
+    unsigned long superpages;   ///< Requests served with a superpage.
+
+    static void inc(unsigned long *c, unsigned long n = 1)
+    { __atomic_add_fetch(c, n, __ATOMIC_RELAXED); }
+
+    static unsigned long get(unsigned long const &c)
+    { return __atomic_load_n(&c, __ATOMIC_RELAXED); }
+  };
+
+  static Fault_stats fault_stats;
+
   bool is_static() const throw() { return false; }
 
-  Dataspace_noncont(unsigned long size, unsigned long flags = Writable) throw()
-  : Dataspace(size, flags | Cow_enabled, L4_LOG2_PAGESIZE), _pages(0)
+  /**
+   * \param size                Size of the dataspace in bytes.
+   * \param flags               Dataspace flags.
+   * \param fault_around_shift  log2 of the size of the naturally aligned
+   *                            window that is populated and mapped at once
+   *                            on a page fault. Values not bigger than the
+   *                            page shift disable fault-around.
+   */
+  Dataspace_noncont(unsigned long size, unsigned long flags = Writable,
+                    unsigned char fault_around_shift = 0) throw()
+  : Dataspace(size, flags | Cow_enabled, L4_LOG2_PAGESIZE), _pages(0),
+    _fault_around_shift(fault_around_shift), _superpages(false)
   {}
 
   virtual ~Dataspace_noncont() {}
@@ -64,6 +95,41 @@ public:
   virtual Page &page(unsigned long offs) const throw() = 0;
   virtual Page &alloc_page(unsigned long offs) const = 0;
 
+  /**
+   * Get the descriptor of the page at `offs` for modification.
+   *
+   * In contrast to page() the descriptor is never shared with another
+   * dataspace, but no meta data is allocated for empty parts.
+   */
+  virtual Page &own_page(unsigned long offs) const
+  { return page(offs); }
+
+  /**
+   * Size of the part of the dataspace covered by one page table that can
+   * be shared with share_tables(), or 0 if sharing is not supported.
+   */
+  virtual unsigned long table_size() const throw()
+  { return 0; }
+
+  /**
+   * Copy the contents of `src` by sharing whole page tables.
+   *
+   * \param offs      Offset in this dataspace, aligned to table_size().
+   * \param src       Source dataspace.
+   * \param src_offs  Offset in `src`, aligned to table_size().
+   * \param size      Maximum number of bytes to copy.
+   *
+   * \return Number of bytes copied, a multiple of table_size().
+   *
+   * The pages of shared tables are copy on write for all dataspaces
+   * referencing the table, the table is copied on the first modification.
+   */
+  virtual unsigned long share_tables(unsigned long /*offs*/,
+                                     Dataspace_noncont const * /*src*/,
+                                     unsigned long /*src_offs*/,
+                                     unsigned long /*size*/)
+  { return 0; }
+
   unsigned long num_pages() const throw()
   { return (size()+page_size()-1) / page_size(); }
 
@@ -84,11 +150,25 @@ private:
   void free_page(Page &p) const throw();
   void unmap_page(Page const &p, bool ro = false) const throw();
 
+protected:
+  /// Called when the page at `offs` is handed out writable.
+  virtual void mapped_writable(unsigned long /*offs*/) const throw() {}
+
 public:
   long clear(unsigned long offs, unsigned long size) const throw();
 
   static Dataspace_noncont *create(Q_alloc *q, unsigned long size,
-                                   unsigned long flags = Writable);
+                                   unsigned long flags = Writable,
+                                   unsigned char fault_around_shift = 0,
+                                   bool superpages = true);
+
+  unsigned char fault_around_shift() const throw()
+  { return _fault_around_shift; }
+
+private:
+  bool window_fits(l4_addr_t offset, l4_addr_t hot_spot,
+                   unsigned char order) const throw();
+  Address map_window(l4_addr_t offset, Ds_rw rw, unsigned char order) const;
 
 protected:
   union
@@ -97,5 +177,9 @@ protected:
     Page _page;
   };
 
+  unsigned char _fault_around_shift;
+  /// Try to back naturally aligned superpage-sized chunks with superpages.
+  bool _superpages;
+
 };
 };
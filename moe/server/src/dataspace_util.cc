@@ -76,24 +76,29 @@ __do_cow_copy2(Dataspace_noncont *dst, unsigned long &dst_offs, unsigned dst_pg_
   //L4::cout << "real COW\n";
   while (sz)
     {
-      Dataspace_noncont::Page &src_p = src->page(src_offs);
       Dataspace_noncont::Page *dst_p;
-      if (src_p.valid())
+      if (src->page(src_offs).valid())
         dst_p = &dst->alloc_page(dst_offs);
       else
-        dst_p = &dst->page(dst_offs);
+        dst_p = &dst->own_page(dst_offs);
+
+      // look up the source only now, as getting the destination page may
+      // have copied a page table shared with the source
+      Dataspace_noncont::Page *src_p = &src->page(src_offs);
+      if (src_p->valid() && !(src_p->flags() & Dataspace_noncont::Page_cow))
+        src_p = &src->own_page(src_offs);
 
       dst->free_page(*dst_p);
-      if (*src_p)
+      if (**src_p)
         {
-          Moe::Pages::share(*src_p);
-          if (!(src_p.flags() & Dataspace_noncont::Page_cow))
+          Moe::Pages::share(**src_p);
+          if (!(src_p->flags() & Dataspace_noncont::Page_cow))
             {
-              src->unmap_page(src_p, true);
-              src_p.set(*src_p, src_p.flags() | Dataspace_noncont::Page_cow);
+              src->unmap_page(*src_p, true);
+              src_p->set(**src_p, src_p->flags() | Dataspace_noncont::Page_cow);
             }
 
-          dst_p->set(*src_p, src_p.flags() | Dataspace_noncont::Page_cow);
+          dst_p->set(**src_p, src_p->flags() | Dataspace_noncont::Page_cow);
         }
 
       src_offs += dst_pg_sz;
@@ -237,6 +242,45 @@ __do_lazy_copy2(Dataspace_noncont *dst, unsigned long dst_offs,
   return true;
 }
 
+/**
+ * Copy by sharing whole page tables of the source where possible.
+ *
+ * The unaligned head and tail of the range are copied page-wise.
+ */
+bool
+__do_table_copy(Dataspace_noncont *dst, unsigned long dst_offs,
+    Dataspace_noncont const *src, unsigned long src_offs, unsigned long &size)
+{
+  unsigned long ts = dst->table_size();
+  if (!ts || ts != src->table_size() || ((dst_offs ^ src_offs) & (ts - 1)))
+    return false;
+
+  unsigned long head = min(size, (ts - (dst_offs & (ts - 1))) & (ts - 1));
+  if (head)
+    {
+      unsigned long sz = head;
+      if (!__do_lazy_copy2(dst, dst_offs, src, src_offs, sz))
+        return false;
+
+      if (sz < head)
+        {
+          size = sz;
+          return true;
+        }
+    }
+
+  unsigned long shared = dst->share_tables(dst_offs + head, src,
+                                           src_offs + head, size - head);
+
+  unsigned long tail = size - head - shared;
+  if (!__do_lazy_copy2(dst, dst_offs + head + shared,
+                       src, src_offs + head + shared, tail))
+    return false;
+
+  size = head + shared + tail;
+  return true;
+}
+
 }; // and local anon namespace
 
 unsigned long 
@@ -255,8 +299,9 @@ Dataspace_util::copy(Dataspace *dst, unsigned long dst_offs,
         {
           Dataspace_noncont *dst_n = dynamic_cast<Dataspace_noncont*>(dst);
           Dataspace_noncont const *src_n = dynamic_cast<Dataspace_noncont const *>(src);
-          if (dst_n && src_n 
-              && __do_lazy_copy2(dst_n, dst_offs, src_n, src_offs, size))
+          if (dst_n && src_n
+              && (__do_table_copy(dst_n, dst_offs, src_n, src_offs, size)
+                  || __do_lazy_copy2(dst_n, dst_offs, src_n, src_offs, size)))
             return size;
         }
     }
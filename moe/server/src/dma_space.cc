@@ -31,7 +31,10 @@ public:
                l4_size_t *size, Attributes attrs, Direction dir,
                Dma_addr *dma_addr) override
   {
-    L4Re::chksys(ds->dma_map(0, offset, size, attrs, dir, dma_addr));
+    {
+      Lock_guard<Spin_lock> g(ds->lock());
+      L4Re::chksys(ds->dma_map(0, offset, size, attrs, dir, dma_addr));
+    }
 
     cxx::unique_ptr<Dma::Mapping> m(alloc->make_obj<Dma::Mapping>());
 
@@ -321,7 +324,7 @@ Dma_space::op_associate(L4Re::Dma_space::Rights,
     }
   else
     {
-      L4::Cap<L4::Task> rcv_cap(Rcv_cap << L4_CAP_SHIFT);
+      L4::Cap<L4::Task> rcv_cap = L4::cap_cast<L4::Task>(::rcv_cap());
       if (!dma_task.cap_received())
         return -L4_EINVAL;
 
@@ -117,6 +117,9 @@ public:
 
   long op_disassociate(L4Re::Dma_space::Rights rights);
 
+  // the DMA task mappers are shared by all DMA spaces
+  bool exclusive_dispatch() const override { return true; }
+
   void delete_all_mappings();
 
   ~Dma_space() { delete_all_mappings(); }
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/*
+ * Per-thread state of the C++ exception handling runtime.
+ *
+ * Moe has no TLS, the implementation of libsupc++ therefore keeps a single
+ * instance for the whole task. Replace it with one instance per thread of
+ * Moe, the type is taken from the libsupc++ sources the runtime is built
+ * from.
+ */
+#include "threads.h"
+
+#include "unwind-cxx.h"
+
+namespace {
+
+__cxxabiv1::__cxa_eh_globals _eh_globals[Moe::Threads::Max_threads];
+
+}
+
+extern "C" __cxxabiv1::__cxa_eh_globals *
+__cxxabiv1::__cxa_get_globals_fast() _GLIBCXX_NOTHROW
+{ return &_eh_globals[Moe::Threads::self()]; }
+
+extern "C" __cxxabiv1::__cxa_eh_globals *
+__cxxabiv1::__cxa_get_globals() _GLIBCXX_NOTHROW
+{ return &_eh_globals[Moe::Threads::self()]; }
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/sys/ipc.h>
+#include <l4/sys/thread.h>
+
+namespace Moe {
+
+/**
+ * Wait a little before retrying to take a lock.
+ *
+ * The first rounds only give up the time slice. A yield does not help a
+ * lock holder with a lower priority than the waiter, hence later rounds
+ * block for about a millisecond so that such a holder gets to run and the
+ * waiter cannot keep it off the CPU indefinitely.
+ */
+inline void lock_backoff(unsigned *round)
+{
+  enum { Yield_rounds = 64 };
+  if (*round < Yield_rounds)
+    {
+      ++*round;
+      l4_thread_yield();
+    }
+  else
+    l4_ipc_sleep(l4_timeout(L4_IPC_TIMEOUT_NEVER, l4_timeout_rel(1, 10)));
+}
+
+/**
+ * Lock for data shared between Moe's threads.
+ *
+ * Moe has no blocking synchronization primitives, waiters spin and back
+ * off, see lock_backoff(). Critical sections must be short and must not
+ * block.
+ */
+class Spin_lock
+{
+public:
+  Spin_lock() : _l(0) {}
+
+  void lock()
+  {
+    unsigned round = 0;
+    while (__atomic_exchange_n(&_l, 1, __ATOMIC_ACQUIRE))
+      while (__atomic_load_n(&_l, __ATOMIC_RELAXED))
+        lock_backoff(&round);
+  }
+
+  void unlock()
+  { __atomic_store_n(&_l, 0, __ATOMIC_RELEASE); }
+
+private:
+  Spin_lock(Spin_lock const &) = delete;
+  Spin_lock &operator = (Spin_lock const &) = delete;
+
+  unsigned char _l;
+};
+
+/**
+ * Readers-writer variant of Spin_lock.
+ *
+ * Writers are preferred: while a writer waits, no new reader gets the
+ * lock, so a steady stream of readers (e.g. page faults) cannot starve
+ * rare writers such as the deletion of objects.
+ */
+class Rw_spin_lock
+{
+public:
+  Rw_spin_lock() : _v(0), _writers(0) {}
+
+  void lock_shared()
+  {
+    unsigned round = 0;
+    for (;;)
+      {
+        unsigned long v = __atomic_load_n(&_v, __ATOMIC_RELAXED);
+        if (!(v & Writer)
+            && !__atomic_load_n(&_writers, __ATOMIC_ACQUIRE)
+            && __atomic_compare_exchange_n(&_v, &v, v + 1, false,
+                                           __ATOMIC_ACQUIRE,
+                                           __ATOMIC_RELAXED))
+          return;
+
+        lock_backoff(&round);
+      }
+  }
+
+  void unlock_shared()
+  { __atomic_sub_fetch(&_v, 1, __ATOMIC_RELEASE); }
+
+  void lock()
+  {
+    unsigned round = 0;
+    __atomic_add_fetch(&_writers, 1, __ATOMIC_SEQ_CST);
+    for (;;)
+      {
+        unsigned long v = 0;
+        if (__atomic_compare_exchange_n(&_v, &v, Writer, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+          break;
+
+        lock_backoff(&round);
+      }
+    __atomic_sub_fetch(&_writers, 1, __ATOMIC_RELAXED);
+  }
+
+  void unlock()
+  { __atomic_store_n(&_v, 0, __ATOMIC_RELEASE); }
+
+private:
+  enum : unsigned long { Writer = 1UL << (sizeof(unsigned long) * 8 - 1) };
+
+  Rw_spin_lock(Rw_spin_lock const &) = delete;
+  Rw_spin_lock &operator = (Rw_spin_lock const &) = delete;
+
+  unsigned long _v;
+  /// Number of threads waiting in lock().
+  unsigned _writers;
+};
+
+/**
+ * Scoped lock for Spin_lock and the exclusive side of Rw_spin_lock.
+ */
+template<typename LOCK>
+class Lock_guard
+{
+public:
+  explicit Lock_guard(LOCK &l) : _l(&l) { _l->lock(); }
+  ~Lock_guard() { _l->unlock(); }
+
+private:
+  Lock_guard(Lock_guard const &) = delete;
+  Lock_guard &operator = (Lock_guard const &) = delete;
+
+  LOCK *_l;
+};
+
+/**
+ * Scoped lock for the shared side of Rw_spin_lock.
+ */
+class Shared_guard
+{
+public:
+  explicit Shared_guard(Rw_spin_lock &l) : _l(&l) { _l->lock_shared(); }
+  ~Shared_guard() { _l->unlock_shared(); }
+
+private:
+  Shared_guard(Shared_guard const &) = delete;
+  Shared_guard &operator = (Shared_guard const &) = delete;
+
+  Rw_spin_lock *_l;
+};
+
+}
@@ -13,6 +13,7 @@
 #include <l4/cxx/minmax>
 
 #include "globals.h"
+#include "lock.h"
 #include "log.h"
 
 #include <unistd.h>
@@ -21,6 +22,10 @@
 
 static Moe::Log *last_log = 0;
 
+// protects last_log, the message buffer and the output buffer, which are
+// shared by all log objects
+static Moe::Spin_lock log_lock;
+
 class Pbuf
 {
 public:
@@ -104,6 +109,8 @@ Moe::Log::op_dispatch(l4_utcb_t *utcb, l4_msgtag_t tag, L4::Vcon::Rights)
   if (op != L4Re::Log_::Print)
     return l4_msgtag(-L4_ENOSYS, 0, 0, 0);
 
+  Moe::Lock_guard<Moe::Spin_lock> g(log_lock);
+
   char *msg = log_buffer;
   unsigned long len_msg = sizeof(log_buffer);
 
@@ -40,7 +40,9 @@
 #include "name_space.h"
 #include "page_alloc.h"
 #include "pages.h"
+#include "threads.h"
 #include "vesa_fb.h"
+#include "zero_pool.h"
 #include "dataspace_static.h"
 #include "debug.h"
 #include "args.h"
@@ -117,33 +119,47 @@ char *my_cmdline()
 
 
 
+static __attribute__((aligned(L4_PAGESIZE))) char emergency_mem[3 * L4_PAGESIZE];
+
+static void add_free_memory(l4_addr_t addr, unsigned order,
+                            l4_addr_t *min_addr, l4_addr_t *max_addr)
+{
+  unsigned long size = 1UL << order;
+
+  if (addr == 0)
+    {
+      addr = L4_PAGESIZE;
+      size -= L4_PAGESIZE;
+      if (!size)
+        return;
+    }
+
+  if (addr < *min_addr) *min_addr = addr;
+  if (addr + size > *max_addr) *max_addr = addr + size;
+
+  Moe::Pages::add_ram(addr, addr + size);
+  Single_page_alloc_base::_free((void*)addr, size, true);
+}
+
 static void find_memory()
 {
-  using Moe::Pages::pages;
-  l4_addr_t addr;
+  enum { Batch = L4_UTCB_GENERIC_DATA_SIZE / 2 };
+  l4_addr_t addr[Batch];
   l4_addr_t min_addr = ~0UL;
   l4_addr_t max_addr = 0;
 
   for (unsigned order = 30 /*1G*/; order >= L4_LOG2_PAGESIZE; --order)
     {
-      while (!l4sigma0_map_anypage(Sigma0_cap, 0, L4_WHOLE_ADDRESS_SPACE,
-                                   &addr, order))
-        {
-          unsigned long size = 1UL << order;
-
-          if (addr == 0)
-            {
-              addr = L4_PAGESIZE;
-              size -= L4_PAGESIZE;
-              if (!size)
-                continue;
-            }
-
-          if (addr < min_addr) min_addr = addr;
-          if (addr + size > max_addr) max_addr = addr + size;
+      int n;
+      while ((n = l4sigma0_map_anypages(Sigma0_cap, 0, L4_WHOLE_ADDRESS_SPACE,
+                                        addr, Batch, order)) > 0)
+        for (int i = 0; i < n; ++i)
+          add_free_memory(addr[i], order, &min_addr, &max_addr);
 
-          Single_page_alloc_base::_free((void*)addr, size, true);
-        }
+      // sigma0 implementations without support for batch requests
+      while (!l4sigma0_map_anypage(Sigma0_cap, 0, L4_WHOLE_ADDRESS_SPACE,
+                                   &addr[0], order))
+        add_free_memory(addr[0], order, &min_addr, &max_addr);
     }
 
   info.printf("found %ld KByte free memory\n",
@@ -176,28 +192,24 @@ static void find_memory()
         }
     }
 
-  assert(max_addr > min_addr);
-  l4_addr_t total_pages = (max_addr - min_addr) >> L4_PAGESHIFT;
-
-  assert(total_pages);
-
-  pages = (__typeof(pages))Single_page_alloc_base::_alloc(sizeof(*pages) * total_pages);
+  // the emergency memory is handed out by the page allocator as well
+  l4_addr_t em_start = (l4_addr_t)emergency_mem;
+  l4_addr_t em_end = em_start + sizeof(emergency_mem);
+  if (em_start < min_addr) min_addr = em_start;
+  if (em_end > max_addr) max_addr = em_end;
 
-  if (pages == 0)
-    {
-      Err(Err::Fatal).printf("could not allocate page array, halt\n");
-      exit(128);
-    }
-
-  memset(pages, 0, sizeof(*pages) * total_pages);
+  assert(max_addr > min_addr);
 
-  Moe::Pages::base_addr = min_addr;
-  Moe::Pages::max_addr  = max_addr;
+  // page descriptors are only needed for the RAM received from sigma0,
+  // skip the holes in between, boot modules are added by the boot FS
+  Moe::Pages::add_ram(em_start, em_end);
+  Moe::Pages::init(min_addr, max_addr);
+  unsigned long desc_size = Moe::Pages::alloc_chunks();
 
   info.printf("found RAM from %lx to %lx\n",
               min_addr, max_addr);
-  info.printf("allocated %ld KByte for the page array @%p\n",
-              sizeof(*pages) * total_pages / 1024, pages);
+  info.printf("allocated %ld KByte for the page descriptors\n",
+              desc_size / 1024);
 }
 
 l4_addr_t Moe::Virt_limit::start;
@@ -227,6 +239,8 @@ init_utcb()
   boot.printf("UTCB @%p\n", u);
   if (!u)
     abort();
+
+  Moe::Threads::init();
 }
 
 static void
@@ -252,19 +266,41 @@ class Loop_hooks :
 public:
   static void setup_wait(l4_utcb_t *utcb, L4::Ipc_svr::Reply_mode)
   {
-    l4_utcb_br_u(utcb)->br[0] = L4::Ipc::Small_buf(Rcv_cap << L4_CAP_SHIFT,
+    l4_utcb_br_u(utcb)->br[0] = L4::Ipc::Small_buf(rcv_cap().cap(),
                                                    L4_RCV_ITEM_LOCAL_ID).raw();
     l4_utcb_br_u(utcb)->br[1] = 0;
     l4_utcb_br_u(utcb)->bdr = 0;
   }
 };
 
+// serializes requests to objects that are not safe for concurrent use
+static Moe::Spin_lock exclusive_lock;
+
 template< typename Reg >
 class My_dispatcher
 {
 private:
   Reg r;
 
+  static l4_msgtag_t
+  dispatch_locked(typename Reg::Value *o, l4_msgtag_t tag, l4_umword_t obj,
+                  l4_utcb_t *utcb)
+  {
+    // the deletion IRQ of the object pool takes the object lock itself
+    if (object_pool.is_del_irq_handler(o))
+      return o->dispatch(tag, obj, utcb);
+
+    Moe::Shared_guard g(object_pool.obj_lock);
+    auto *so = dynamic_cast<Moe::Server_object *>(o);
+    if (so && so->exclusive_dispatch())
+      {
+        Moe::Lock_guard<Moe::Spin_lock> x(exclusive_lock);
+        return o->dispatch(tag, obj, utcb);
+      }
+
+    return o->dispatch(tag, obj, utcb);
+  }
+
 public:
   l4_msgtag_t dispatch(l4_msgtag_t tag, l4_umword_t obj, l4_utcb_t *utcb)
   {
@@ -306,7 +342,7 @@ public:
         dbg.cprintf(": object is a %s\n", typeid(*o).name());
         try
           {
-            l4_msgtag_t res = o->dispatch(tag, obj, utcb);
+            l4_msgtag_t res = dispatch_locked(o, tag, obj, utcb);
             dbg.printf("reply = %ld\n", res.label());
             return res;
           }
@@ -355,6 +391,7 @@ static Dbg_bits const ldr_flag_bits[] =
    {"eager_map",    L4RE_AUX_LDR_FLAG_EAGER_MAP},
    {"all_segs_cow", L4RE_AUX_LDR_FLAG_ALL_SEGS_COW},
    {"pinned_segs",  L4RE_AUX_LDR_FLAG_PINNED_SEGS},
+   {"prefault",     L4RE_AUX_LDR_FLAG_PREFAULT},
    {"exit",  0x10},
    {0, 0}};
 
@@ -417,11 +454,60 @@ static void hdl_ldr_flags(cxx::String const &args)
 
 
 
+static void hdl_fault_around(cxx::String const &args)
+{
+  unsigned long shift;
+  if (args.from_dec(&shift) != args.len()
+      || !Allocator::valid_fault_around_shift(shift))
+    {
+      warn.printf("ignore invalid argument for --fault-around: '%.*s'\n",
+                  args.len(), args.start());
+      return;
+    }
+
+  Allocator::root_allocator()->fault_around_shift(shift);
+}
+
+static unsigned _server_threads;
+
+static void hdl_server_threads(cxx::String const &args)
+{
+  unsigned long num;
+  if (args == "cpus")
+    num = ~0UL;
+  else if (args.from_dec(&num) != args.len()
+           || num >= Moe::Threads::Max_threads)
+    {
+      warn.printf("ignore invalid argument for --server-threads: '%.*s'\n",
+                  args.len(), args.start());
+      return;
+    }
+
+  _server_threads = num;
+}
+
+static void hdl_zero_pool(cxx::String const &args)
+{
+  unsigned long pages;
+  if (args.from_dec(&pages) != args.len()
+      || pages > Moe::Zero_pool::Max_depth)
+    {
+      warn.printf("ignore invalid argument for --zero-pool: '%.*s'\n",
+                  args.len(), args.start());
+      return;
+    }
+
+  Moe::Zero_pool::depth(pages);
+}
+
 static Get_opt const _options[] = {
       {"--debug=",     hdl_debug },
       {"--init=",      hdl_init },
       {"--l4re-dbg=",  hdl_l4re_dbg },
       {"--ldr-flags=", hdl_ldr_flags },
+      {"--fault-around=", hdl_fault_around },
+      {"--zero-pool=", hdl_zero_pool },
+      {"--server-threads=", hdl_server_threads },
       {0, 0}
 };
 
@@ -471,6 +557,73 @@ static Elf_loader elf_loader;
 
 static L4::Server<Loop_hooks> server(l4_utcb());
 
+static void
+server_thread()
+{
+  L4::Server<Loop_hooks> s(l4_utcb());
+  s.loop_noexc(My_dispatcher<L4::Basic_registry>());
+}
+
+/**
+ * Start the additional server threads requested with --server-threads.
+ *
+ * The threads are distributed over the online CPUs, starting with the CPU
+ * after the boot CPU. A count of ~0U starts one thread for each online CPU
+ * besides the boot CPU.
+ */
+static void
+start_server_threads()
+{
+  enum { Server_prio = 0xf0 };
+
+  if (!_server_threads)
+    return;
+
+  L4::Cap<L4::Scheduler> sched = L4Re::Env::env()->scheduler();
+  l4_umword_t cpu_max;
+  l4_sched_cpu_set_t cpus = l4_sched_cpu_set(0, 0);
+  if (l4_error(sched->info(&cpu_max, &cpus)) < 0)
+    cpu_max = 1;
+
+  unsigned online = 0;
+  for (l4_umword_t c = 0; c < cpu_max; ++c)
+    if (sched->is_online(c))
+      ++online;
+
+  unsigned num = _server_threads;
+  if (num == ~0U)
+    num = online > 1 ? online - 1 : 0;
+
+  l4_umword_t cpu = 0;
+  for (unsigned i = 0; i < num; ++i)
+    {
+      if (online > 1)
+        do
+          cpu = (cpu + 1) % cpu_max;
+        while (!sched->is_online(cpu));
+
+      l4_sched_param_t sp = l4_sched_param(Server_prio);
+      sp.affinity = l4_sched_cpu_set(cpu, 0);
+
+      long idx = Moe::Threads::start("moe-svr", &server_thread, sp);
+      long err = idx;
+      if (idx >= 0)
+        err = object_pool.add_server_thread(Moe::Threads::cap(idx));
+
+      if (err < 0)
+        {
+          warn.printf("could not start server thread: %ld\n", err);
+          if (Moe::Threads::max_threads() < Moe::Threads::Max_threads)
+            warn.printf("the UTCB area holds %u threads\n",
+                        Moe::Threads::max_threads());
+          return;
+        }
+
+      Moe::Threads::add_server(idx);
+      info.printf("server thread %ld on CPU %lu\n", idx, cpu);
+    }
+}
+
 
 static void init_env()
 {
@@ -490,8 +643,7 @@ static void init_emergency_memory()
   // populate the page allocator with a few pages of static memory to allow for
   // dynamic allocation of memory arena during static initialization of stdc++'s
   // emergency_pool in GCC versions 5 and newer
-  static __attribute__((aligned(L4_PAGESIZE))) char buf[3 * L4_PAGESIZE];
-  Single_page_alloc_base::_free(buf, sizeof(buf), true);
+  Single_page_alloc_base::_free(emergency_mem, sizeof(emergency_mem), true);
 }
 
 static __attribute__((used, section(".preinit_array")))
@@ -597,6 +749,9 @@ int main(int argc, char**argv)
           root_name_space()->dump(1);
         }
 
+      Moe::Zero_pool::start();
+      start_server_threads();
+
       // we handle our exceptions ourselves
       server.loop_noexc(My_dispatcher<L4::Basic_registry>());
     }
@@ -9,7 +9,6 @@
 #include <cstdio>
 #include <cassert>
 
-#include <l4/cxx/slist>
 #include <l4/cxx/minmax>
 
 #include "debug.h"
@@ -25,7 +24,7 @@ namespace Moe {
  *
  * Simple one-size-fits-all bin based implementation.
  */
-class Malloc_page : public cxx::S_list_item
+class Malloc_page : public cxx::D_list_item
 {
 public:
   enum
@@ -56,7 +55,9 @@ public:
 
   void *alloc(size_t shift) throw()
   {
-    if (shift != _bin_shift || _used >= _num_bins)
+    assert(shift == _bin_shift);
+    (void)shift;
+    if (_used >= _num_bins)
       return 0;
 
     void *freeptr = ptr_of(_first_free);
@@ -81,6 +82,12 @@ public:
   bool unused() const
   { return _used == 0; }
 
+  bool full() const
+  { return _used >= _num_bins; }
+
+  unsigned shift() const
+  { return _bin_shift; }
+
   static Malloc_page *from_ptr(void const *p) throw()
   {
     l4_addr_t caddr = l4_trunc_size(l4_addr_t(p), Malloc_page::Page_shift);
@@ -109,6 +116,13 @@ private:
 
 }
 
+Moe::Malloc_container::Malloc_container() throw()
+: _num_cached(0), _page_allocs(0), _cache_hits(0)
+{
+  for (auto &sc : _classes)
+    sc.pages = sc.chunks = 0;
+}
+
 void *
 Moe::Malloc_container::alloc(size_t size, size_t align) throw()
 {
@@ -116,37 +130,45 @@ Moe::Malloc_container::alloc(size_t size, size_t align) throw()
     printf("Malloc[%p]: alloc(%zu, %zu)\n", this, size, align);
   // make sure alignment will be ok
   size = cxx::max(size, align);
+  if (size > (1UL << Max_shift))
+    return 0;
+
   // now find the next possible n^2 alignment
-  size_t outsz = 4;
+  size_t outsz = Min_shift;
   while ((1UL << outsz) < size)
+    ++outsz;
+
+  Size_class &sc = _classes[outsz - Min_shift];
+
+  Lock_guard<Spin_lock> g(_lock);
+  Malloc_page *pg;
+  if (!sc.partial.empty())
+    pg = *sc.partial.begin();
+  else
     {
-      ++outsz;
-      if (outsz > 10)
+      // nothing? try to get a new page
+      void *np = get_page();
+      if (!np)
         return 0;
-    }
 
-  for (auto const pg : _pages)
-    {
-      void *p = pg->alloc(outsz);
-      if (p)
-        return p;
+      if (0)
+        printf("Malloc[%p]: create new backing page @ %p (sz=%zu)\n",
+               this, np, outsz);
+      pg = new (np) Malloc_page(this, outsz);
+      sc.partial.push_front(pg);
+      ++sc.pages;
     }
 
-  // nothing? try to allocate a new page
-  void *np = get_mem();
+  void *p = pg->alloc(outsz);
+  ++sc.chunks;
 
-  if (np)
+  if (pg->full())
     {
-      if (0)
-        printf("Malloc[%p]: create new backing page @ %p (sz=%zu)\n",
-               this, np, outsz);
-      Malloc_page *pg = new (np) Malloc_page(this, outsz);
-      _pages.add(pg);
-      void *p = pg->alloc(outsz);
-      return p;
+      Page_list::remove(pg);
+      sc.full.push_front(pg);
     }
 
-  return 0;
+  return p;
 }
 
 void
@@ -163,22 +185,81 @@ Moe::Malloc_container::free(void *block) throw()
       return;
     }
 
+  Lock_guard<Spin_lock> g(_lock);
+  Size_class &sc = _classes[pg->shift() - Min_shift];
+  bool was_full = pg->full();
+
   pg->free(block);
+  --sc.chunks;
 
   if (pg->unused())
     {
-      for (auto it = _pages.begin(); it != _pages.end(); ++it)
-        {
-          if (*it == pg)
-            {
-              _pages.erase(it);
-              free_mem(pg);
-              return;
-            }
-        }
+      Page_list::remove(pg);
+      --sc.pages;
+      put_page(pg);
+    }
+  else if (was_full)
+    {
+      // recently freed chunks are the first to be reused
+      Page_list::remove(pg);
+      sc.partial.push_front(pg);
     }
 }
 
+void *
+Moe::Malloc_container::get_page() throw()
+{
+  if (!_cached.empty())
+    {
+      Malloc_page *pg = *_cached.begin();
+      Page_list::remove(pg);
+      --_num_cached;
+      ++_cache_hits;
+      return pg;
+    }
+
+  ++_page_allocs;
+  return get_mem();
+}
+
+void
+Moe::Malloc_container::put_page(Malloc_page *pg) throw()
+{
+  if (_num_cached < Max_cached_pages)
+    {
+      _cached.push_front(pg);
+      ++_num_cached;
+    }
+  else
+    free_mem(pg);
+}
+
+void
+Moe::Malloc_container::flush_cache() throw()
+{
+  Lock_guard<Spin_lock> g(_lock);
+  while (!_cached.empty())
+    {
+      Malloc_page *pg = *_cached.begin();
+      Page_list::remove(pg);
+      free_mem(pg);
+    }
+  _num_cached = 0;
+}
+
+void
+Moe::Malloc_container::dump_stats(Dbg &out)
+{
+  Lock_guard<Spin_lock> g(_lock);
+  out.printf("malloc: page allocations: %lu, cache hits: %lu, cached: %u\n",
+             _page_allocs, _cache_hits, _num_cached);
+  for (unsigned i = 0; i < Num_classes; ++i)
+    if (_classes[i].pages)
+      out.printf("  %4lu bytes: %lu pages, %lu chunks used\n",
+                 1UL << (i + Min_shift), _classes[i].pages,
+                 _classes[i].chunks);
+}
+
 void *
 Moe::Malloc_container::get_mem()
 {
@@ -196,11 +277,29 @@ Moe::Malloc_container::free_mem(void *page)
 void
 Moe::Malloc_container::reparent(Malloc_container *new_container)
 {
-  while (!_pages.empty())
+  flush_cache();
+
+  // containers are only reparented towards the root, so locking the
+  // child before the parent cannot deadlock
+  Lock_guard<Spin_lock> g(_lock);
+  Lock_guard<Spin_lock> ng(new_container->_lock);
+  for (unsigned i = 0; i < Num_classes; ++i)
     {
-      auto *front = _pages.pop_front();
-      front->reparent(new_container);
-      new_container->_pages.add(front);
+      Size_class &sc = _classes[i];
+      Size_class &nsc = new_container->_classes[i];
+      Page_list *lists[] = { &sc.partial, &sc.full };
+      for (Page_list *l : lists)
+        while (!l->empty())
+          {
+            Malloc_page *pg = *l->begin();
+            Page_list::remove(pg);
+            pg->reparent(new_container);
+            (pg->full() ? nsc.full : nsc.partial).push_front(pg);
+          }
+
+      nsc.pages += sc.pages;
+      nsc.chunks += sc.chunks;
+      sc.pages = sc.chunks = 0;
     }
 }
 
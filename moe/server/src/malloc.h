@@ -10,21 +10,39 @@
 #include <l4/sys/consts.h>
 #include <l4/cxx/exceptions>
 #include <l4/cxx/type_traits>
-#include <l4/cxx/slist>
+#include <l4/cxx/dlist>
 
 #include <new>
 #include <cstddef>
 
+#include "lock.h"
+
+class Dbg;
+
 namespace Moe {
 
 class Malloc_page;
 
 /**
  * A basic allocator for any size of chunks.
+ *
+ * Chunks are rounded up to a power of two and served from pages that are
+ * dedicated to one chunk size. Each size class keeps separate lists of
+ * partially used and of full pages, so that allocation and free never
+ * search. A few empty pages are cached to avoid going back to the page
+ * allocator for every short-lived object.
  */
 class Malloc_container
 {
 public:
+  enum
+  {
+    Min_shift = 4,              ///< log2 of the smallest chunk size
+    Max_shift = 10,             ///< log2 of the largest chunk size
+    Num_classes = Max_shift - Min_shift + 1,
+    Max_cached_pages = 2,       ///< Empty pages kept for reuse
+  };
+
   class Guarded_alloc
   {
   public:
@@ -58,10 +76,22 @@ public:
     Malloc_container* _c;
   };
 
+  Malloc_container() throw();
+
   void *alloc(size_t size, size_t align) throw();
   void free(void *block) throw();
   virtual void reparent(Malloc_container *new_container);
 
+  /**
+   * Return all cached empty pages to the backing memory.
+   */
+  void flush_cache() throw();
+
+  /**
+   * Print page and chunk usage per size class.
+   */
+  void dump_stats(Dbg &out);
+
   template <typename T, typename ...ARGS>
   T *make_obj(ARGS &&... args)
   {
@@ -89,7 +119,25 @@ protected:
   virtual void free_mem(void *page);
 
 private:
-  cxx::S_list<Malloc_page> _pages;
+  typedef cxx::D_list<Malloc_page> Page_list;
+
+  struct Size_class
+  {
+    Page_list partial;          ///< Pages with at least one free chunk
+    Page_list full;             ///< Pages without free chunks
+    unsigned long pages;
+    unsigned long chunks;       ///< Allocated chunks
+  };
+
+  void *get_page() throw();
+  void put_page(Malloc_page *pg) throw();
+
+  Size_class _classes[Num_classes];
+  Page_list _cached;
+  unsigned _num_cached;
+  unsigned long _page_allocs;
+  unsigned long _cache_hits;
+  Spin_lock _lock;
 };
 
 } // namespace
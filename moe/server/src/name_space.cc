@@ -179,7 +179,7 @@ Name_space::op_register_obj(L4Re::Namespace::Rights, unsigned flags,
   if (cap.id_received())
     n->set_epiface(cap.data());
   else if (cap.cap_received())
-    n->set_cap_copy(L4::Cap<L4::Kobject>(Rcv_cap << L4_CAP_SHIFT));
+    n->set_cap_copy(L4::cap_cast<L4::Kobject>(rcv_cap()));
   else if (cap.is_valid())
     // received a valid cap we cannot handle
     return -L4_EINVAL;
@@ -22,7 +22,9 @@
 #include <l4/cxx/hlist>
 
 #include "early.h"
+#include "lock.h"
 #include "server_obj.h"
+#include "threads.h"
 
 #include <cstring>
 #include <cassert>
@@ -32,9 +34,14 @@
 
 enum
 {
+  /// First receive capability slot, each server thread has its own.
   Rcv_cap = 0x100,
 };
 
+/// Receive capability slot of the calling server thread.
+inline L4::Cap<void> rcv_cap()
+{ return L4::Cap<void>((Rcv_cap + Moe::Threads::self()) << L4_CAP_SHIFT); }
+
 class Cap_alloc;
 
 class Object_pool
@@ -47,7 +54,31 @@ class Object_pool
 public:
   explicit Object_pool(Cap_alloc *ca);
   Cap_alloc *cap_alloc() const { return _cap_alloc; }
+
+  /**
+   * Register the deletion IRQ for gates bound to an additional server
+   * thread.
+   */
+  long add_server_thread(L4::Cap<L4::Thread> thread);
+
+  /// Whether `o` is the handler of the deletion IRQs of the pool.
+  bool is_del_irq_handler(L4::Epiface const *o) const
+  { return o == static_cast<L4::Epiface const *>(this); }
+
   cxx::H_list_t<Moe::Server_object> life;
+
+  /// Protects #life and the weak references of all server objects.
+  Moe::Spin_lock life_lock;
+
+  /**
+   * Serializes the deletion of server objects against their use.
+   *
+   * Server threads hold the lock shared while they dispatch a request to a
+   * server object, the deletion of unreferenced objects holds it
+   * exclusively.
+   */
+  Moe::Rw_spin_lock obj_lock;
+
   int alloc_buffer_demand(L4::Type_info::Demand const &demand) override
   {
     if (demand.caps > 1
@@ -62,7 +93,7 @@ public:
   L4::Cap<void> get_rcv_cap(int index) const override
   {
     if (index == 0)
-      return L4::Cap<void>(Rcv_cap << L4_CAP_SHIFT);
+      return ::rcv_cap();
     else
       return L4::Cap<void>::Invalid;
   }
@@ -81,6 +112,7 @@ private:
 
   void handle_irq()
   {
+    Moe::Lock_guard<Moe::Rw_spin_lock> g(obj_lock);
     l4_utcb_t *utcb = l4_utcb();
     for (auto i = life.begin(); i != life.end();)
       {
@@ -98,13 +130,14 @@ public:
   enum
   {
     Non_gc_caps = 8192,
-    Non_gc_cap_0 = Rcv_cap + 1,
+    Non_gc_cap_0 = Rcv_cap + Moe::Threads::Max_threads,
   };
 
 private:
   // caps mainly used for things from outside (registered in name spaces)
   // this are usually not a lot
   L4Re::Util::Cap_alloc<Non_gc_caps> _non_gc;
+  Moe::Spin_lock _lock;
 
 public:
   Cap_alloc() : _non_gc(Non_gc_cap_0)
@@ -112,6 +145,7 @@ public:
 
   L4::Cap<L4::Kobject> alloc()
   {
+     Moe::Lock_guard<Moe::Spin_lock> g(_lock);
      L4::Cap<L4::Kobject> cap = _non_gc.alloc<L4::Kobject>();
 #if DEBUG_CAP_ALLOC
      L4::cerr << "AC->" << L4::n_hex(cap.cap()) << "\n";
@@ -127,7 +161,7 @@ public:
     extern Object_pool object_pool;
     // make sure we register an Epiface ptr
     L4::Epiface *o = _o;
-    L4::Cap<L4::Kobject> cap = _non_gc.alloc<L4::Kobject>();
+    L4::Cap<L4::Kobject> cap = alloc();
 #if  DEBUG_CAP_ALLOC
     L4::cerr << "ACO->" << L4::n_hex(cap.cap()) << "\n";
 #endif
@@ -136,7 +170,7 @@ public:
 
     l4_umword_t id = l4_umword_t(o);
     l4_factory_create_gate(L4_BASE_FACTORY_CAP, cap.cap(),
-                           L4_BASE_THREAD_CAP, id);
+                           _o->server_thread().cap(), id);
 
     _o->set_server(&object_pool, cap, true);
     return cap;
@@ -148,7 +182,10 @@ public:
       return false;
 
     if ((cap.cap() >> L4_CAP_SHIFT) >= Non_gc_cap_0)
-      _non_gc.free(cap, L4_BASE_TASK_CAP, unmap_flags);
+      {
+        Moe::Lock_guard<Moe::Spin_lock> g(_lock);
+        _non_gc.free(cap, L4_BASE_TASK_CAP, unmap_flags);
+      }
     else
       return false;
 
@@ -172,3 +209,23 @@ inline Object_pool::Object_pool(Cap_alloc *ca) : _cap_alloc(ca)
   early_chksys(L4::Cap<L4::Thread>(L4_BASE_THREAD_CAP)->register_del_irq(c),
                "Moe::Object_pool: Failed to register deletion IRQ\n");
 }
+
+inline long
+Object_pool::add_server_thread(L4::Cap<L4::Thread> thread)
+{
+  L4::Epiface *self = this;
+  auto c = cap_alloc()->alloc<L4::Irq>();
+  if (!c.is_valid())
+    return -L4_ENOMEM;
+
+  long err;
+  if ((err = l4_error(L4Re::Env::env()->factory()->create(c)))
+      || (err = l4_error(c->bind_thread(thread, l4_umword_t(self))))
+      || (err = l4_error(thread->register_del_irq(c))))
+    {
+      cap_alloc()->free(c);
+      return err;
+    }
+
+  return 0;
+}
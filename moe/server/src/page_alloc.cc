@@ -9,11 +9,13 @@
 #include <l4/util/util.h>
 
 #include <l4/cxx/iostream>
-#include <l4/cxx/list_alloc>
+#include <l4/cxx/buddy_alloc>
 #include <l4/cxx/exceptions>
 #include <l4/sys/kdebug.h>
 #include "page_alloc.h"
 #include "debug.h"
+#include "lock.h"
+#include "zero_pool.h"
 
 #if 1
 enum { page_alloc_debug = 0 };
@@ -21,7 +23,16 @@ enum { page_alloc_debug = 0 };
 unsigned page_alloc_debug = 0;
 #endif
 
-class LA : public cxx::List_alloc
+/**
+ * The physical page allocator.
+ *
+ * Free memory is managed in naturally aligned blocks from a single page up to
+ * half of the address space, so that allocating and freeing pages as well as
+ * superpage-sized and -aligned requests are O(log n).
+ */
+typedef cxx::Buddy_alloc<L4_PAGESHIFT, sizeof(unsigned long) * 8 - 2> LA_base;
+
+class LA : public LA_base
 {
 #if 0
 public:
@@ -35,7 +46,7 @@ public:
   void *alloc(unsigned long size, unsigned long align)
   {
     L4::cout << "PA::alloc: " << L4::hex << size << '(' << align << ") -> \n";
-    void *p = cxx::List_alloc::alloc(size, align);
+    void *p = LA_base::alloc(size, align);
     L4::cout << p << "\n";
     return p;
   }
@@ -45,7 +56,7 @@ public:
   void free(void *p, unsigned long size)
   {
     L4::cout << "free: " << p << '(' << size << ") -> "; 
-    cxx::List_alloc::free(p, size);
+    LA_base::free(p, size);
     L4::cout << avail() << "\n";
   }
 #endif
@@ -57,17 +68,29 @@ static LA *page_alloc()
   return &pa;
 }
 
+// the page allocator is shared by all of Moe's threads
+static Moe::Spin_lock _lock;
+
 Single_page_alloc_base::Single_page_alloc_base()
 {}
 
 unsigned long Single_page_alloc_base::_avail()
 {
+  Moe::Lock_guard<Moe::Spin_lock> g(_lock);
   return page_alloc()->avail();
 }
 
 void *Single_page_alloc_base::_alloc(Nothrow)
 {
-  void *ret = page_alloc()->alloc(L4_PAGESIZE, L4_PAGESIZE);
+  void *ret;
+  // pages of the zero pool are given back before memory is considered
+  // exhausted
+  do
+    {
+      Moe::Lock_guard<Moe::Spin_lock> g(_lock);
+      ret = page_alloc()->alloc(L4_PAGESIZE, L4_PAGESIZE);
+    }
+  while (!ret && Moe::Zero_pool::drain());
 
   if (page_alloc_debug)
     L4::cout << "pa(" << __builtin_return_address(0) << "): alloc(PAGE) @" << ret << '\n';
@@ -76,6 +99,7 @@ void *Single_page_alloc_base::_alloc(Nothrow)
 
 void Single_page_alloc_base::_free(void *p)
 {
+  Moe::Lock_guard<Moe::Spin_lock> g(_lock);
   if (page_alloc_debug)
     L4::cout << "pa(" << __builtin_return_address(0) << "): free(PAGE) @" << p << '\n';
   page_alloc()->free(p, L4_PAGESIZE); 
@@ -86,7 +110,13 @@ void *Single_page_alloc_base::_alloc_max(unsigned long min,
                                          unsigned align,
                                          unsigned granularity)
 {
-  void *ret = page_alloc()->alloc_max(min, max, align, granularity);
+  void *ret;
+  do
+    {
+      Moe::Lock_guard<Moe::Spin_lock> g(_lock);
+      ret = page_alloc()->alloc_max(min, max, align, granularity);
+    }
+  while (!ret && Moe::Zero_pool::drain());
   if (page_alloc_debug)
     L4::cout << "pa(" << __builtin_return_address(0) << "): alloc(" << *max << ") @" << ret << '\n';
   return ret;
@@ -95,7 +125,13 @@ void *Single_page_alloc_base::_alloc_max(unsigned long min,
 void *Single_page_alloc_base::_alloc(Nothrow, unsigned long size,
                                      unsigned long align)
 {
-  void *ret = page_alloc()->alloc(size, align);
+  void *ret;
+  do
+    {
+      Moe::Lock_guard<Moe::Spin_lock> g(_lock);
+      ret = page_alloc()->alloc(size, align);
+    }
+  while (!ret && Moe::Zero_pool::drain());
   if (page_alloc_debug)
     L4::cout << "pa(" << __builtin_return_address(0) << "): alloc(" << size << ") @" << ret << '\n';
   return ret;
@@ -103,6 +139,7 @@ void *Single_page_alloc_base::_alloc(Nothrow, unsigned long size,
 
 void Single_page_alloc_base::_free(void *p, unsigned long size, bool initial_mem)
 {
+  Moe::Lock_guard<Moe::Spin_lock> g(_lock);
   if (page_alloc_debug)
     L4::cout << "pa(" << __builtin_return_address(0) << "): free(" << size << ") @" << p << '\n';
   page_alloc()->free(p, size, initial_mem);
@@ -111,6 +148,7 @@ void Single_page_alloc_base::_free(void *p, unsigned long size, bool initial_mem
 #ifndef NDEBUG
 void Single_page_alloc_base::_dump_free(Dbg &dbg)
 {
+  Moe::Lock_guard<Moe::Spin_lock> g(_lock);
   page_alloc()->dump_free_list(dbg);
 }
 #endif
@@ -7,8 +7,161 @@
  * Please see the COPYING-GPL-2 file for details.
  */
 #include "pages.h"
+#include "page_alloc.h"
+
+#include <cstring>
 
 l4_addr_t Moe::Pages::base_addr;
 l4_addr_t Moe::Pages::max_addr;
-l4_uint32_t *Moe::Pages::pages;
+Moe::Pages::Chunk **Moe::Pages::chunks;
+
+namespace {
+
+// marker for table entries of chunks that contain RAM but have no
+// descriptors yet
+Moe::Pages::Chunk *const Ram_chunk = (Moe::Pages::Chunk *)1;
+
+bool chunks_allocated;
+
+/**
+ * Chunk ranges of the RAM received before the table exists.
+ *
+ * RAM is mostly contiguous at chunk granularity, so a few entries suffice.
+ * If they run out, the two closest ranges are merged and the chunks in
+ * between get descriptors they do not need.
+ */
+struct Ram_range { l4_addr_t first, last; };
+enum { Max_ram_ranges = 64 };
+Ram_range ram_ranges[Max_ram_ranges];
+unsigned num_ram_ranges;
+
+void record_ram(l4_addr_t first, l4_addr_t last)
+{
+  unsigned i = 0;
+  while (i < num_ram_ranges && ram_ranges[i].last + 1 < first)
+    ++i;
+
+  if (i < num_ram_ranges && ram_ranges[i].first <= last + 1)
+    {
+      // overlapping or adjacent, this might close the gap to the next ones
+      if (first < ram_ranges[i].first)
+        ram_ranges[i].first = first;
+      if (last > ram_ranges[i].last)
+        ram_ranges[i].last = last;
+
+      while (i + 1 < num_ram_ranges
+             && ram_ranges[i + 1].first <= ram_ranges[i].last + 1)
+        {
+          if (ram_ranges[i + 1].last > ram_ranges[i].last)
+            ram_ranges[i].last = ram_ranges[i + 1].last;
+          for (unsigned j = i + 1; j + 1 < num_ram_ranges; ++j)
+            ram_ranges[j] = ram_ranges[j + 1];
+          --num_ram_ranges;
+        }
+      return;
+    }
+
+  if (num_ram_ranges == Max_ram_ranges)
+    {
+      unsigned m = 0;
+      for (unsigned j = 1; j + 1 < num_ram_ranges; ++j)
+        if (ram_ranges[j + 1].first - ram_ranges[j].last
+            < ram_ranges[m + 1].first - ram_ranges[m].last)
+          m = j;
+
+      ram_ranges[m].last = ram_ranges[m + 1].last;
+      for (unsigned j = m + 1; j + 1 < num_ram_ranges; ++j)
+        ram_ranges[j] = ram_ranges[j + 1];
+      --num_ram_ranges;
+      record_ram(first, last);
+      return;
+    }
+
+  for (unsigned j = num_ram_ranges; j > i; --j)
+    ram_ranges[j] = ram_ranges[j - 1];
+  ram_ranges[i].first = first;
+  ram_ranges[i].last = last;
+  ++num_ram_ranges;
+}
+
+unsigned long num_slots()
+{
+  using namespace Moe::Pages;
+  return ((max_addr - 1) >> Chunk_shift) - (base_addr >> Chunk_shift) + 1;
+}
+
+}
+
+void
+Moe::Pages::add_ram(l4_addr_t start, l4_addr_t end)
+{
+  if (start >= end)
+    return;
+
+  l4_addr_t first = start >> Chunk_shift;
+  l4_addr_t last = (end - 1) >> Chunk_shift;
+  if (!chunks_allocated)
+    {
+      record_ram(first, last);
+      return;
+    }
+
+  if (first < (base_addr >> Chunk_shift))
+    first = base_addr >> Chunk_shift;
+  if (last > ((max_addr - 1) >> Chunk_shift))
+    last = (max_addr - 1) >> Chunk_shift;
+
+  for (l4_addr_t i = first; i <= last; ++i)
+    {
+      Chunk *&c = chunks[i - (base_addr >> Chunk_shift)];
+      if (c)
+        continue;
+
+      Chunk *n = (Chunk *)Single_page_alloc_base::_alloc(sizeof(Chunk));
+      memset(n, 0, sizeof(Chunk));
+      c = n;
+    }
+}
+
+void
+Moe::Pages::init(l4_addr_t base, l4_addr_t end)
+{
+  base_addr = base;
+  max_addr  = end;
+
+  unsigned long sz = num_slots() * sizeof(Chunk *);
+  chunks = (Chunk **)Single_page_alloc_base::_alloc(sz);
+  memset(chunks, 0, sz);
+}
+
+unsigned long
+Moe::Pages::alloc_chunks()
+{
+  l4_addr_t lo = base_addr >> Chunk_shift;
+  l4_addr_t hi = (max_addr - 1) >> Chunk_shift;
+  for (unsigned r = 0; r < num_ram_ranges; ++r)
+    for (l4_addr_t i = ram_ranges[r].first; i <= ram_ranges[r].last; ++i)
+      if (i >= lo && i <= hi)
+        chunks[i - lo] = Ram_chunk;
+
+  chunks_allocated = true;
+
+  unsigned long slots = num_slots();
+  unsigned long n = 0;
+  for (unsigned long i = 0; i < slots; ++i)
+    if (chunks[i] == Ram_chunk)
+      ++n;
+
+  if (!n)
+    return 0;
+
+  unsigned long sz = n * sizeof(Chunk);
+  Chunk *c = (Chunk *)Single_page_alloc_base::_alloc(sz);
+  memset(c, 0, sz);
+
+  for (unsigned long i = 0; i < slots; ++i)
+    if (chunks[i] == Ram_chunk)
+      chunks[i] = c++;
 
+  return sz;
+}
@@ -14,25 +14,129 @@
 
 namespace Moe {
 namespace Pages {
+  enum
+  {
+    Chunk_shift = L4_SUPERPAGESHIFT,
+    Chunk_pages = 1UL << (Chunk_shift - L4_PAGESHIFT),
+  };
+
+  /**
+   * Page descriptors for one superpage-sized chunk of physical memory.
+   *
+   * The reference count of a page is the sum of the compound count of the
+   * chunk and the count of the page itself, modulo 2^32. A superpage that
+   * is handed out as a whole takes a single compound reference. Its pages
+   * are released one by one through their own counters, which then wrap
+   * below zero, so the compound count never has to be split.
+   *
+   * The compound count only changes while no page of the chunk is
+   * referenced, when a free superpage is handed out. Readers of pages they
+   * hold a reference to therefore always see the full count.
+   */
+  struct Chunk
+  {
+    l4_uint32_t compound;
+    l4_uint32_t refs[Chunk_pages];
+  };
+
   extern l4_addr_t base_addr;
   extern l4_addr_t max_addr;
-  extern l4_uint32_t *pages;
 
+  /**
+   * Sparse table of chunks between `base_addr` and `max_addr`, entries for
+   * chunks without RAM are null.
+   */
+  extern Chunk **chunks;
+
+  /**
+   * Register RAM that Moe received from sigma0.
+   *
+   * Before alloc_chunks() the range is only recorded, afterwards the page
+   * descriptors of its chunks are allocated right away.
+   */
+  void add_ram(l4_addr_t start, l4_addr_t end);
+
+  /// Allocate the empty chunk table covering `base` to `end`.
+  void init(l4_addr_t base, l4_addr_t end);
+
+  /**
+   * Allocate the page descriptors of all chunks registered with add_ram().
+   *
+   * \return Size of the page descriptors in bytes.
+   */
+  unsigned long alloc_chunks();
+
+  /**
+   * Get the chunk of a page.
+   *
+   * \return The chunk, or null if Moe never received the page from sigma0.
+   */
   inline
-  l4_uint32_t &ref_count(void *addr)
+  Chunk *chunk(void *addr)
   {
-    assert(l4_addr_t(addr) >= base_addr);
-    assert(l4_addr_t(addr) <  max_addr);
-    return pages[(l4_addr_t(addr) - base_addr) >> L4_PAGESHIFT];
+    if (l4_addr_t(addr) < base_addr || l4_addr_t(addr) >= max_addr)
+      return 0;
+
+    return chunks[(l4_addr_t(addr) >> Chunk_shift)
+                  - (base_addr >> Chunk_shift)];
   }
 
-  inline 
+  /*
+   * Pages without descriptors are not reference counted. They are never
+   * freed and always count as shared, so they are copied on write.
+   */
+  enum { Untracked_count = 2 };
+
+  inline
+  l4_uint32_t *page_ref(Chunk *c, void *addr)
+  { return &c->refs[(l4_addr_t(addr) >> L4_PAGESHIFT) & (Chunk_pages - 1)]; }
+
+  inline
+  unsigned long ref_count(void *addr)
+  {
+    Chunk *c = chunk(addr);
+    if (!c)
+      return Untracked_count;
+
+    return l4_uint32_t(__atomic_load_n(&c->compound, __ATOMIC_ACQUIRE)
+                       + __atomic_load_n(page_ref(c, addr), __ATOMIC_ACQUIRE));
+  }
+
+  inline
   unsigned long share(void *addr)
-  { return l4util_inc32_res(&ref_count(addr)); }
+  {
+    Chunk *c = chunk(addr);
+    if (!c)
+      return Untracked_count;
+
+    l4_uint32_t r = l4util_inc32_res(page_ref(c, addr));
+    return l4_uint32_t(r + __atomic_load_n(&c->compound, __ATOMIC_ACQUIRE));
+  }
 
   inline
   unsigned long unshare(void *addr)
-  { return l4util_dec32_res(&ref_count(addr)); }
+  {
+    Chunk *c = chunk(addr);
+    if (!c)
+      return Untracked_count;
+
+    l4_uint32_t r = l4util_dec32_res(page_ref(c, addr));
+    return l4_uint32_t(r + __atomic_load_n(&c->compound, __ATOMIC_ACQUIRE));
+  }
+
+  /**
+   * Take a reference to all pages of a free superpage.
+   *
+   * \param addr  Superpage-aligned address of a superpage that was just
+   *              allocated, none of its pages is referenced.
+   */
+  inline
+  void share_superpage(void *addr)
+  {
+    assert(!(l4_addr_t(addr) & ((1UL << Chunk_shift) - 1)));
+    Chunk *c = chunk(addr);
+    if (c)
+      __atomic_add_fetch(&c->compound, 1, __ATOMIC_RELEASE);
+  }
 };
 };
-
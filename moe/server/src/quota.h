@@ -22,6 +22,7 @@
 
 #include "malloc.h"
 #include "page_alloc.h"
+#include "zero_pool.h"
 
 namespace Moe {
 
@@ -37,26 +38,30 @@ public:
     if (_limit && (s > _limit))
       return false;
 
-    if (_limit && (_used > _limit - s))
+    // quotas are shared by objects served by different threads
+    size_t used = __atomic_load_n(&_used, __ATOMIC_RELAXED);
+    do
       {
-        if (_used > _limit - s)
+        if (_limit && (used > _limit - s))
           return false;
       }
+    while (!__atomic_compare_exchange_n(&_used, &used, used + s, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 
-    _used += s;
-    //printf("Q: alloc(%zx) -> %zx\n", s, _used);
+    //printf("Q: alloc(%zx) -> %zx\n", s, used + s);
     return true;
   }
 
   void free(size_t s)
   {
-    assert(s <= _used);
-    _used -= s;
-    //printf("Q: free(%zx) -> %zx\n", s, _used);
+    size_t used = __atomic_fetch_sub(&_used, s, __ATOMIC_RELAXED);
+    assert(s <= used);
+    (void)used;
+    //printf("Q: free(%zx) -> %zx\n", s, used - s);
   }
 
   size_t limit() const { return _limit; }
-  size_t used() const { return _used; }
+  size_t used() const { return __atomic_load_n(&_used, __ATOMIC_RELAXED); }
 
 private:
   size_t _limit;
@@ -131,6 +136,29 @@ public:
     return g.release(Single_page_alloc_base::_alloc(size, align));
   }
 
+  void *alloc_pages(unsigned long size, unsigned long align,
+                    Single_page_alloc_base::Nothrow) throw()
+  {
+    if (!quota()->alloc(size))
+      return 0;
+
+    void *p = Single_page_alloc_base::_alloc(Single_page_alloc_base::nothrow,
+                                             size, align);
+    if (!p)
+      quota()->free(size);
+
+    return p;
+  }
+
+  /**
+   * Allocate a zero-filled page, preferably from the zero pool.
+   */
+  void *alloc_zeroed_page()
+  {
+    Quota_guard g(quota(), L4_PAGESIZE);
+    return g.release(Zero_pool::alloc());
+  }
+
   void free_pages(void *p, unsigned long size) throw()
   {
     Single_page_alloc_base::_free(p, size);
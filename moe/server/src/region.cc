@@ -58,6 +58,7 @@ int Region_ops::map(Region_handler const *h, l4_addr_t adr,
   static Snd_fpage::Cacheopt const cache_map[] =
     { Snd_fpage::None, Snd_fpage::Buffered, Snd_fpage::Uncached };
 
+  Moe::Lock_guard<Moe::Spin_lock> g(h->memory()->lock());
   auto ds_fpage = h->memory()->address(offs + h->offset(), rw, adr,
                                        r.start(), r.end());
   if (ds_fpage.is_nil())
@@ -75,6 +76,7 @@ Region_ops::free(Region_handler const *h, l4_addr_t start, unsigned long size)
   if (h->is_ro() || !h->memory())
     return;
 
+  Moe::Lock_guard<Moe::Spin_lock> g(h->memory()->lock());
   h->memory()->clear(h->offset() + start, size);
 }
 
@@ -77,6 +77,7 @@ l4_sched_cpu_set_t operator & (l4_sched_cpu_set_t const &a, l4_sched_cpu_set_t c
 }
 
 Sched_proxy::List Sched_proxy::_list;
+Moe::Spin_lock Sched_proxy::_list_lock;
 
 Sched_proxy::Sched_proxy() :
   Icu(1, &_scheduler_irq),
@@ -85,6 +86,8 @@ Sched_proxy::Sched_proxy() :
   _prio_offset(0), _prio_limit(0)
 {
   rescan_cpus();
+
+  Moe::Lock_guard<Moe::Spin_lock> g(_list_lock);
   _list.push_front(this);
 }
 
@@ -108,6 +111,7 @@ Sched_proxy::rescan_cpus()
 
 Sched_proxy::~Sched_proxy()
 {
+  Moe::Lock_guard<Moe::Spin_lock> g(_list_lock);
   _list.remove(this);
 }
 
@@ -168,7 +172,7 @@ Sched_proxy::received_thread(L4::Ipc::Snd_fpage const &fp)
   if (!fp.cap_received())
     return L4::Cap<L4::Thread>::Invalid;
 
-  return L4::Cap<L4::Thread>(Rcv_cap << L4_CAP_SHIFT);
+  return L4::cap_cast<L4::Thread>(::rcv_cap());
 }
 
 void
@@ -185,6 +189,7 @@ class Cpu_hotplug_server :
 public:
   void handle_irq()
   {
+    Moe::Lock_guard<Moe::Spin_lock> g(Sched_proxy::_list_lock);
     for (auto i : Sched_proxy::_list)
       {
         i->rescan_cpus();
@@ -192,6 +197,8 @@ public:
       }
   }
 
+  bool exclusive_dispatch() const override { return true; }
+
   Cpu_hotplug_server()
   {
     L4::Cap<L4::Irq> irq = object_pool.cap_alloc()->alloc<L4::Irq>();
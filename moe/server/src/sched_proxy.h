@@ -48,11 +48,14 @@ public:
 
   L4::Cap<L4::Thread> received_thread(L4::Ipc::Snd_fpage const &fp);
   L4::Cap<void> rcv_cap() const
-  { return L4::Cap<L4::Thread>(Rcv_cap << L4_CAP_SHIFT); }
+  { return L4::cap_cast<L4::Thread>(::rcv_cap()); }
 
   void restrict_cpus(l4_umword_t cpus);
   void rescan_cpus();
 
+  // CPU hotplug events update all scheduler proxies
+  bool exclusive_dispatch() const override { return true; }
+
   Icu::Irq *scheduler_irq() { return &_scheduler_irq; }
   Icu::Irq const *scheduler_irq() const { return &_scheduler_irq; }
 
@@ -66,5 +69,6 @@ private:
 
   typedef cxx::H_list_t_bss<Sched_proxy> List;
   static List _list;
+  static Moe::Spin_lock _list_lock;
 };
 
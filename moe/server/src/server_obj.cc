@@ -1,11 +1,20 @@
 #include "server_obj.h"
 #include "globals.h"
+#include "threads.h"
 
 static Moe::Null_handler null_handler;
 
+Moe::Server_object::Server_object()
+: _server_thread(Moe::Threads::current())
+{}
+
 Moe::Server_object::~Server_object()
 {
-  _weak_ptrs.reset();
+  {
+    Lock_guard<Spin_lock> g(object_pool.life_lock);
+    _weak_ptrs.reset();
+    Obj_list::remove(this);
+  }
 
   if (_weak_cap)
     object_pool.cap_alloc()->free(_weak_cap);
@@ -17,15 +26,23 @@ Moe::Server_object::~Server_object()
                reinterpret_cast<l4_umword_t>(static_cast<L4::Epiface *>(this)),
                ~0UL,
                reinterpret_cast<l4_umword_t>(static_cast<L4::Epiface *>(&null_handler)));
-      L4::Cap<L4::Thread>(L4_BASE_THREAD_CAP)->modify_senders(todo);
+      _server_thread->modify_senders(todo);
 
       object_pool.cap_alloc()->free(obj_cap(), L4_FP_ALL_SPACES | L4_FP_DELETE_OBJ);
     }
 }
 
+void
+Moe::Server_object::add_child(Server_object *o)
+{
+  Lock_guard<Spin_lock> g(object_pool.life_lock);
+  Obj_list::insert_after(o, Obj_list::iter(this));
+}
+
 void
 Moe::Server_object::add_weak_ref(cxx::Weak_ref_base *obj) const
 {
+  Lock_guard<Spin_lock> g(object_pool.life_lock);
   if (_weak_ptrs.empty() && obj_cap())
     {
       _weak_cap = object_pool.cap_alloc()->alloc<L4::Kobject>();
@@ -40,6 +57,7 @@ Moe::Server_object::add_weak_ref(cxx::Weak_ref_base *obj) const
 void
 Moe::Server_object::remove_weak_ref(cxx::Weak_ref_base *obj) const
 {
+  Lock_guard<Spin_lock> g(object_pool.life_lock);
   _weak_ptrs.remove(obj);
 
   if (_weak_ptrs.empty() && _weak_cap)
@@ -11,6 +11,7 @@
 #include <l4/cxx/hlist>
 #include <l4/cxx/weak_ref>
 #include <l4/sys/cxx/ipc_epiface>
+#include <l4/sys/thread>
 
 
 namespace Moe
@@ -31,12 +32,38 @@ public:
    */
   typedef cxx::H_list_t<Server_object> Obj_list;
 
+  Server_object();
   virtual ~Server_object();
 
   void add_weak_ref(cxx::Weak_ref_base *obj) const;
   void remove_weak_ref(cxx::Weak_ref_base *obj) const;
 
+  /// Insert `o` into the list of dynamic objects right after this object.
+  void add_child(Server_object *o);
+
+  /// Thread that receives the requests to this object.
+  L4::Cap<L4::Thread> server_thread() const { return _server_thread; }
+
+  /**
+   * Set the thread that receives the requests to this object.
+   *
+   * Must be called before the IPC gate of the object is created.
+   */
+  void server_thread(L4::Cap<L4::Thread> t) { _server_thread = t; }
+
+  /**
+   * Whether requests to this object must not run concurrently with
+   * requests to any other object.
+   *
+   * Objects that are not safe for concurrent use by several server threads
+   * return true. Their requests are dispatched, like all others, while
+   * holding the object lock of the registry shared, and additionally while
+   * holding a global lock that serializes all exclusive requests.
+   */
+  virtual bool exclusive_dispatch() const { return false; }
+
 private:
+  L4::Cap<L4::Thread> _server_thread;
   mutable cxx::Weak_ref_base::List _weak_ptrs;
   mutable L4::Cap<void> _weak_cap;
 };
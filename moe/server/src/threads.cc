@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+#include "threads.h"
+#include "globals.h"
+#include "lock.h"
+#include "page_alloc.h"
+
+#include <l4/libloader/adjust_stack>
+#include <l4/re/env>
+#include <l4/sys/debugger.h>
+#include <l4/sys/factory>
+#include <l4/sys/scheduler>
+
+namespace {
+
+enum
+{
+  // Server threads run the same dispatch paths as the main thread,
+  // including exception unwinding and the debug output of the allocator.
+  // Use the size of the largest main thread stack of all architectures.
+  Stack_size = 0x8000,
+};
+
+l4_addr_t _utcb0;
+unsigned _num_threads = 1;
+unsigned _max_threads = Moe::Threads::Max_threads;
+L4::Cap<L4::Thread> _caps[Moe::Threads::Max_threads];
+
+unsigned _servers[Moe::Threads::Max_threads];
+unsigned _num_servers = 1;
+unsigned _next_server;
+
+Moe::Spin_lock _lock;
+
+}
+
+void
+Moe::Threads::init()
+{
+  _utcb0 = (l4_addr_t)l4_utcb();
+}
+
+unsigned
+Moe::Threads::self()
+{
+  if (!_utcb0)
+    return 0;
+
+  return ((l4_addr_t)l4_utcb() - _utcb0) / L4_UTCB_OFFSET;
+}
+
+L4::Cap<L4::Thread>
+Moe::Threads::cap(unsigned idx)
+{
+  // also valid for static objects constructed before init()
+  if (idx == 0)
+    return L4::Cap<L4::Thread>(L4_BASE_THREAD_CAP);
+
+  return _caps[idx];
+}
+
+long
+Moe::Threads::start(char const *name, void (*entry)(),
+                    l4_sched_param_t const &sp)
+{
+  L4Re::Env const *e = L4Re::Env::env();
+
+  unsigned idx;
+  {
+    Lock_guard<Spin_lock> g(_lock);
+    if (_num_threads >= _max_threads)
+      return -L4_ENOMEM;
+
+    idx = _num_threads++;
+  }
+
+  auto thread = object_pool.cap_alloc()->alloc<L4::Thread>();
+  if (!thread.is_valid())
+    return -L4_ENOMEM;
+
+  char *stack = (char *)Single_page_alloc_base::_alloc(
+                  Single_page_alloc_base::nothrow, Stack_size, L4_PAGESIZE);
+  if (!stack)
+    {
+      object_pool.cap_alloc()->free(thread);
+      return -L4_ENOMEM;
+    }
+
+  L4::Thread::Attr attr;
+  attr.pager(L4::Cap<void>(Sigma0_cap));
+  attr.exc_handler(L4::Cap<void>(Sigma0_cap));
+  attr.bind((l4_utcb_t *)(_utcb0 + idx * L4_UTCB_OFFSET), L4Re::This_task);
+
+  long err = l4_error(e->factory()->create(thread));
+  if (!err)
+    {
+      err = l4_error(thread->control(attr));
+      // the UTCB is beyond the end of the UTCB area, do not try again
+      if (err == -L4_EINVAL)
+        {
+          Lock_guard<Spin_lock> g(_lock);
+          _max_threads = idx;
+          if (_num_threads == idx + 1)
+            _num_threads = idx;
+          err = -L4_ENOMEM;
+        }
+    }
+
+  if (err)
+    {
+      object_pool.cap_alloc()->free(thread);
+      Single_page_alloc_base::_free(stack, Stack_size);
+      return err;
+    }
+
+  l4_debugger_set_object_name(thread.cap(), name);
+  _caps[idx] = thread;
+
+  e->scheduler()->run_thread(thread, sp);
+  thread->ex_regs((l4_umword_t)entry,
+                  (l4_umword_t)Ldr::adjust_sp(stack + Stack_size), 0);
+
+  return idx;
+}
+
+void
+Moe::Threads::add_server(unsigned idx)
+{
+  Lock_guard<Spin_lock> g(_lock);
+  _servers[_num_servers++] = idx;
+}
+
+L4::Cap<L4::Thread>
+Moe::Threads::next_server()
+{
+  Lock_guard<Spin_lock> g(_lock);
+  unsigned i = _next_server++ % _num_servers;
+  return _caps[_servers[i]];
+}
+
+unsigned
+Moe::Threads::num_servers()
+{ return _num_servers; }
+
+unsigned
+Moe::Threads::max_threads()
+{ return _max_threads; }
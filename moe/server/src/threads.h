@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/sys/capability>
+#include <l4/sys/scheduler.h>
+#include <l4/sys/thread>
+#include <l4/sys/utcb.h>
+
+namespace Moe {
+
+/**
+ * Threads of Moe's task.
+ *
+ * Each thread uses one UTCB of the UTCB area the kernel created Moe's task
+ * with, the index of the UTCB in the area identifies the thread. The main
+ * thread has index 0.
+ *
+ * The size of the UTCB area is not announced to Moe. start() finds it out
+ * when the kernel refuses to bind a thread to a UTCB outside of the area.
+ */
+namespace Threads {
+
+enum
+{
+  /// Upper bound for the number of threads, the UTCB area may hold fewer.
+  Max_threads = 64,
+};
+
+/// Remember the UTCB of the main thread, must be called first.
+void init();
+
+/// Index of the calling thread.
+unsigned self();
+
+/// Capability of the thread with index `idx`.
+L4::Cap<L4::Thread> cap(unsigned idx);
+
+/// Capability of the calling thread.
+inline L4::Cap<L4::Thread> current()
+{ return cap(self()); }
+
+/**
+ * Create and start a thread.
+ *
+ * \param name   Name of the thread for the kernel debugger.
+ * \param entry  Function executed by the thread, must not return.
+ * \param sp     Scheduling parameters of the thread.
+ *
+ * \return Index of the new thread, or a negative error code.
+ */
+long start(char const *name, void (*entry)(), l4_sched_param_t const &sp);
+
+/// Let the thread with index `idx` serve IPC gates of new objects.
+void add_server(unsigned idx);
+
+/**
+ * Server thread for a new group of objects.
+ *
+ * Server threads are picked round robin, so that objects created by
+ * different factories are spread over all server threads.
+ */
+L4::Cap<L4::Thread> next_server();
+
+/// Number of server threads including the main thread.
+unsigned num_servers();
+
+/**
+ * Maximum number of threads.
+ *
+ * This is Max_threads until start() detected the end of the UTCB area.
+ */
+unsigned max_threads();
+
+}}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+#include "zero_pool.h"
+#include "debug.h"
+#include "globals.h"
+#include "lock.h"
+#include "page_alloc.h"
+#include "threads.h"
+
+#include <l4/cxx/exceptions>
+#include <l4/re/env>
+#include <l4/sys/cache.h>
+#include <l4/sys/factory>
+#include <l4/sys/ipc.h>
+#include <l4/sys/irq>
+#include <l4/sys/scheduler>
+
+#include <cstring>
+
+void *Moe::Zero_pool::_pages[Max_depth];
+unsigned Moe::Zero_pool::_depth = Default_depth;
+unsigned Moe::Zero_pool::_watermark = Default_depth / 2;
+unsigned long Moe::Zero_pool::_head;
+unsigned long Moe::Zero_pool::_zeroed;
+unsigned long Moe::Zero_pool::_tail;
+unsigned long Moe::Zero_pool::_hits;
+unsigned long Moe::Zero_pool::_misses;
+unsigned long Moe::Zero_pool::_drained;
+
+namespace {
+
+enum
+{
+  Worker_prio = 1,
+};
+
+// the worker is woken up through this IRQ whenever there is work to do
+L4::Cap<L4::Irq> _wakeup;
+
+// serializes server threads taking pages from and adding pages to the pool
+Moe::Spin_lock _lock;
+
+// the thread holding _lock, page allocations under the lock that fail
+// call back into drain()
+l4_utcb_t *_owner;
+
+void zero_page(void *p)
+{
+  memset(p, 0, L4_PAGESIZE);
+  // No need for I cache coherence, as we just zero fill and assume that
+  // this is no executable code
+  l4_cache_clean_data((l4_addr_t)p, (l4_addr_t)p + L4_PAGESIZE - 1);
+}
+
+}
+
+void
+Moe::Zero_pool::depth(unsigned pages)
+{
+  if (pages > Max_depth)
+    pages = Max_depth;
+
+  _depth = pages;
+  _watermark = (pages + 1) / 2;
+}
+
+void
+Moe::Zero_pool::worker()
+{
+  _wakeup->bind_thread(Threads::current(), 0);
+
+  for (;;)
+    {
+      unsigned long z = _zeroed;
+      while (z != __atomic_load_n(&_head, __ATOMIC_ACQUIRE))
+        {
+          zero_page(_pages[z % Max_depth]);
+          __atomic_store_n(&_zeroed, ++z, __ATOMIC_RELEASE);
+        }
+
+      l4_ipc_receive(_wakeup.cap(), l4_utcb(), L4_IPC_NEVER);
+    }
+}
+
+void
+Moe::Zero_pool::start()
+{
+  if (!_depth)
+    return;
+
+  auto irq = object_pool.cap_alloc()->alloc<L4::Irq>();
+  if (!irq.is_valid()
+      || l4_error(L4Re::Env::env()->factory()->create(irq)))
+    {
+      Dbg(Dbg::Warn).printf("zero pool: could not create IRQ, pool disabled\n");
+      _depth = 0;
+      return;
+    }
+
+  // the worker binds the IRQ itself, it checks for work before it waits
+  // for the first time, hence early triggers do not get lost
+  _wakeup = irq;
+  if (Threads::start("moe-zero", &worker, l4_sched_param(Worker_prio)) < 0)
+    {
+      Dbg(Dbg::Warn).printf("zero pool: could not start worker, pool disabled\n");
+      _wakeup = L4::Cap<L4::Irq>::Invalid;
+      _depth = 0;
+      return;
+    }
+
+  refill();
+}
+
+void
+Moe::Zero_pool::refill()
+{
+  // nothing to do before the worker runs or below the watermark
+  if (!_wakeup.is_valid() || _head - _tail >= _watermark)
+    return;
+
+  // leave the memory to the clients when it is getting scarce
+  if ((Single_page_alloc_base::_avail() >> L4_PAGESHIFT) < 2UL * _depth)
+    return;
+
+  unsigned long h = _head;
+  for (; h - _tail < _depth; ++h)
+    {
+      void *p = Single_page_alloc_base::_alloc(Single_page_alloc_base::nothrow,
+                                               L4_PAGESIZE, L4_PAGESIZE);
+      if (!p)
+        break;
+
+      _pages[h % Max_depth] = p;
+    }
+
+  if (h == _head)
+    return;
+
+  __atomic_store_n(&_head, h, __ATOMIC_RELEASE);
+  _wakeup->trigger();
+}
+
+void *
+Moe::Zero_pool::take()
+{
+  Lock_guard<Spin_lock> g(_lock);
+  __atomic_store_n(&_owner, l4_utcb(), __ATOMIC_RELAXED);
+
+  void *p;
+  if (_tail != __atomic_load_n(&_zeroed, __ATOMIC_ACQUIRE))
+    {
+      p = _pages[_tail++ % Max_depth];
+      ++_hits;
+    }
+  else
+    {
+      p = Single_page_alloc_base::_alloc(Single_page_alloc_base::nothrow,
+                                         L4_PAGESIZE, L4_PAGESIZE);
+      if (p)
+        zero_page(p);
+      ++_misses;
+    }
+
+  refill();
+  __atomic_store_n(&_owner, (l4_utcb_t *)0, __ATOMIC_RELAXED);
+  return p;
+}
+
+void *
+Moe::Zero_pool::alloc()
+{
+  void *p = take();
+  if (!p)
+    throw L4::Out_of_memory();
+
+  return p;
+}
+
+bool
+Moe::Zero_pool::drain()
+{
+  // the calling thread already holds the lock, the pool has no zeroed
+  // pages to give back then anyway
+  if (__atomic_load_n(&_owner, __ATOMIC_RELAXED) == l4_utcb())
+    return false;
+
+  Lock_guard<Spin_lock> g(_lock);
+  unsigned long z = __atomic_load_n(&_zeroed, __ATOMIC_ACQUIRE);
+  if (_tail == z)
+    return false;
+
+  _drained += z - _tail;
+  while (_tail != z)
+    Single_page_alloc_base::_free(_pages[_tail++ % Max_depth]);
+
+  return true;
+}
+
+void
+Moe::Zero_pool::dump(Dbg &out)
+{
+  if (!_depth)
+    {
+      out.printf("zero pool: off\n");
+      return;
+    }
+
+  unsigned long zeroed = __atomic_load_n(&_zeroed, __ATOMIC_ACQUIRE);
+  out.printf("zero pool: depth: %u, watermark: %u, zeroed: %lu, dirty: %lu, "
+             "hits: %lu, misses: %lu, drained: %lu\n",
+             _depth, _watermark, zeroed - _tail, _head - zeroed,
+             _hits, _misses, _drained);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/sys/compiler.h>
+#include <l4/sys/consts.h>
+
+class Dbg;
+
+namespace Moe {
+
+/**
+ * Pool of pre-zeroed pages.
+ *
+ * The server thread hands pages from the page allocator to a worker thread
+ * running at a low priority that zeroes them while Moe is otherwise idle.
+ * Page faults on fresh memory then take an already zeroed page in O(1).
+ *
+ * The pool is a ring of pages: pages between the tail and the zeroed index
+ * are ready for use, pages between the zeroed index and the head still
+ * have to be zeroed by the worker. Server threads take and add pages under
+ * a lock, the worker only writes the zeroed index.
+ */
+class Zero_pool
+{
+public:
+  enum
+  {
+    /// Maximum number of pages in the pool.
+    Max_depth = 1024,
+    Default_depth = 128,
+  };
+
+  /**
+   * Start the worker thread.
+   *
+   * Does nothing if the pool is disabled.
+   */
+  static void start();
+
+  /**
+   * Set the number of pages kept in the pool, 0 disables the pool.
+   *
+   * The pool is refilled when it drops below half of the depth.
+   */
+  static void depth(unsigned pages);
+  static unsigned depth() { return _depth; }
+
+  /**
+   * Allocate a zero-filled page.
+   *
+   * Takes a page from the pool if there is one, otherwise the page is
+   * allocated and zeroed directly.
+   *
+   * \throws L4::Out_of_memory  No memory left.
+   */
+  static void *alloc();
+
+  /**
+   * Give the zeroed pages of the pool back to the page allocator.
+   *
+   * Called by the page allocator when it runs out of memory. Pages the
+   * worker is still zeroing stay in the pool. The pool is refilled only
+   * while the page allocator has plenty of memory left.
+   *
+   * \return true if pages were given back.
+   */
+  static bool drain();
+
+  /// Print the pool statistics.
+  static void dump(Dbg &out);
+
+private:
+  static void *take();
+  static void refill();
+  static void worker() L4_NORETURN;
+
+  static void *_pages[Max_depth];
+  static unsigned _depth;
+  static unsigned _watermark;
+
+  // free running indices into _pages
+  static unsigned long _head;
+  static unsigned long _zeroed;
+  static unsigned long _tail;
+
+  static unsigned long _hits;
+  static unsigned long _misses;
+  static unsigned long _drained;
+};
+
+}
@@ -27,10 +27,11 @@ private:
 public:
   enum State { Initializing, Running, Zombie };
 
-  long remove_ref() { return --_ref_cnt; }
-  void add_ref() { ++_ref_cnt; }
+  // tasks are referenced from the Lua, server, and launcher threads
+  long remove_ref() { return __atomic_sub_fetch(&_ref_cnt, 1, __ATOMIC_ACQ_REL); }
+  void add_ref() { __atomic_add_fetch(&_ref_cnt, 1, __ATOMIC_RELAXED); }
 
-  long ref_cnt() const { return _ref_cnt; }
+  long ref_cnt() const { return __atomic_load_n(&_ref_cnt, __ATOMIC_RELAXED); }
 
 private:
 
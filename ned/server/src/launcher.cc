@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#include "launcher.h"
+#include "debug.h"
+
+#include <l4/cxx/exceptions>
+#include <l4/re/env.h>
+#include <l4/sys/kip.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace Ned {
+
+Launcher launcher;
+
+static l4_cpu_time_t now()
+{ return l4_kip_clock(l4re_kip()); }
+
+Launch::Launch()
+: _ref_cnt(0), _state(Queued), _next(0), _num_deps(0), _last(0)
+{
+  memset(_times, 0, sizeof(_times));
+  _name[0] = 0;
+  _error[0] = 0;
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_done, NULL);
+}
+
+Launch::~Launch()
+{
+  pthread_cond_destroy(&_done);
+  pthread_mutex_destroy(&_lock);
+}
+
+void
+Launch::set_name(char const *name)
+{
+  snprintf(_name, sizeof(_name), "%s", name);
+}
+
+void
+Launch::phase_done(Phase p)
+{
+  l4_cpu_time_t t = now();
+  _times[p] += t - _last;
+  _last = t;
+}
+
+void
+Launch::execute()
+{
+  // a launch run directly was never queued
+  if (_last)
+    phase_done(Ph_queue);
+  else
+    _last = now();
+
+  __atomic_store_n(&_state, Running, __ATOMIC_RELEASE);
+
+  State res = Done;
+  for (unsigned i = 0; i < _num_deps; ++i)
+    if (_deps[i] && !_deps[i]->wait())
+      {
+        snprintf(_error, sizeof(_error), "dependency '%s' failed",
+                 _deps[i]->name());
+        res = Failed;
+        break;
+      }
+
+  _deps = 0;
+  _num_deps = 0;
+  phase_done(Ph_deps);
+
+  if (res == Done)
+    {
+      try
+        {
+          run();
+        }
+      catch (L4::Runtime_error const &e)
+        {
+          snprintf(_error, sizeof(_error), "%s (%s: %ld)", e.str(),
+                   e.extra_str(), e.err_no());
+          res = Failed;
+        }
+      catch (char const *e)
+        {
+          snprintf(_error, sizeof(_error), "%s", e);
+          res = Failed;
+        }
+    }
+
+  Dbg(Dbg::Boot, "launch")
+    .printf("%s: %s, queue %llu, deps %llu, task %llu, stack %llu, "
+            "load %llu, start %llu us\n",
+            _name, res == Done ? "started" : "failed",
+            _times[Ph_queue], _times[Ph_deps], _times[Ph_task],
+            _times[Ph_stack], _times[Ph_load], _times[Ph_start]);
+
+  pthread_mutex_lock(&_lock);
+  __atomic_store_n(&_state, res, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&_done);
+  pthread_mutex_unlock(&_lock);
+}
+
+bool
+Launch::wait()
+{
+  if (state() < Done)
+    {
+      pthread_mutex_lock(&_lock);
+      while (state() < Done)
+        pthread_cond_wait(&_done, &_lock);
+      pthread_mutex_unlock(&_lock);
+    }
+
+  return state() == Done;
+}
+
+
+Launcher::Launcher()
+: _first(0), _last(0), _threads(0), _idle(0), _max_threads(Default_threads)
+{
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_work, NULL);
+}
+
+void
+Launcher::queue(cxx::Ref_ptr<Launch> const &l)
+{
+  // the queue holds a reference until a launcher thread takes the launch
+  Launch *n = cxx::Ref_ptr<Launch>(l).release();
+  n->_last = now();
+
+  pthread_mutex_lock(&_lock);
+  if (_last)
+    _last->_next = n;
+  else
+    _first = n;
+  _last = n;
+
+  if (!_idle && _threads < _max_threads)
+    {
+      pthread_t t;
+      if (pthread_create(&t, NULL, __run, this) == 0)
+        {
+          pthread_detach(t);
+          ++_threads;
+        }
+      else if (!_threads)
+        Err().printf("launch: cannot create launcher thread\n");
+    }
+  else
+    pthread_cond_signal(&_work);
+  pthread_mutex_unlock(&_lock);
+
+  // Without any launcher thread run the launch right here.
+  if (!_threads)
+    {
+      pthread_mutex_lock(&_lock);
+      Launch *f = _first;
+      _first = f->_next;
+      if (!_first)
+        _last = 0;
+      pthread_mutex_unlock(&_lock);
+
+      cxx::Ref_ptr<Launch>(f, true)->execute();
+    }
+}
+
+void *
+Launcher::__run(void *a)
+{
+  static_cast<Launcher *>(a)->run();
+  return 0;
+}
+
+void
+Launcher::run()
+{
+  pthread_mutex_lock(&_lock);
+  for (;;)
+    {
+      while (!_first)
+        {
+          ++_idle;
+          pthread_cond_wait(&_work, &_lock);
+          --_idle;
+        }
+
+      Launch *l = _first;
+      _first = l->_next;
+      if (!_first)
+        _last = 0;
+      l->_next = 0;
+      pthread_mutex_unlock(&_lock);
+
+      cxx::Ref_ptr<Launch>(l, true)->execute();
+
+      pthread_mutex_lock(&_lock);
+    }
+}
+
+}
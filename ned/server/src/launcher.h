@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#pragma once
+
+#include <l4/cxx/ref_ptr>
+#include <l4/cxx/unique_ptr>
+#include <l4/sys/l4int.h>
+#include <pthread.h>
+
+namespace Ned {
+
+/**
+ * A program launch that may run on a launcher thread.
+ *
+ * A launch runs after all launches it depends on have finished, and
+ * records the time spent in each of its phases.
+ */
+class Launch
+{
+public:
+  enum State { Queued, Running, Done, Failed };
+
+  enum Phase
+  {
+    Ph_queue,   ///< waiting for a launcher thread
+    Ph_deps,    ///< waiting for the launches this one depends on
+    Ph_task,    ///< creating the task control block and region map
+    Ph_stack,   ///< reading the binary and allocating the stack
+    Ph_load,    ///< loading the ELF segments
+    Ph_start,   ///< mapping capabilities and starting the first thread
+    Num_phases
+  };
+
+  Launch();
+  virtual ~Launch();
+
+  void add_ref() { __atomic_add_fetch(&_ref_cnt, 1, __ATOMIC_RELAXED); }
+  long remove_ref() { return __atomic_sub_fetch(&_ref_cnt, 1, __ATOMIC_ACQ_REL); }
+
+  /// Set the launches that must be done before this one runs.
+  void depends_on(cxx::unique_ptr<cxx::Ref_ptr<Launch>[]> deps, unsigned num)
+  {
+    _deps = cxx::move(deps);
+    _num_deps = num;
+  }
+
+  /// Run the launch in the calling thread, or the launcher thread.
+  void execute();
+
+  /// Wait until the launch is done, returns false if it failed.
+  bool wait();
+
+  State state() const { return __atomic_load_n(&_state, __ATOMIC_ACQUIRE); }
+  char const *name() const { return _name; }
+  void set_name(char const *name);
+  char const *error() const { return _error; }
+
+  /// Account the time since the last phase ended to phase `p`.
+  void phase_done(Phase p);
+
+protected:
+  /// Do the actual work, throws on failure.
+  virtual void run() = 0;
+
+private:
+  friend class Launcher;
+
+  long _ref_cnt;
+  State _state;
+  Launch *_next;
+
+  cxx::unique_ptr<cxx::Ref_ptr<Launch>[]> _deps;
+  unsigned _num_deps;
+
+  l4_cpu_time_t _last;
+  l4_cpu_time_t _times[Num_phases];
+
+  char _name[48];
+  char _error[160];
+
+  pthread_mutex_t _lock;
+  pthread_cond_t _done;
+};
+
+/**
+ * Pool of threads that run queued launches in FIFO order.
+ *
+ * A launch may only depend on launches queued before it, so a launcher
+ * thread waiting for the dependencies of its launch never waits for a
+ * launch that is not yet picked up.
+ */
+class Launcher
+{
+public:
+  enum { Default_threads = 4 };
+
+  Launcher();
+
+  void queue(cxx::Ref_ptr<Launch> const &l);
+
+  /// Set the maximum number of launcher threads.
+  void max_threads(unsigned n) { _max_threads = n ? n : 1; }
+
+private:
+  static void *__run(void *);
+  void run();
+
+  pthread_mutex_t _lock;
+  pthread_cond_t _work;
+  Launch *_first, *_last;
+  unsigned _threads, _idle, _max_threads;
+};
+
+extern Launcher launcher;
+
+}
@@ -13,6 +13,7 @@
 
 #include <l4/cxx/auto_ptr>
 #include <l4/cxx/ref_ptr>
+#include <l4/cxx/unique_ptr>
 #include <l4/libloader/elf>
 #include <l4/util/bitops.h>
 
@@ -24,6 +25,10 @@
 #include "lua.h"
 #include "lua_cap.h"
 #include "server.h"
+#include "launcher.h"
+
+#include <cstdio>
+#include <cstring>
 
 using L4Re::chksys;
 
@@ -65,6 +70,13 @@ Observer::op_wait(Obs_iface::Rights, l4_cap_idx_t thread, Obs_iface::Task task)
   return -L4_ENOREPLY;
 }
 
+/**
+ * Application model of a program started from Lua.
+ *
+ * parse_cfg() takes everything it needs from the Lua arguments, so the
+ * program can be loaded and started without access to the Lua state, for
+ * example by a launcher thread.
+ */
 class Am : public Rmt_app_model
 {
 private:
@@ -86,6 +98,56 @@ private:
     }
   };
 
+  // initial capability from the "caps" table of the configuration
+  struct Initial_cap
+  {
+    char name[sizeof(l4re_env_cap_entry_t::name) + 2];
+    L4Re::Util::Ref_cap<void>::Cap cap;
+    l4_fpage_t fpage;
+    unsigned long ext_rights;
+  };
+
+  // NUL-terminated strings stored back to back
+  class Strings
+  {
+  private:
+    cxx::unique_ptr<char[]> _b;
+    unsigned long _size = 0;
+    unsigned long _used = 0;
+
+  public:
+    void add(char const *s, unsigned long len, char const *s2 = 0,
+             unsigned long len2 = 0)
+    {
+      unsigned long need = _used + len + (s2 ? len2 + 1 : 0) + 1;
+      if (need > _size)
+        {
+          unsigned long n = _size ? _size * 2 : 256;
+          while (n < need)
+            n *= 2;
+
+          cxx::unique_ptr<char[]> b(new char[n]);
+          if (_used)
+            memcpy(b.get(), _b.get(), _used);
+          _b = cxx::move(b);
+          _size = n;
+        }
+
+      memcpy(_b.get() + _used, s, len);
+      _used += len;
+      if (s2)
+        {
+          _b[_used++] = '=';
+          memcpy(_b.get() + _used, s2, len2);
+          _used += len2;
+        }
+      _b[_used++] = 0;
+    }
+
+    char const *first() const { return _b.get(); }
+    static char const *next(char const *s) { return s + strlen(s) + 1; }
+  };
+
   lua_State *_lua;
   int _argc;
   int _env_idx;
@@ -100,6 +162,16 @@ private:
    */
   Cap_stack<6> _cap_stack;
 
+  cxx::unique_ptr<Initial_cap[]> _caps;
+  unsigned _num_caps = 0;
+
+  // the loader, then the arguments, then the environment as "key=value"
+  Strings _strings;
+  unsigned _num_args = 0;
+  unsigned _num_env = 0;
+
+  Ned::Launch *_launch = 0;
+
   l4_umword_t _cfg_integer(char const *f, l4_umword_t def = 0)
   {
     l4_umword_t r = def;
@@ -150,20 +222,7 @@ private:
     return res;
   }
 
-public:
-
-  explicit Am(lua_State *l)
-  : Rmt_app_model(), _lua(l), _argc(lua_gettop(l)), _env_idx(0), _cfg_idx(1),
-    _arg_idx(2)
-  {
-    if (_argc > 2 && lua_type(_lua, _argc) == LUA_TTABLE)
-      _env_idx = _argc;
-
-    if (_env_idx)
-      --_argc;
-  }
-
-  l4_cap_idx_t push_initial_caps(l4_cap_idx_t start)
+  void _parse_caps()
   {
     lua_getfield(_lua, _cfg_idx, "caps");
     int tab = lua_gettop(_lua);
@@ -171,9 +230,19 @@ public:
     if (lua_isnil(_lua, tab))
       {
 	lua_pop(_lua, 1);
-        return start;
+        return;
+      }
+
+    unsigned n = 0;
+    lua_pushnil(_lua);
+    while (lua_next(_lua, tab))
+      {
+        ++n;
+        lua_pop(_lua, 1);
       }
 
+    _caps = cxx::make_unique<Initial_cap[]>(n);
+
     lua_pushnil(_lua);
     while (lua_next(_lua, tab))
       {
@@ -186,66 +255,103 @@ public:
 	    lua_call(_lua, 1, 1);
 	  }
 
-	if (!lua_isnil(_lua, -1) && lua_touserdata(_lua, -1))
+	if (!lua_isnil(_lua, -1) && lua_touserdata(_lua, -1)
+	    && _num_caps < n)
 	  {
-	    Lua::check_cap(_lua, -1);
-	    _stack.push(l4re_env_cap_entry_t(r, get_initial_cap(r, &start)));
+	    Cap *c = Lua::check_cap(_lua, -1);
+	    Initial_cap &ic = _caps[_num_caps++];
+	    snprintf(ic.name, sizeof(ic.name), "%s", r);
+	    ic.cap = c->cap<void>();
+	    ic.fpage = c->cap<void>().fpage(c->rights());
+	    ic.ext_rights = c->ext_rights();
 	  }
 	lua_pop(_lua, 1);
       }
     lua_pop(_lua, 1);
-    return start;
   }
 
-  void map_initial_caps(L4::Cap<L4::Task> task, l4_cap_idx_t start)
+  void _parse_args()
   {
-    lua_getfield(_lua, _cfg_idx, "caps");
-    int tab = lua_gettop(_lua);
+    char const *kernel = "rom/l4re";
+    lua_getfield(_lua, _cfg_idx, "l4re_loader");
+    if (lua_isstring(_lua, -1))
+      kernel = lua_tostring(_lua, -1);
 
-    if (lua_isnil(_lua, tab))
+    _strings.add(kernel, strlen(kernel));
+    lua_pop(_lua, 1);
+
+    for (int i = _arg_idx; i <= _argc; ++i)
       {
-	lua_pop(_lua, 1);
-        return;
+        if (lua_isnil(_lua, i))
+          continue;
+
+	char const *r = luaL_checkstring(_lua, i);
+	_strings.add(r, strlen(r));
+	++_num_args;
       }
 
+    if (!_env_idx)
+      return;
+
     lua_pushnil(_lua);
-    while (lua_next(_lua, tab))
+    while (lua_next(_lua, _env_idx))
       {
-	char const *r = luaL_checkstring(_lua, -2);
-	while (lua_isfunction(_lua, -1))
-	  {
-	    lua_pushvalue(_lua, tab);
-	    lua_call(_lua, 1, 1);
-	  }
+	char const *k = luaL_checkstring(_lua, -2);
+	char const *v = luaL_checkstring(_lua, -1);
 
-	if (!lua_isnil(_lua, -1) && lua_touserdata(_lua, -1))
-	  {
-	    Cap *c = Lua::check_cap(_lua, -1);
-	    auto idx = get_initial_cap(r, &start);
-	    chksys(task->map(L4Re::This_task,
-	                     c->cap<void>().fpage(c->rights()),
-	                     L4::Cap<void>(idx).snd_base() | c->ext_rights()));
-	  }
+	_strings.add(k, strlen(k), v, strlen(v));
+	++_num_env;
 	lua_pop(_lua, 1);
       }
-    lua_pop(_lua, 1);
   }
 
-  void launch_loader()
+public:
+
+  explicit Am(lua_State *l)
+  : Rmt_app_model(), _lua(l), _argc(lua_gettop(l)), _env_idx(0), _cfg_idx(1),
+    _arg_idx(2)
   {
-    char const *kernel = "rom/l4re";
-    lua_getfield(_lua, _cfg_idx, "l4re_loader");
-    if (lua_isstring(_lua, -1))
-      kernel = lua_tostring(_lua, -1);
+    if (_argc > 2 && lua_type(_lua, _argc) == LUA_TTABLE)
+      _env_idx = _argc;
+
+    if (_env_idx)
+      --_argc;
+  }
+
+  /// The program name, which is the first argument.
+  char const *prog_name() const
+  {
+    return _num_args ? Strings::next(_strings.first()) : "";
+  }
+
+  l4_cap_idx_t push_initial_caps(l4_cap_idx_t start)
+  {
+    for (unsigned i = 0; i < _num_caps; ++i)
+      _stack.push(l4re_env_cap_entry_t(_caps[i].name,
+                                       get_initial_cap(_caps[i].name, &start)));
+    return start;
+  }
+
+  void map_initial_caps(L4::Cap<L4::Task> task, l4_cap_idx_t start)
+  {
+    for (unsigned i = 0; i < _num_caps; ++i)
+      {
+        auto idx = get_initial_cap(_caps[i].name, &start);
+        chksys(task->map(L4Re::This_task, _caps[i].fpage,
+                         L4::Cap<void>(idx).snd_base() | _caps[i].ext_rights));
+      }
+  }
 
+  void launch_loader(Ned::Launch *launch)
+  {
     typedef Ldr::Elf_loader<Am, Dbg> Loader;
 
     Dbg ldr(Dbg::Loader, "ldr");
     Loader _l;
 
-    _l.launch(this, kernel, ldr);
-
-    lua_pop(_lua, 1);
+    _launch = launch;
+    _l.launch(this, _strings.first(), ldr);
+    _launch->phase_done(Ned::Launch::Ph_start);
   }
 
   void parse_cfg()
@@ -262,6 +368,8 @@ public:
     prog_info()->ldr_flags = 0;
     prog_info()->l4re_dbg = 0;
 
+    _parse_args();
+
     if (!_cfg_idx)
       return;
 
@@ -278,23 +386,33 @@ public:
       _rm_fab = c;
     else
       _rm_fab = user_factory;
+
+    _parse_caps();
   }
 
   L4Re::Util::Ref_cap<L4::Factory>::Cap rm_fab() const { return _rm_fab; }
 
   void set_task(App_task *t) { _task = t; }
 
+  void init_prog()
+  {
+    _launch->phase_done(Ned::Launch::Ph_stack);
+    Rmt_app_model::init_prog();
+  }
+
+  L4Re::Env *add_env()
+  {
+    _launch->phase_done(Ned::Launch::Ph_load);
+    return Rmt_app_model::add_env();
+  }
+
   void push_argv_strings()
   {
     argv.a0 = 0;
-    for (int i = _arg_idx; i <= _argc; ++i)
+    char const *s = Strings::next(_strings.first());
+    for (unsigned i = 0; i < _num_args; ++i, s = Strings::next(s))
       {
-        if (lua_isnil(_lua, i))
-          continue;
-
-	size_t l;
-	char const *r = luaL_checklstring(_lua, i, &l);
-	argv.al = _stack.push_str(r, l);
+	argv.al = _stack.push_str(s, strlen(s));
 	if (argv.a0 == 0)
 	  argv.a0 = argv.al;
       }
@@ -302,44 +420,98 @@ public:
 
   void push_env_strings()
   {
-    if (!_env_idx)
-      return;
+    char const *s = Strings::next(_strings.first());
+    for (unsigned i = 0; i < _num_args; ++i)
+      s = Strings::next(s);
 
-    lua_pushnil(_lua);
-    bool _f = true;
-    while (lua_next(_lua, _env_idx))
+    for (unsigned i = 0; i < _num_env; ++i, s = Strings::next(s))
       {
-	size_t kl;
-	char const *k = luaL_checklstring(_lua, -2, &kl);
-	size_t vl;
-	char const *v = luaL_checklstring(_lua, -1, &vl);
-
-	_stack.push_str(v, vl);
-	_stack.push('=');
-	envp.al = _stack.push_object(k, kl);
-	if (_f)
-	  {
-	    envp.a0 = envp.al;
-	    _f = false;
-	  }
-	lua_pop(_lua, 1);
+	envp.al = _stack.push_str(s, strlen(s));
+	if (i == 0)
+	  envp.a0 = envp.al;
       }
   }
 };
 
+class App_launch : public Ned::Launch
+{
+public:
+  explicit App_launch(lua_State *l) : _am(l) {}
+
+  void parse_cfg()
+  {
+    _am.parse_cfg();
+    set_name(_am.prog_name());
+  }
+
+  cxx::Ref_ptr<App_task> const &task() const { return _task; }
+
+protected:
+  void run() override
+  {
+    _task = cxx::Ref_ptr<App_task>(new App_task(Ned::server->registry(),
+                                                _am.rm_fab()));
+    _am.set_task(_task.get());
+    _task->running();
+    phase_done(Ph_task);
+
+    _am.launch_loader(this);
+  }
+
+private:
+  Am _am;
+  cxx::Ref_ptr<App_task> _task;
+};
+
 
 static char const *const APP_TASK_TYPE = "L4_NED_APP_TASK";
 typedef cxx::Ref_ptr<App_task> App_ptr;
 
+/**
+ * Lua handle of a program. While the program is being launched by a
+ * launcher thread the handle refers to the launch only.
+ */
+struct App_handle
+{
+  App_ptr task;
+  cxx::Ref_ptr<App_launch> launch;
+};
+
+static
+App_handle &check_handle(lua_State *l, int i)
+{
+  return *(App_handle *)luaL_checkudata(l, i, APP_TASK_TYPE);
+}
+
+/**
+ * Get the task of a handle, waits for the launch to finish first. Raises
+ * a Lua error if the launch failed.
+ */
 static
 App_ptr &check_at(lua_State *l, int i)
 {
-  App_ptr *t = (App_ptr*)luaL_checkudata(l, i, APP_TASK_TYPE);
-  return *t;
+  App_handle &h = check_handle(l, i);
+  if (h.launch)
+    {
+      if (!h.launch->wait())
+        luaL_error(l, "could not create process: %s", h.launch->error());
+
+      h.task = h.launch->task();
+      h.launch = 0;
+    }
+
+  return h.task;
 }
 
 static int __task_state(lua_State *l)
 {
+  App_handle &h = check_handle(l, 1);
+  if (h.launch && h.launch->state() < Ned::Launch::Done)
+    {
+      lua_pushstring(l, "launching");
+      return 1;
+    }
+
   App_ptr t = check_at(l, 1);
 
   if (!t)
@@ -422,10 +594,25 @@ static int __task_kill(lua_State *l)
   return 1;
 }
 
+static int __task_started(lua_State *l)
+{
+  App_handle &h = check_handle(l, 1);
+  if (h.launch && !h.launch->wait())
+    {
+      lua_pushnil(l);
+      lua_pushstring(l, h.launch->error());
+      return 2;
+    }
+
+  lua_pushboolean(l, 1);
+  return 1;
+}
+
 static int __task_gc(lua_State *l)
 {
-  App_ptr &t = check_at(l, 1);
-  t = 0; // drop reference to task
+  App_handle &h = check_handle(l, 1);
+  h.task = 0; // drop reference to task
+  h.launch = 0;
   return 0;
 }
 
@@ -458,45 +645,89 @@ static const luaL_Reg _task_ops[] = {
     { "exit_code", __task_exit_code },
     { "wait", __task_wait },
     { "kill", __task_kill },
+    { "started", __task_started },
     { NULL, NULL }
 };
 
 
-static int exec(lua_State *l)
+static App_handle *push_handle(lua_State *l)
 {
-  try {
+  App_handle *h = new (lua_newuserdata(l, sizeof(App_handle))) App_handle();
 
-  Am am(l);
-  am.parse_cfg();
+  luaL_newmetatable(l, APP_TASK_TYPE);
+  lua_setmetatable(l, -2);
+  return h;
+}
 
-  App_ptr app_task(new App_task(Ned::server->registry(), am.rm_fab()));
+static cxx::Ref_ptr<App_launch> create_launch(lua_State *l)
+{
+  cxx::Ref_ptr<App_launch> launch(new App_launch(l));
 
-  if (!app_task)
-    {
-      Err().printf("could not allocate task control block\n");
-      return 0;
-    }
+  try {
+    launch->parse_cfg();
+  } catch (L4::Runtime_error const &e) {
+    luaL_error(l, "could not create process: %s (%s: %d)", e.str(), e.extra_str(), e.err_no());
+  }
+
+  return launch;
+}
 
+static int exec(lua_State *l)
+{
+  cxx::Ref_ptr<App_launch> launch = create_launch(l);
 
-  am.set_task(app_task.get());
+  launch->execute();
+  if (launch->state() != Ned::Launch::Done)
+    luaL_error(l, "could not create process: %s", launch->error());
 
-  app_task->running();
+  push_handle(l)->task = launch->task();
+  return 1;
+}
 
-  am.launch_loader();
+/**
+ * Like exec() but the program is loaded and started by a launcher thread.
+ *
+ * The launch waits for the launches of the handles in the `depends` table
+ * of the configuration. The returned handle waits for the launch to finish
+ * when it is used.
+ */
+static int exec_async(lua_State *l)
+{
+  cxx::Ref_ptr<App_launch> launch = create_launch(l);
 
-  App_ptr *at = new (lua_newuserdata(l, sizeof(App_ptr))) App_ptr();
-  *at = app_task;
+  lua_getfield(l, 1, "depends");
+  if (lua_istable(l, -1))
+    {
+      int tab = lua_gettop(l);
+      unsigned n = lua_rawlen(l, tab);
+      auto deps = cxx::make_unique<cxx::Ref_ptr<Ned::Launch>[]>(n);
+
+      for (unsigned i = 0; i < n; ++i)
+        {
+          lua_rawgeti(l, tab, i + 1);
+          App_handle &h = check_handle(l, lua_gettop(l));
+          // a handle without a launch belongs to a started program
+          if (h.launch)
+            deps[i] = h.launch;
+          lua_pop(l, 1);
+        }
+
+      launch->depends_on(cxx::move(deps), n);
+    }
+  lua_pop(l, 1);
 
-  luaL_newmetatable(l, APP_TASK_TYPE);
-  lua_setmetatable(l, -2);
+  Ned::launcher.queue(launch);
 
+  push_handle(l)->launch = launch;
   return 1;
-  } catch (L4::Runtime_error const &e) {
-    luaL_error(l, "could not create process: %s (%s: %d)", e.str(), e.extra_str(), e.err_no());
-  }
+}
 
+static int launch_threads(lua_State *l)
+{
+  Ned::launcher.max_threads(luaL_checkinteger(l, 1));
   return 0;
 }
+
 #if 0
 void do_some_exc_tests()
 {
@@ -530,6 +761,8 @@ public:
     static const luaL_Reg _ops[] =
     {
       { "exec", exec },
+      { "exec_async", exec_async },
+      { "launch_threads", launch_threads },
       { NULL, NULL }
     };
     Lua::lua_require_module(l, "L4");
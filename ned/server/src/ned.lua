@@ -50,6 +50,7 @@ Ldr_flags = {
   eager_map    = 0x1, -- L4RE_AUX_LDR_FLAG_EAGER_MAP
   all_segs_cow = 0x2, -- L4RE_AUX_LDR_FLAG_ALL_SEGS_COW
   pinned_segs  = 0x4, -- L4RE_AUX_LDR_FLAG_PINNED_SEGS
+  prefault     = 0x8, -- L4RE_AUX_LDR_FLAG_PREFAULT
 }
 
 -- Flags for dataspace allocation via user_factory
@@ -223,19 +224,29 @@ function App_env:log()
   return self.loader.log_fab:create(Proto.Log, table.unpack(self.log_args));
 end
 
-function App_env:start(...)
-  Class.check(self, App_env);
-
+local function app_start(self, ex, ...)
   local function fa(a)
     return string.gsub(a, ".*/", "");
   end
   local old_log_tag = self.log_args[1];
   self.log_args[1] = self.log_args[1] or fa(...);
-  local res = exec(self, ...);
+  local res = ex(self, ...);
   self.log_args[1] = old_log_tag;
   return res;
 end
 
+function App_env:start(...)
+  Class.check(self, App_env);
+  return app_start(self, exec, ...);
+end
+
+-- Like start() but the program is loaded by a launcher thread. The returned
+-- handle waits for the launch to finish when it is used.
+function App_env:start_async(...)
+  Class.check(self, App_env);
+  return app_start(self, exec_async, ...);
+end
+
 function App_env:set_ns(tmpl)
   Class.check(self, App_env);
   self.ns = Namespace.new(tmpl, self.ns_fab);
@@ -253,9 +264,7 @@ function App_env:set_mem_alloc(mem)
   self.mem = mem;
 end
 
-function Loader:startv(env, ...)
-  Class.check(self, Loader);
-
+local function loader_env(self, env)
   local caps = env.caps or {};
 
   if (type(caps) == "table") then
@@ -271,8 +280,19 @@ function Loader:startv(env, ...)
   env.loader = self;
   env.caps = caps;
   env.l4re_dbg = env.l4re_dbg or Dbg.Warn;
-  local e = App_env.new(env);
-  return e:start(...);
+  return App_env.new(env);
+end
+
+function Loader:startv(env, ...)
+  Class.check(self, Loader);
+  return loader_env(self, env):start(...);
+end
+
+-- Start a program in parallel to other programs started this way. The
+-- program is started after all programs in env.depends have been started.
+function Loader:startv_async(env, ...)
+  Class.check(self, Loader);
+  return loader_env(self, env):start_async(...);
 end
 
 -- Create a new IPC gate for a client-server connection
@@ -296,6 +316,11 @@ function Loader:start(env, cmd, posix_env)
   return self:startv(env, self.split_args(cmd, posix_env));
 end
 
+function Loader:start_async(env, cmd, posix_env)
+  Class.check(self, Loader);
+  return self:startv_async(env, self.split_args(cmd, posix_env));
+end
+
 default_loader = Loader.new({factory = Env.factory, mem = Env.mem_alloc});
 
 return _ENV
@@ -16,6 +16,98 @@
 
 Mem_man Mem_man::_ram;
 
+/**
+ * Get the order of the largest naturally aligned block within `r`.
+ *
+ * \return The order, or 0 if `r` does not contain a whole page.
+ */
+unsigned long
+Mem_man::max_order(Region const &r)
+{
+  for (unsigned long o = sizeof(unsigned long) * 8 - 1; o >= L4_PAGESHIFT; --o)
+    {
+      unsigned long mask = (1UL << o) - 1;
+      unsigned long a = (r.start() + mask) & ~mask;
+      // wrap-around?
+      if (a < r.start())
+        continue;
+
+      if (a + mask >= a && a + mask <= r.end())
+        return o;
+    }
+
+  return 0;
+}
+
+void
+Mem_man::index(Region const &r)
+{
+  if (r.owner())
+    return;
+
+  unsigned long o = max_order(r);
+  if (!o)
+    return;
+
+  // No morecore() here, it changes the tree we are in the middle of
+  // updating. reserve_index() provides the memory beforehand and
+  // alloc_first() falls back to a linear search for unindexed regions.
+  if (_free.insert(Free_block(o, r.start())).second == -_free.E_nomem
+      && debug_errors)
+    L4::cout << PROG_NAME": Out of memory, free region " << r
+             << " not indexed\n";
+}
+
+void
+Mem_man::reserve_index()
+{
+  enum { Reserve = 4 };
+  Free_tree::Node_allocator a;
+  while (a.free_objects() < Reserve
+         && Page_alloc_base::allocator()->avail() < L4_PAGESIZE)
+    if (!ram()->morecore())
+      return;
+}
+
+void
+Mem_man::unindex(Region const &r)
+{
+  if (!r.owner())
+    _free.remove(Free_block(max_order(r), r.start()));
+}
+
+int
+Mem_man::insert(Region const &r)
+{
+  auto res = _tree.insert(r);
+  if (res.second == 0)
+    index(*res.first);
+  return res.second;
+}
+
+int
+Mem_man::remove(Region const &r)
+{
+  unindex(r);
+  return _tree.remove(r);
+}
+
+void
+Mem_man::start(Region const *r, unsigned long start)
+{
+  unindex(*r);
+  r->start(start);
+  index(*r);
+}
+
+void
+Mem_man::end(Region const *r, unsigned long end)
+{
+  unindex(*r);
+  r->end(end);
+  index(*r);
+}
+
 Region const *
 Mem_man::find(Region const &r, bool force) const
 {
@@ -45,7 +137,7 @@ Mem_man::add(Region const &r)
       if (n && n->owner() == r.owner())
 	{
 	  r.start(n->start());
-	  int err = _tree.remove(*n);
+	  int err = remove(*n);
 	  if (err < 0)
 	    { L4::cout << "err=" << err << " dump:\n"; dump();  enter_kdebug("BUG");}
 	}
@@ -61,7 +153,7 @@ Mem_man::add(Region const &r)
       if (n && n->owner() == r.owner())
 	{
 	  r.end(n->end());
-	  int err = _tree.remove(*n);
+	  int err = remove(*n);
 	  if (err < 0)
 	    { L4::cout << "err=" << err << " dump:\n"; dump();  enter_kdebug("BUG");}
 	}
@@ -71,7 +163,7 @@ Mem_man::add(Region const &r)
   if (r.owner() == sigma0_taskno)
     return true;
 
-  while (_tree.insert(r).second == -_tree.E_nomem)
+  while (insert(r) == -_tree.E_nomem)
     if (!ram()->morecore())
       {
 	if (debug_errors)
@@ -88,6 +180,8 @@ Mem_man::add_free(Region const &r)
   if (!r.valid())
     return true;
 
+  reserve_index();
+
   // calculate the combined set of all overlapping regions within the tree
   while (1)
     {
@@ -101,7 +195,7 @@ Mem_man::add_free(Region const &r)
       if (n->end() > r.end())
 	r.end(n->end());
 
-      int err = _tree.remove(*n);
+      int err = remove(*n);
       if (err < 0)
 	{ L4::cout << "err=" << err << " dump:\n"; dump();  enter_kdebug("BUG");}
     }
@@ -122,7 +216,7 @@ Mem_man::alloc_from(Region const *r2, Region const &_r)
   if (r == *r2)
     {
       // L4::cout << "dump " << r << " " << *r2 << "\n"; dump();
-      int err = _tree.remove(*r2);
+      int err = remove(*r2);
       if (err < 0)
 	{ L4::cout << "err=" << err << " dump:\n"; dump(); enter_kdebug("BUG"); }
       return add(r);
@@ -130,7 +224,7 @@ Mem_man::alloc_from(Region const *r2, Region const &_r)
 
   if (r.start() == r2->start())
     {
-      r2->start(r.end()+1);
+      start(r2, r.end()+1);
       //L4::cout << "move start to " << *r2 << '\n';
       add(r);
       return true;
@@ -138,14 +232,14 @@ Mem_man::alloc_from(Region const *r2, Region const &_r)
 
   if (r.end() == r2->end())
     {
-      r2->end(r.start()-1);
+      end(r2, r.start()-1);
       //L4::cout << "shrink end to " << *r2 << '\n';
       add(r);
       return true;
     }
 
   Region const nr(r.end()+1, r2->end(),r2->owner());
-  r2->end(r.start()-1);
+  end(r2, r.start()-1);
   //L4::cout << "split to " << *r2 << "; " << nr << '\n';
   if (r.valid())
     add(r);
@@ -160,6 +254,8 @@ Mem_man::alloc(Region const &r, bool force)
 {
   if (!r.valid())
     return ~0UL;
+
+  reserve_index();
   Region const *r2 = find(r, force);
   if (!r2)
     return ~0UL;
@@ -177,6 +273,7 @@ Mem_man::reserve(Region const &r)
   if (!r.valid())
     return false;
 
+  reserve_index();
   Region const *r2 = find(r, true);
   if (!r2)
     return true;
@@ -223,12 +320,10 @@ Mem_man::morecore()
   return true;
 }
 
-unsigned long
-Mem_man::alloc_first(unsigned long size, unsigned owner)
+Region const *
+Mem_man::find_first(unsigned long size) const
 {
-  Tree::Item_type *n = 0;
-
-  for (Tree::Iterator i = _tree.begin(); i != _tree.end(); ++i)
+  for (Tree::Const_iterator i = _tree.begin(); i != _tree.end(); ++i)
     {
       if (i->owner())
 	continue;
@@ -241,12 +336,49 @@ Mem_man::alloc_first(unsigned long size, unsigned owner)
       //L4::cout << "test: " << (void*)st << " - " << i->end() << '\n';
 
       if (st < i->end() && i->end() - st >= size - 1)
-        {
-          n = &(*i);
-          break;
-        }
+        return &(*i);
     }
 
+  return 0;
+}
+
+unsigned long
+Mem_man::alloc_first(unsigned long size, unsigned owner)
+{
+  unsigned long order = L4_PAGESHIFT;
+  while (order < sizeof(unsigned long) * 8 && (1UL << order) < size)
+    ++order;
+
+  if (order >= sizeof(unsigned long) * 8)
+    return ~0UL;
+
+  size = 1UL << order;
+  reserve_index();
+
+  // Take the free region with the smallest largest block that still fits,
+  // this keeps the regions that can provide larger superpages intact.
+  Region const *n = 0;
+  for (;;)
+    {
+      Free_tree::Node b = _free.lower_bound_node(Free_block(order, 0));
+      if (!b.valid())
+        break;
+
+      n = find(Region(b->start, b->start));
+      if (n && !n->owner() && n->start() == b->start
+          && max_order(*n) == b->order)
+        break;
+
+      // stale entry, cannot happen unless indexing ran out of memory
+      Free_block stale = *b;
+      _free.remove(stale);
+      n = 0;
+    }
+
+  // regions that could not be indexed for lack of memory
+  if (!n)
+    n = find_first(size);
+
   if (!n)
     return ~0UL;
 
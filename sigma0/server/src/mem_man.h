@@ -23,11 +23,42 @@ private:
 
   static Mem_man _ram;
 
+  /**
+   * Index entry for a free region.
+   *
+   * Free regions are additionally sorted by the largest naturally aligned
+   * block they contain, so that a free block of a given size, e.g. a
+   * superpage, is found in O(log n).
+   */
+  struct Free_block
+  {
+    unsigned long order;
+    unsigned long start;
+
+    Free_block() : order(0), start(0) {}
+    Free_block(unsigned long order, unsigned long start)
+    : order(order), start(start) {}
+
+    bool operator < (Free_block const &o) const
+    { return order < o.order || (order == o.order && start < o.start); }
+  };
+
 public:
   typedef cxx::Avl_set< Region, cxx::Lt_functor<Region>, Slab_alloc> Tree;
+  typedef cxx::Avl_set< Free_block, cxx::Lt_functor<Free_block>, Slab_alloc> Free_tree;
 
 private:
   Tree _tree;
+  Free_tree _free;
+
+  static unsigned long max_order(Region const &r);
+  void reserve_index();
+  void index(Region const &r);
+  void unindex(Region const &r);
+  int insert(Region const &r);
+  int remove(Region const &r);
+  void start(Region const *r, unsigned long start);
+  void end(Region const *r, unsigned long end);
 
 public:
   static Mem_man *ram() { return &_ram; }
@@ -39,6 +70,7 @@ public:
   Region const *find(Region const &r, bool force = false) const;
 
   bool morecore();
+  Region const *find_first(unsigned long size) const;
   unsigned long alloc_first(unsigned long size, unsigned owner = 2);
 
   void dump();
@@ -86,6 +86,32 @@ void map_tbuf(Answer *a)
     }
 }
 
+static
+void map_free_pages(unsigned size, unsigned long num, l4_umword_t t,
+                    Answer *a)
+{
+  enum { Max_items = L4_UTCB_GENERIC_DATA_SIZE / 2 };
+
+  if (size < L4_LOG2_PAGESIZE)
+    size = L4_LOG2_PAGESIZE;
+
+  if (num > Max_items)
+    num = Max_items;
+
+  a->tag = l4_msgtag(0, 0, 0, 0);
+  for (; num; --num)
+    {
+      unsigned long addr = Mem_man::ram()->alloc_first(1UL << size, t);
+      if (addr == ~0UL)
+        break;
+
+      a->add_snd_fpage(addr, size, L4_FPAGE_RWX, true);
+    }
+
+  if (!l4_msgtag_items(a->tag))
+    a->error(L4_ENOMEM);
+}
+
 static
 void map_free_page(unsigned size, l4_umword_t t, Answer *a)
 {
@@ -225,6 +251,10 @@ void handle_sigma0_request(l4_umword_t t, l4_utcb_t *utcb, Answer *answer)
     case SIGMA0_REQ_ID_FPAGE_ANY:
       map_free_page(l4_fpage_size(*(l4_fpage_t*)(&l4_utcb_mr_u(utcb)->mr[1])), t, answer);
       break;
+    case SIGMA0_REQ_ID_FPAGE_ANY_MULTI:
+      map_free_pages(l4_fpage_size(*(l4_fpage_t*)(&l4_utcb_mr_u(utcb)->mr[1])),
+                     l4_utcb_mr_u(utcb)->mr[2], t, answer);
+      break;
     case SIGMA0_REQ_ID_NEW_CLIENT:
       new_client(t, answer);
       break;
@@ -54,6 +54,33 @@ public:
     tag = l4_msgtag(0, 0, 1, 0);
   }
 
+  /**
+   * Append a map item to the answer.
+   *
+   * All items of the answer are received in the same receive buffer.
+   *
+   * \retval true   The item was added.
+   * \retval false  There is no space left for another item.
+   */
+  bool add_snd_fpage(unsigned long addr, unsigned size, unsigned access,
+                     bool cache)
+  {
+    unsigned n = l4_msgtag_items(tag);
+    if ((n + 1) * 2 > L4_UTCB_GENERIC_DATA_SIZE)
+      return false;
+
+    l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+    if (n)
+      m->mr[n * 2 - 2] |= L4_ITEM_CONT;
+
+    m->mr[n * 2] = (addr & (~0UL << 10)) | L4_ITEM_MAP
+                   | (cache ? L4_fpage_cached : L4_fpage_uncached);
+    m->mr[n * 2 + 1] = l4_fpage(addr, size, access).raw;
+
+    tag = l4_msgtag(0, 0, n + 1, 0);
+    return true;
+  }
+
   bool failed() const
   { return tag.label() < 0; }
 
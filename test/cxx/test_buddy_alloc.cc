@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Unit tests for the buddy allocator.
+ */
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <l4/cxx/buddy_alloc>
+#include <l4/cxx/list_alloc>
+#include <l4/re/env.h>
+#include <l4/sys/kip.h>
+
+#include <l4/atkins/tap/main>
+
+enum
+{
+  Min_order = 12,
+  Max_order = 20,
+  Pool_size = 4UL << Max_order,
+};
+
+typedef cxx::Buddy_alloc<Min_order, Max_order> Test_buddy;
+
+static char pool[Pool_size] __attribute__((aligned(1UL << Max_order)));
+
+struct TestBuddyAlloc : public ::testing::Test
+{
+  Test_buddy ba;
+
+  static unsigned long blk(unsigned long n) { return n << Min_order; }
+  static unsigned long addr(void *p) { return (unsigned long)p; }
+};
+
+/**
+ * An empty allocator has no memory available and fails all allocations.
+ *
+ * \see cxx::Buddy_alloc.alloc, cxx::Buddy_alloc.avail
+ */
+TEST_F(TestBuddyAlloc, Empty)
+{
+  EXPECT_EQ(0UL, ba.avail());
+  EXPECT_EQ(nullptr, ba.alloc(blk(1), 0));
+}
+
+/**
+ * Initial memory is trimmed to the minimum block size and split into
+ * naturally aligned blocks.
+ *
+ * \see cxx::Buddy_alloc.free
+ */
+TEST_F(TestBuddyAlloc, InitialFree)
+{
+  ba.free(pool + 17, Pool_size - 17, true);
+
+  EXPECT_EQ(Pool_size - blk(1), ba.avail());
+  EXPECT_EQ(3UL, ba.free_blocks(Max_order));
+  for (unsigned o = Min_order; o < Max_order; ++o)
+    EXPECT_EQ(1UL, ba.free_blocks(o)) << "order " << o;
+}
+
+/**
+ * Freeing all allocated blocks coalesces the memory back into blocks of
+ * the maximum order.
+ *
+ * \see cxx::Buddy_alloc.alloc, cxx::Buddy_alloc.free
+ */
+TEST_F(TestBuddyAlloc, AllocFreeCoalesce)
+{
+  ba.free(pool, Pool_size, true);
+
+  std::vector<void *> blocks;
+  while (void *p = ba.alloc(blk(1), 0))
+    blocks.push_back(p);
+
+  EXPECT_EQ(Pool_size / blk(1), blocks.size());
+  EXPECT_EQ(0UL, ba.avail());
+
+  for (void *p : blocks)
+    ba.free(p, blk(1));
+
+  EXPECT_EQ((unsigned long)Pool_size, ba.avail());
+  EXPECT_EQ(4UL, ba.free_blocks(Max_order));
+}
+
+/**
+ * Allocations are aligned to the requested alignment, the unused tail of
+ * a block is returned to the allocator.
+ *
+ * \see cxx::Buddy_alloc.alloc
+ */
+TEST_F(TestBuddyAlloc, Alignment)
+{
+  ba.free(pool, Pool_size, true);
+
+  void *p = ba.alloc(blk(1), 0);
+  ASSERT_NE(nullptr, p);
+
+  void *q = ba.alloc(blk(3), 1UL << 18);
+  ASSERT_NE(nullptr, q);
+  EXPECT_EQ(0UL, addr(q) & ((1UL << 18) - 1));
+  EXPECT_EQ(Pool_size - blk(4), ba.avail());
+
+  void *r = ba.alloc(blk(5), 0);
+  ASSERT_NE(nullptr, r);
+  EXPECT_EQ(0UL, addr(r) & (blk(4) - 1));
+
+  ba.free(q, blk(3));
+  ba.free(p, blk(1));
+  ba.free(r, blk(5));
+  EXPECT_EQ((unsigned long)Pool_size, ba.avail());
+  EXPECT_EQ(4UL, ba.free_blocks(Max_order));
+}
+
+/**
+ * alloc_max() returns the largest free block not exceeding the maximum and
+ * fails if no block of at least the minimum size is free.
+ *
+ * \see cxx::Buddy_alloc.alloc_max
+ */
+TEST_F(TestBuddyAlloc, AllocMax)
+{
+  ba.free(pool, 1UL << Max_order, true);
+
+  unsigned long max = Pool_size;
+  void *p = ba.alloc_max(blk(1), &max, blk(1), blk(1));
+  ASSERT_NE(nullptr, p);
+  EXPECT_EQ(1UL << Max_order, max);
+
+  max = Pool_size;
+  EXPECT_EQ(nullptr, ba.alloc_max(blk(1), &max, blk(1), blk(1)));
+
+  ba.free(p, 1UL << Max_order);
+  max = blk(3);
+  p = ba.alloc_max(blk(1), &max, blk(1), blk(1));
+  ASSERT_NE(nullptr, p);
+  EXPECT_EQ(blk(3), max);
+  EXPECT_EQ((1UL << Max_order) - blk(3), ba.avail());
+}
+
+/**
+ * Allocations that are not a power of two succeed from a run of adjacent
+ * free blocks if no block of the next power of two is free.
+ *
+ * \see cxx::Buddy_alloc.alloc, cxx::Buddy_alloc.alloc_max
+ */
+TEST_F(TestBuddyAlloc, AllocRun)
+{
+  // blocks of one and two pages that are not buddies of each other
+  ba.free(pool + blk(1), blk(3), true);
+  EXPECT_EQ(1UL, ba.free_blocks(Min_order));
+  EXPECT_EQ(1UL, ba.free_blocks(Min_order + 1));
+
+  void *p = ba.alloc(blk(3), 0);
+  EXPECT_EQ(pool + blk(1), p);
+  EXPECT_EQ(0UL, ba.avail());
+  ba.free(p, blk(3));
+
+  unsigned long max = Pool_size;
+  p = ba.alloc_max(blk(3), &max, blk(1), blk(1));
+  EXPECT_EQ(pool + blk(1), p);
+  EXPECT_EQ(blk(3), max);
+  ba.free(p, max);
+
+  // the run is not aligned to four pages
+  EXPECT_EQ(nullptr, ba.alloc(blk(3), blk(4)));
+  EXPECT_EQ(blk(3), ba.avail());
+}
+
+/**
+ * Allocations larger than the largest block are carved from a run of
+ * blocks of the maximum order.
+ *
+ * \see cxx::Buddy_alloc.alloc, cxx::Buddy_alloc.alloc_max
+ */
+TEST_F(TestBuddyAlloc, AllocRunLarge)
+{
+  unsigned long const size = 3UL << Max_order;
+  ba.free(pool + (1UL << Max_order), size, true);
+
+  void *p = ba.alloc(size, 0);
+  EXPECT_EQ(pool + (1UL << Max_order), p);
+  EXPECT_EQ(0UL, ba.avail());
+  ba.free(p, size);
+
+  unsigned long max = Pool_size;
+  p = ba.alloc_max(size, &max, blk(1), blk(1));
+  EXPECT_EQ(pool + (1UL << Max_order), p);
+  EXPECT_EQ(size, max);
+  ba.free(p, max);
+
+  EXPECT_EQ(size, ba.avail());
+  EXPECT_EQ(3UL, ba.free_blocks(Max_order));
+}
+
+/**
+ * Under random fragmentation the available memory is accounted correctly and
+ * the allocator fully coalesces once all blocks are freed.
+ *
+ * \see cxx::Buddy_alloc.alloc, cxx::Buddy_alloc.free
+ */
+TEST_F(TestBuddyAlloc, Fragmentation)
+{
+  ba.free(pool, Pool_size, true);
+
+  struct Alloc { void *p; unsigned long size; };
+  std::vector<Alloc> live;
+
+  srand(42);
+  for (unsigned i = 0; i < 10000; ++i)
+    {
+      if (live.empty() || rand() % 3)
+        {
+          unsigned long s = blk(rand() % 8 + 1);
+          if (void *p = ba.alloc(s, 0))
+            live.push_back(Alloc{p, s});
+        }
+      else
+        {
+          unsigned idx = rand() % live.size();
+          ba.free(live[idx].p, live[idx].size);
+          live[idx] = live.back();
+          live.pop_back();
+        }
+    }
+
+  unsigned long used = 0;
+  for (auto const &a : live)
+    used += a.size;
+
+  EXPECT_EQ(Pool_size - used, ba.avail());
+
+  for (auto const &a : live)
+    ba.free(a.p, a.size);
+
+  EXPECT_EQ((unsigned long)Pool_size, ba.avail());
+  EXPECT_EQ(4UL, ba.free_blocks(Max_order));
+}
+
+enum { Bench_rounds = 100000 };
+
+/**
+ * Fragment the pool into single free pages and measure how long it takes
+ * to free a random allocated page and allocate a new one.
+ */
+template <typename ALLOC>
+static void
+bench(char const *name)
+{
+  ALLOC a;
+  a.free(pool, Pool_size, true);
+
+  unsigned const num = Pool_size >> Min_order;
+  std::vector<void *> live;
+  for (unsigned i = 0; i < num; ++i)
+    live.push_back(a.alloc(1UL << Min_order, 0));
+
+  // free every other page, no two free pages are adjacent afterwards
+  std::vector<void *> used;
+  for (unsigned i = 0; i < num; ++i)
+    if (i & 1)
+      a.free(live[i], 1UL << Min_order);
+    else
+      used.push_back(live[i]);
+
+  srand(1);
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (unsigned r = 0; r < Bench_rounds; ++r)
+    {
+      unsigned idx = rand() % used.size();
+      a.free(used[idx], 1UL << Min_order);
+      used[idx] = a.alloc(1UL << Min_order, 0);
+    }
+  l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+  printf("%s: %u free pages, %u rounds, kclks: %lld => %lld ns per round\n",
+         name, num / 2, Bench_rounds, diff, diff * 1000 / Bench_rounds);
+}
+
+/**
+ * Compare the time for page allocation and release in a fragmented pool
+ * for the list and the buddy allocator.
+ *
+ * The test only reports the numbers.
+ */
+TEST(BuddyAllocBench, Fragmented)
+{
+  bench<cxx::List_alloc>("list");
+  bench<Test_buddy>("buddy");
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for the timeout queues of the IPC server loop.
+ */
+#include <l4/cxx/ipc_timeout_queue>
+#include <l4/sys/kip.h>
+#include <l4/re/env.h>
+
+#include <l4/atkins/tap/main>
+
+#include <cstdio>
+#include <cstdlib>
+
+struct Test_timeout : L4::Ipc_svr::Timeout
+{
+  l4_kernel_clock_t expired_at = 0;
+  static l4_kernel_clock_t now;
+
+  void expired() override
+  { expired_at = now; }
+};
+
+l4_kernel_clock_t Test_timeout::now;
+
+template <typename QUEUE>
+struct TimeoutQueue : public testing::Test
+{
+  QUEUE q;
+
+  void advance(l4_kernel_clock_t now)
+  {
+    Test_timeout::now = now;
+    q.handle_expired_timeouts(now);
+  }
+};
+
+typedef testing::Types<L4::Ipc_svr::Timeout_queue,
+                       L4::Ipc_svr::Timeout_wheel> QueueTypes;
+
+TYPED_TEST_CASE(TimeoutQueue, QueueTypes);
+
+/**
+ * next_timeout() returns the earliest queued time, timeouts expire not
+ * before their time and all of them once their time has passed.
+ *
+ * \see L4::Ipc_svr::Timeout_queue::next_timeout
+ */
+TYPED_TEST(TimeoutQueue, NextAndExpire)
+{
+  l4_kernel_clock_t const times[] = { 5000, 70, 1000000, 70, 64, 4096 };
+  Test_timeout t[6];
+
+  EXPECT_EQ(0U, this->q.next_timeout());
+  for (unsigned i = 0; i < 6; ++i)
+    this->q.add(&t[i], times[i]);
+
+  EXPECT_EQ(64U, this->q.next_timeout());
+  EXPECT_FALSE(this->q.timeout_expired(63));
+  EXPECT_TRUE(this->q.timeout_expired(64));
+
+  this->advance(69);
+  EXPECT_EQ(69U, t[4].expired_at);
+  EXPECT_EQ(0U, t[1].expired_at);
+  EXPECT_EQ(70U, this->q.next_timeout());
+
+  this->advance(4999);
+  EXPECT_EQ(4999U, t[1].expired_at);
+  EXPECT_EQ(4999U, t[3].expired_at);
+  EXPECT_EQ(4999U, t[5].expired_at);
+  EXPECT_EQ(5000U, this->q.next_timeout());
+
+  this->advance(2000000);
+  EXPECT_EQ(2000000U, t[0].expired_at);
+  EXPECT_EQ(2000000U, t[2].expired_at);
+  EXPECT_EQ(0U, this->q.next_timeout());
+}
+
+/**
+ * A removed timeout does not expire, and a timeout in the past is due at
+ * once.
+ *
+ * \see L4::Ipc_svr::Timeout_queue::remove
+ */
+TYPED_TEST(TimeoutQueue, RemoveAndPast)
+{
+  Test_timeout a, b, c;
+
+  this->advance(10000);
+  this->q.add(&a, 20000);
+  this->q.add(&b, 15000);
+  this->q.remove(&b);
+  this->q.remove(&b);
+  EXPECT_EQ(20000U, this->q.next_timeout());
+
+  this->q.add(&c, 5000);
+  EXPECT_EQ(5000U, this->q.next_timeout());
+  EXPECT_TRUE(this->q.timeout_expired(10000));
+
+  this->advance(10001);
+  EXPECT_EQ(10001U, c.expired_at);
+  EXPECT_EQ(0U, b.expired_at);
+  EXPECT_EQ(20000U, this->q.next_timeout());
+
+  this->advance(30000);
+  EXPECT_EQ(30000U, a.expired_at);
+  EXPECT_EQ(0U, b.expired_at);
+}
+
+/**
+ * A timeout that is destroyed while queued never expires.
+ */
+TYPED_TEST(TimeoutQueue, DestroyedTimeout)
+{
+  Test_timeout a;
+  {
+    Test_timeout b;
+    this->q.add(&b, 100);
+    this->q.add(&a, 200);
+  }
+
+  this->advance(150);
+  EXPECT_EQ(0U, a.expired_at);
+  EXPECT_EQ(200U, this->q.next_timeout());
+
+  this->advance(250);
+  EXPECT_EQ(250U, a.expired_at);
+}
+
+enum { Bench_rounds = 100000 };
+
+template <typename QUEUE>
+static void
+bench(char const *name, unsigned num)
+{
+  Test_timeout *t = new Test_timeout[num];
+  QUEUE q;
+  l4_kernel_clock_t now = 1000000;
+  Test_timeout::now = now;
+  srand(1);
+
+  // fill in descending order, which is cheap for the sorted list as well
+  for (unsigned i = 0; i < num; ++i)
+    q.add(&t[i], now + 1000 + (num - i) * (10000000ULL / num));
+
+  // the list takes O(n) per add, keep its run time bounded
+  unsigned rounds = Bench_rounds;
+  if (num > 1000)
+    rounds /= num / 1000;
+
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (unsigned r = 0; r < rounds; ++r)
+    {
+      Test_timeout *x = &t[rand() % num];
+      q.remove(x);
+      q.add(x, now + 1000 + rand() % 10000000);
+      now += 50;
+      Test_timeout::now = now;
+      q.handle_expired_timeouts(now);
+      q.next_timeout();
+    }
+  l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+  printf("%s: %u timeouts, %u rounds, kclks: %lld => %lld ns per round\n",
+         name, num, rounds, diff, diff * 1000 / rounds);
+
+  delete[] t;
+}
+
+/**
+ * Compare the time for re-arming one timeout among many pending ones for
+ * both queue implementations.
+ *
+ * The test only reports the numbers.
+ */
+TEST(TimeoutQueueBench, Rearm)
+{
+  unsigned const sizes[] = { 10, 1000, 100000 };
+  for (unsigned n : sizes)
+    {
+      bench<L4::Ipc_svr::Timeout_queue>("list", n);
+      bench<L4::Ipc_svr::Timeout_wheel>("wheel", n);
+    }
+}
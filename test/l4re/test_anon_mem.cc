@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for anonymous memory mappings of the L4Re VFS.
+ */
+#include <l4/atkins/tap/main>
+
+#include <l4/sys/consts.h>
+
+#include <sys/mman.h>
+#include <cstring>
+
+static char *map_anon(size_t size)
+{
+  void *p = mmap(0, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return p == MAP_FAILED ? 0 : static_cast<char *>(p);
+}
+
+/**
+ * MADV_DONTNEED releases the pages of an anonymous mapping, they read as
+ * zero afterwards. Pages outside the range keep their content.
+ *
+ * \see madvise
+ */
+TEST(AnonMem, MadviseDontneed)
+{
+  size_t const size = 8 * L4_PAGESIZE;
+  char *p = map_anon(size);
+  ASSERT_TRUE(p);
+
+  memset(p, 0x5a, size);
+  ASSERT_EQ(0, madvise(p + L4_PAGESIZE, 2 * L4_PAGESIZE, MADV_DONTNEED));
+
+  EXPECT_EQ(0x5a, p[L4_PAGESIZE - 1]);
+  for (size_t i = L4_PAGESIZE; i < 3 * L4_PAGESIZE; ++i)
+    ASSERT_EQ(0, p[i]);
+  EXPECT_EQ(0x5a, p[3 * L4_PAGESIZE]);
+
+  ASSERT_EQ(0, munmap(p, size));
+}
+
+/**
+ * Mapping and unmapping anonymous memory many times reuses the address
+ * space of the pool dataspaces. Partially unmapped mappings return their
+ * pieces one by one.
+ *
+ * \see mmap, munmap
+ */
+TEST(AnonMem, MapUnmapChurn)
+{
+  size_t const size = 1 << 20;
+
+  // 4 GiB in total, many times the size of a pool
+  for (int i = 0; i < 4096; ++i)
+    {
+      char *p = map_anon(size);
+      ASSERT_TRUE(p) << "round " << i;
+
+      p[0] = 1;
+      p[size - 1] = 1;
+
+      ASSERT_EQ(0, munmap(p + size / 2, L4_PAGESIZE));
+      ASSERT_EQ(0, munmap(p, size / 2));
+      ASSERT_EQ(0, munmap(p + size / 2 + L4_PAGESIZE,
+                          size / 2 - L4_PAGESIZE));
+    }
+
+  // reused memory is clean
+  char *p = map_anon(size);
+  ASSERT_TRUE(p);
+  for (size_t i = 0; i < size; i += L4_PAGESIZE)
+    ASSERT_EQ(0, p[i]);
+  ASSERT_EQ(0, munmap(p, size));
+}
+
+/**
+ * Unmapping every other page of many small mappings leaves more holes in
+ * a pool than a fixed table of free ranges could hold. All of them are
+ * reused and read as zero.
+ *
+ * \see mmap, munmap
+ */
+TEST(AnonMem, FragmentedReuse)
+{
+  enum { Pages = 512 };
+  static char *pages[Pages];
+
+  for (int round = 0; round < 64; ++round)
+    {
+      for (int i = 0; i < Pages; ++i)
+        {
+          pages[i] = map_anon(L4_PAGESIZE);
+          ASSERT_TRUE(pages[i]) << "round " << round << " page " << i;
+          ASSERT_EQ(0, pages[i][0]);
+          pages[i][0] = 1;
+        }
+
+      for (int i = 0; i < Pages; i += 2)
+        ASSERT_EQ(0, munmap(pages[i], L4_PAGESIZE));
+      for (int i = 1; i < Pages; i += 2)
+        ASSERT_EQ(0, munmap(pages[i], L4_PAGESIZE));
+    }
+}
+
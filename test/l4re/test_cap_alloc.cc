@@ -12,9 +12,13 @@
 #include <l4/atkins/tap/main>
 
 #include <l4/sys/types.h>
+#include <l4/sys/kip.h>
+#include <l4/re/env.h>
 #include <l4/re/util/counting_cap_alloc>
 #include <l4/re/util/bitmap_cap_alloc>
 
+#include <pthread.h>
+#include <cstdio>
 #include <cstring>
 
 struct CountingCapAlloc
@@ -133,3 +137,102 @@ TEST_F(CountingCapAlloc, RespectCapacity)
   ASSERT_TRUE(alloc<void>().is_valid());
   ASSERT_FALSE(alloc<void>().is_valid());
 }
+
+static long grow_by_8(L4Re::Util::Counting_cap_alloc<> *, long capacity)
+{
+  return capacity + 8 <= 128 ? capacity + 8 : capacity;
+}
+
+/**
+ * An allocator with a grow function extends its capacity when all slots
+ * are in use, until the grow function does not provide any more slots.
+ *
+ * \see L4Re::Util::Counting_cap_alloc.setup,
+ *      L4Re::Util::Counting_cap_alloc.alloc
+ */
+TEST_F(CountingCapAlloc, GrowCapacity)
+{
+  setup(&cap_storage, 8, 1000, grow_by_8);
+
+  for (int i = 0; i < 128; ++i)
+    ASSERT_TRUE(alloc<void>().is_valid());
+
+  ASSERT_EQ(1000 + 127, last());
+  ASSERT_FALSE(alloc<void>().is_valid());
+}
+
+namespace {
+
+enum { Mt_threads = 4, Mt_rounds = 1 << 14 };
+
+struct Mt_args
+{
+  L4Re::Util::Counting_cap_alloc<> *ca;
+  long bias;
+  unsigned char used[128];
+  bool failed;
+};
+
+void *mt_alloc_thread(void *arg)
+{
+  Mt_args *a = static_cast<Mt_args *>(arg);
+
+  for (int i = 0; i < Mt_rounds; ++i)
+    {
+      L4::Cap<void> cap = a->ca->alloc<void>();
+      if (!cap.is_valid())
+        {
+          __atomic_store_n(&a->failed, true, __ATOMIC_RELAXED);
+          break;
+        }
+
+      long c = (cap.cap() >> L4_CAP_SHIFT) - a->bias;
+      if (__atomic_exchange_n(&a->used[c], 1, __ATOMIC_RELAXED))
+        __atomic_store_n(&a->failed, true, __ATOMIC_RELAXED);
+
+      __atomic_store_n(&a->used[c], 0, __ATOMIC_RELAXED);
+      a->ca->free(cap);
+    }
+
+  return 0;
+}
+
+}
+
+/**
+ * Several threads allocating and freeing capabilities concurrently never
+ * get the same capability slot at the same time.
+ *
+ * The test also reports the time per alloc/free pair under contention.
+ *
+ * \see L4Re::Util::Counting_cap_alloc.alloc
+ *      L4Re::Util::Counting_cap_alloc.free
+ */
+TEST_F(CountingCapAlloc, ConcurrentAllocFree)
+{
+  setup(&cap_storage, 128, 1000);
+
+  Mt_args args;
+  memset(&args, 0, sizeof(args));
+  args.ca = this;
+  args.bias = 1000;
+
+  pthread_t t[Mt_threads];
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (auto &th : t)
+    ASSERT_EQ(0, pthread_create(&th, NULL, mt_alloc_thread, &args));
+  for (auto &th : t)
+    ASSERT_EQ(0, pthread_join(th, NULL));
+  l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+  ASSERT_FALSE(args.failed);
+
+  fprintf(stderr, "%d threads, %d rounds each, kclks: %lld => %lld ns\n",
+          Mt_threads, Mt_rounds, diff,
+          diff * 1000 / (Mt_threads * Mt_rounds));
+
+  // all slots have been returned
+  for (int i = 0; i < 128; ++i)
+    ASSERT_TRUE(alloc<void>().is_valid());
+  ASSERT_FALSE(alloc<void>().is_valid());
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for the file descriptor table of the L4Re VFS.
+ */
+#include <l4/atkins/tap/main>
+
+#include <l4/sys/kip.h>
+#include <l4/re/env.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <cstdio>
+
+enum { Many_fds = 1000 };
+
+/**
+ * More descriptors than the former fixed table size can be open at the
+ * same time, and closed descriptors are reused lowest first.
+ *
+ * \see dup, close
+ */
+TEST(FdTable, ManyDescriptors)
+{
+  static int fds[Many_fds];
+
+  for (int &fd : fds)
+    {
+      fd = dup(1);
+      ASSERT_LE(0, fd);
+    }
+
+  int low = fds[10];
+  int high = fds[Many_fds - 10];
+  ASSERT_EQ(0, close(high));
+  ASSERT_EQ(0, close(low));
+
+  ASSERT_EQ(low, dup(1));
+  ASSERT_EQ(high, dup(1));
+
+  for (int fd : fds)
+    ASSERT_EQ(0, close(fd));
+}
+
+/**
+ * dup2() can target descriptors far beyond the currently used range and
+ * rejects descriptors beyond the table limit.
+ *
+ * \see dup2
+ */
+TEST(FdTable, Dup2HighDescriptor)
+{
+  ASSERT_EQ(20000, dup2(1, 20000));
+
+  struct stat st;
+  ASSERT_EQ(0, fstat(20000, &st));
+  ASSERT_EQ(0, close(20000));
+  ASSERT_EQ(-1, fstat(20000, &st));
+  ASSERT_EQ(EBADF, errno);
+
+  ASSERT_EQ(-1, dup2(1, 1 << 30));
+  ASSERT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, dup2(1, -1));
+  ASSERT_EQ(EBADF, errno);
+}
+
+enum { Mt_threads = 4, Mt_rounds = 100000 };
+
+struct Mt_args
+{
+  int fd;
+  bool failed;
+};
+
+static void *fstat_thread(void *a)
+{
+  Mt_args *args = static_cast<Mt_args *>(a);
+  struct stat st;
+
+  for (int i = 0; i < Mt_rounds; ++i)
+    if (fstat(args->fd, &st) < 0)
+      args->failed = true;
+
+  return 0;
+}
+
+/**
+ * Run the descriptor lookup from several threads at once while another
+ * descriptor is opened and closed repeatedly.
+ *
+ * The test reports the time per lookup for different numbers of threads.
+ *
+ * \see fstat, dup, close
+ */
+TEST(FdTable, ConcurrentLookup)
+{
+  Mt_args args[Mt_threads];
+  for (auto &a : args)
+    {
+      a.fd = dup(1);
+      a.failed = false;
+      ASSERT_LE(0, a.fd);
+    }
+
+  for (int n = 1; n <= Mt_threads; n *= 2)
+    {
+      pthread_t t[Mt_threads];
+      l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+      for (int i = 0; i < n; ++i)
+        ASSERT_EQ(0, pthread_create(&t[i], NULL, fstat_thread, &args[i]));
+
+      for (int i = 0; i < 1000; ++i)
+        {
+          int fd = dup(1);
+          ASSERT_LE(0, fd);
+          ASSERT_EQ(0, close(fd));
+        }
+
+      for (int i = 0; i < n; ++i)
+        ASSERT_EQ(0, pthread_join(t[i], NULL));
+      l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+      fprintf(stderr, "%d threads, %d lookups each, kclks: %lld => %lld ns\n",
+              n, Mt_rounds, diff, diff * 1000 / (n * Mt_rounds));
+    }
+
+  for (auto &a : args)
+    {
+      ASSERT_FALSE(a.failed);
+      ASSERT_EQ(0, close(a.fd));
+    }
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for the cache of namespace lookups of the L4Re VFS.
+ *
+ * A namespace served by the test is mounted into the file system and
+ * changed behind the back of the cache, so that the tests can tell cached
+ * from fresh results.
+ */
+#include <l4/atkins/fixtures/epiface_provider>
+#include <l4/atkins/tap/main>
+
+#include <l4/l4re_vfs/backend>
+#include <l4/l4re_vfs/impl/ns_fs.h>
+
+#include <cstdio>
+#include <unistd.h>
+
+#include "namespace_impl.h"
+
+typedef L4Re::Core::Ns_cache Ns_cache;
+
+struct NsCache : Atkins::Fixture::Server_thread
+{
+  NsCache() { server.set_rcv_cap_flags(0); }
+
+  virtual void SetUp()
+  {
+    L4Re::chkcap(server.registry()->register_obj(&handler));
+    start_loop();
+    handler.registry = server.registry();
+
+    // the same capability slot may be used by the namespace of every test
+    static int mounts;
+    snprintf(dir, sizeof(dir), "/nscache%d", ++mounts);
+    auto factory =
+      L4Re::Vfs::vfs_ops->get_file_factory(L4Re::Namespace::Protocol);
+    ASSERT_TRUE(factory);
+    ASSERT_EQ(0, L4Re::Vfs::vfs_ops->mount(dir, factory->create(scap())));
+  }
+
+  L4::Cap<Name_space::Interface> scap() const
+  { return handler.obj_cap(); }
+
+  char const *path(char const *name)
+  {
+    snprintf(path_buf, sizeof(path_buf), "%s/%s", dir, name);
+    return path_buf;
+  }
+
+  bool exists(char const *name)
+  { return access(path(name), F_OK) == 0; }
+
+  Name_space handler;
+  char dir[32];
+  char path_buf[64];
+};
+
+/**
+ * A name that did not exist is reported as missing until the negative
+ * cache entry expires, then the name registered in the meantime is found.
+ *
+ * \see access
+ */
+TEST_F(NsCache, NegativeEntryExpires)
+{
+  EXPECT_FALSE(exists("late"));
+  ASSERT_EQ(L4_EOK, scap()->register_obj("late", scap()));
+  EXPECT_FALSE(exists("late"));
+
+  usleep(Ns_cache::Neg_timeout_us + 100000);
+  EXPECT_TRUE(exists("late"));
+}
+
+/**
+ * Removing a name through the file system drops its cache entry.
+ *
+ * \see unlink, access
+ */
+TEST_F(NsCache, UnlinkInvalidates)
+{
+  ASSERT_EQ(L4_EOK, scap()->register_obj("gone", scap()));
+  EXPECT_TRUE(exists("gone"));
+
+  EXPECT_EQ(0, unlink(path("gone")));
+  EXPECT_FALSE(exists("gone"));
+}
+
+/**
+ * A full cache replaces the least recently used entry.
+ *
+ * Both names are removed from the namespace directly, so only their cache
+ * entries keep them visible.
+ *
+ * \see access
+ */
+TEST_F(NsCache, LruEviction)
+{
+  ASSERT_EQ(L4_EOK, scap()->register_obj("old", scap()));
+  ASSERT_EQ(L4_EOK, scap()->register_obj("recent", scap()));
+  EXPECT_TRUE(exists("old"));
+  EXPECT_TRUE(exists("recent"));
+
+  ASSERT_EQ(L4_EOK, scap()->unlink("old"));
+  ASSERT_EQ(L4_EOK, scap()->unlink("recent"));
+  EXPECT_TRUE(exists("recent"));
+
+  // fill all entries but the one of the most recently used name
+  for (int i = 0; i < Ns_cache::Num_entries - 1; ++i)
+    {
+      char name[16];
+      snprintf(name, sizeof(name), "miss%d", i);
+      EXPECT_FALSE(exists(name));
+    }
+
+  EXPECT_TRUE(exists("recent"));
+  EXPECT_FALSE(exists("old"));
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for select, poll and epoll of the L4Re VFS.
+ */
+#include <l4/atkins/tap/main>
+
+#include <l4/l4re_vfs/backend>
+#include <l4/re/env.h>
+#include <l4/sys/irq>
+#include <l4/sys/kip.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+
+enum
+{
+  Wait_ms = 50,
+  /// Timeout for waits that are expected to be woken up.
+  Long_wait_ms = 5000,
+};
+
+/**
+ * File whose readiness is controlled by the test.
+ */
+class Test_file : public L4Re::Vfs::Be_file
+{
+public:
+  Test_file()
+  : _ready(0), _notifier(L4::Cap<L4::Triggerable>::Invalid),
+    _m(PTHREAD_MUTEX_INITIALIZER)
+  {}
+
+  int check_ready(int events) throw()
+  { return events & __atomic_load_n(&_ready, __ATOMIC_ACQUIRE); }
+
+  int set_ready_notifier(L4::Cap<L4::Triggerable> irq) throw()
+  {
+    pthread_mutex_lock(&_m);
+    _notifier = irq;
+    pthread_mutex_unlock(&_m);
+    return 0;
+  }
+
+  void set_ready(int events)
+  {
+    __atomic_store_n(&_ready, events, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&_m);
+    if (_notifier.is_valid())
+      _notifier->trigger();
+    pthread_mutex_unlock(&_m);
+  }
+
+private:
+  int _ready;
+  L4::Cap<L4::Triggerable> _notifier;
+  pthread_mutex_t _m;
+};
+
+static int open_test_file(cxx::Ref_ptr<Test_file> *f)
+{
+  *f = cxx::Ref_ptr<Test_file>(new Test_file());
+  return L4Re::Vfs::vfs_ops->alloc_fd(*f);
+}
+
+static l4_cpu_time_t now_us()
+{ return l4_kip_clock(l4re_kip()); }
+
+/**
+ * The vcon of the program is always writable. It has no pending input and
+ * poll() waits for input until the timeout expires.
+ *
+ * \see poll
+ */
+TEST(Poll, VconReadiness)
+{
+  struct pollfd fds[2] = { { 0, POLLIN, 0 }, { 1, POLLOUT, 0 } };
+  ASSERT_EQ(1, poll(fds, 2, 0));
+  EXPECT_EQ(0, fds[0].revents);
+  EXPECT_EQ(POLLOUT, fds[1].revents);
+
+  l4_cpu_time_t start = now_us();
+  ASSERT_EQ(0, poll(fds, 1, Wait_ms));
+  EXPECT_LE(start + Wait_ms * 1000, now_us());
+}
+
+/**
+ * poll, select and epoll_wait return after their timeout if no file gets
+ * ready, a zero timeout does not block.
+ *
+ * \see poll, select, epoll_wait
+ */
+TEST(Poll, Timeout)
+{
+  cxx::Ref_ptr<Test_file> f;
+  int fd = open_test_file(&f);
+  ASSERT_LE(0, fd);
+
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  ASSERT_EQ(0, poll(&pfd, 1, 0));
+
+  l4_cpu_time_t start = now_us();
+  ASSERT_EQ(0, poll(&pfd, 1, Wait_ms));
+  EXPECT_LE(start + Wait_ms * 1000, now_us());
+
+  fd_set rfds;
+  FD_ZERO(&rfds);
+  FD_SET(fd, &rfds);
+  struct timeval tv = { 0, Wait_ms * 1000 };
+  start = now_us();
+  ASSERT_EQ(0, select(fd + 1, &rfds, NULL, NULL, &tv));
+  EXPECT_LE(start + Wait_ms * 1000, now_us());
+  EXPECT_FALSE(FD_ISSET(fd, &rfds));
+
+  int ep = epoll_create1(0);
+  ASSERT_LE(0, ep);
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ASSERT_EQ(0, epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev));
+  ASSERT_EQ(0, epoll_wait(ep, &ev, 1, 0));
+  start = now_us();
+  ASSERT_EQ(0, epoll_wait(ep, &ev, 1, Wait_ms));
+  EXPECT_LE(start + Wait_ms * 1000, now_us());
+
+  // a file getting ready ends the wait early
+  f->set_ready(POLLIN);
+  ASSERT_EQ(1, poll(&pfd, 1, Long_wait_ms));
+  EXPECT_EQ(POLLIN, pfd.revents);
+
+  ASSERT_EQ(0, close(ep));
+  ASSERT_EQ(0, close(fd));
+}
+
+/**
+ * select() fails with EBADF for descriptors that are not open.
+ *
+ * \see select
+ */
+TEST(Poll, SelectBadFd)
+{
+  int fd = dup(1);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(0, close(fd));
+
+  fd_set rfds;
+  FD_ZERO(&rfds);
+  FD_SET(fd, &rfds);
+  struct timeval tv = { 0, 0 };
+  ASSERT_EQ(-1, select(fd + 1, &rfds, NULL, NULL, &tv));
+  EXPECT_EQ(EBADF, errno);
+
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  ASSERT_EQ(1, poll(&pfd, 1, 0));
+  EXPECT_EQ(POLLNVAL, pfd.revents);
+}
+
+struct Wait_args
+{
+  int fd;
+  int result;
+  struct epoll_event ev;
+};
+
+static void *poll_thread(void *a)
+{
+  Wait_args *args = static_cast<Wait_args *>(a);
+  struct pollfd pfd = { args->fd, POLLIN, 0 };
+  args->result = poll(&pfd, 1, Long_wait_ms);
+  return 0;
+}
+
+static void *epoll_thread(void *a)
+{
+  Wait_args *args = static_cast<Wait_args *>(a);
+  args->result = epoll_wait(args->fd, &args->ev, 1, Long_wait_ms);
+  return 0;
+}
+
+/**
+ * A poll() and an epoll_wait() waiting for the same file in different
+ * threads are both woken up when the file gets ready.
+ *
+ * \see poll, epoll_wait
+ */
+TEST(Poll, PollAndEpollSameFile)
+{
+  cxx::Ref_ptr<Test_file> f;
+  int fd = open_test_file(&f);
+  ASSERT_LE(0, fd);
+
+  int ep = epoll_create1(0);
+  ASSERT_LE(0, ep);
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  ASSERT_EQ(0, epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev));
+
+  Wait_args p = { fd, -1, {} };
+  Wait_args e = { ep, -1, {} };
+  pthread_t pt, et;
+  ASSERT_EQ(0, pthread_create(&pt, NULL, poll_thread, &p));
+  ASSERT_EQ(0, pthread_create(&et, NULL, epoll_thread, &e));
+
+  // let both threads block before the file gets ready
+  usleep(Wait_ms * 1000);
+  l4_cpu_time_t start = now_us();
+  f->set_ready(POLLIN);
+
+  ASSERT_EQ(0, pthread_join(pt, NULL));
+  ASSERT_EQ(0, pthread_join(et, NULL));
+  EXPECT_GT(start + Long_wait_ms * 1000, now_us());
+  EXPECT_EQ(1, p.result);
+  EXPECT_EQ(1, e.result);
+  EXPECT_EQ(fd, e.ev.data.fd);
+
+  ASSERT_EQ(0, close(ep));
+  ASSERT_EQ(0, close(fd));
+}
+
+/**
+ * A file added to an epoll instance while a thread waits on it is taken
+ * into account by that waiter.
+ *
+ * \see epoll_ctl, epoll_wait
+ */
+TEST(Poll, EpollAddWhileWaiting)
+{
+  cxx::Ref_ptr<Test_file> f;
+  int fd = open_test_file(&f);
+  ASSERT_LE(0, fd);
+
+  int ep = epoll_create1(0);
+  ASSERT_LE(0, ep);
+
+  Wait_args e = { ep, -1, {} };
+  pthread_t et;
+  ASSERT_EQ(0, pthread_create(&et, NULL, epoll_thread, &e));
+  usleep(Wait_ms * 1000);
+
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  ASSERT_EQ(0, epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev));
+
+  // the new file gets ready only after it was added
+  usleep(Wait_ms * 1000);
+  l4_cpu_time_t start = now_us();
+  f->set_ready(POLLIN);
+
+  ASSERT_EQ(0, pthread_join(et, NULL));
+  EXPECT_GT(start + Long_wait_ms * 1000, now_us());
+  EXPECT_EQ(1, e.result);
+  EXPECT_EQ(fd, e.ev.data.fd);
+  EXPECT_TRUE(e.ev.events & EPOLLIN);
+
+  ASSERT_EQ(0, close(ep));
+  ASSERT_EQ(0, close(fd));
+}
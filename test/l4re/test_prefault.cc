@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for regions attached with fault-around.
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+#include <l4/re/util/unique_cap>
+#include <l4/sys/kip.h>
+
+#include <l4/atkins/tap/main>
+
+#include <cstdio>
+#include <cstdlib>
+
+static L4Re::Env const * const env = L4Re::Env::env();
+
+enum { Ds_size = 16 << 20, Pages = Ds_size / L4_PAGESIZE };
+
+struct Prefault : testing::Test
+{
+  Prefault()
+  {
+    ds = L4Re::chkcap(L4Re::Util::make_unique_del_cap<L4Re::Dataspace>());
+    L4Re::chksys(env->mem_alloc()->alloc(Ds_size, ds.get()));
+    L4Re::chksys(env->rm()->attach(&plain, Ds_size, L4Re::Rm::Search_addr,
+                                   L4::Ipc::make_cap_rw(ds.get()), 0));
+  }
+
+  /// Attach the data space again, with or without fault-around.
+  void attach(L4Re::Rm::Unique_region<char *> *r, bool prefault)
+  {
+    unsigned long flags = L4Re::Rm::Search_addr;
+    if (prefault)
+      flags |= L4Re::Rm::Prefault;
+
+    L4Re::chksys(env->rm()->attach(r, Ds_size, flags,
+                                   L4::Ipc::make_cap_rw(ds.get()), 0));
+  }
+
+  L4Re::Util::Unique_del_cap<L4Re::Dataspace> ds;
+  L4Re::Rm::Unique_region<char *> plain;
+};
+
+/**
+ * Sequential and random reads through a region with fault-around see the
+ * content of the data space, writes go to the data space.
+ *
+ * \see L4Re::Rm::Prefault
+ */
+TEST_F(Prefault, Content)
+{
+  for (unsigned i = 0; i < Pages; ++i)
+    plain.get()[i * L4_PAGESIZE] = i & 0xff;
+
+  L4Re::Rm::Unique_region<char *> r;
+  attach(&r, true);
+
+  srand(1);
+  for (unsigned i = 0; i < 256; ++i)
+    {
+      unsigned p = rand() % Pages;
+      ASSERT_EQ((char)(p & 0xff), r.get()[p * L4_PAGESIZE]) << "page " << p;
+    }
+
+  for (unsigned i = 0; i < Pages; ++i)
+    ASSERT_EQ((char)(i & 0xff), r.get()[i * L4_PAGESIZE]) << "page " << i;
+
+  for (unsigned i = 0; i < Pages; ++i)
+    r.get()[i * L4_PAGESIZE + 1] = 0x5a;
+  for (unsigned i = 0; i < Pages; ++i)
+    ASSERT_EQ(0x5a, plain.get()[i * L4_PAGESIZE + 1]) << "page " << i;
+}
+
+static l4_cpu_time_t
+scan(char const *p)
+{
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  int sum = 0;
+  for (unsigned i = 0; i < Pages; ++i)
+    sum += p[i * L4_PAGESIZE];
+  asm volatile ("" : : "r" (sum));
+  return l4_kip_clock(l4re_kip()) - start;
+}
+
+/**
+ * Compare a sequential scan over a fresh region with and without
+ * fault-around.
+ *
+ * The test only reports the numbers.
+ */
+TEST_F(Prefault, ScanBench)
+{
+  L4Re::Rm::Unique_region<char *> a, b;
+  attach(&a, false);
+  attach(&b, true);
+
+  l4_cpu_time_t plain_time = scan(a.get());
+  l4_cpu_time_t prefault_time = scan(b.get());
+
+  printf("%d pages: per page %lld ns without, %lld ns with fault-around\n",
+         Pages, plain_time * 1000 / Pages, prefault_time * 1000 / Pages);
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for the free space search of the generic region map.
+ */
+#include <l4/re/util/region_mapping>
+#include <l4/sys/kip.h>
+#include <l4/re/env.h>
+
+#include <l4/atkins/tap/main>
+
+#include <cstdio>
+#include <cstdlib>
+
+struct Test_ops
+{
+  typedef int Map_result;
+
+  template< typename H >
+  static void free(H const *, l4_addr_t, unsigned long) {}
+};
+
+typedef L4Re::Util::Region_handler<unsigned long, Test_ops> Test_handler;
+
+struct Test_rm : L4Re::Util::Region_map<Test_handler, cxx::New_allocator>
+{
+  typedef L4Re::Util::Region_map<Test_handler, cxx::New_allocator> Base;
+
+  // lower half of the address space, the end is inclusive and page aligned
+  Test_rm() : Base(0x10000, (~0UL >> 1) | (L4_PAGESIZE - 1)) {}
+
+  l4_addr_t attach_at(l4_addr_t addr, unsigned long size)
+  {
+    void *a = attach((void *)addr, size, Test_handler(1, 0));
+    return a == L4_INVALID_PTR ? L4_INVALID_ADDR : (l4_addr_t)a;
+  }
+
+  l4_addr_t search(unsigned long size, unsigned char align = L4_PAGESHIFT,
+                   l4_addr_t start = 0)
+  {
+    void *a = attach((void *)start, size, Test_handler(1, 0), Search, align);
+    return a == L4_INVALID_PTR ? L4_INVALID_ADDR : (l4_addr_t)a;
+  }
+
+  int detach(l4_addr_t addr, unsigned long size)
+  { return Base::detach((void *)addr, size, 0, 0, 0); }
+
+  /// The former linear search, as a reference.
+  l4_addr_t ref_find(unsigned long size, unsigned char align)
+  {
+    for (l4_addr_t a = l4_round_size(min_addr(), align);
+         a + size - 1 <= max_addr(); a += 1UL << align)
+      if (!find(L4Re::Util::Region(a, a + size - 1))
+          && !area_find(L4Re::Util::Region(a, a + size - 1)))
+        return a;
+    return L4_INVALID_ADDR;
+  }
+};
+
+enum { Pg = L4_PAGESIZE };
+
+/**
+ * A search returns the lowest hole that is large enough, also if it lies
+ * behind smaller holes, and honors the alignment.
+ *
+ * \see L4Re::Util::Region_map::find_free
+ */
+TEST(RegionMap, FirstFit)
+{
+  Test_rm rm;
+
+  for (unsigned i = 0; i < 64; ++i)
+    ASSERT_EQ(0x10000 + i * 4 * Pg, rm.attach_at(0x10000 + i * 4 * Pg, Pg));
+
+  // holes of 3 pages between all regions, one hole of 7 pages
+  ASSERT_LE(0, rm.detach(0x10000 + 40 * 4 * Pg, Pg));
+
+  EXPECT_EQ(0x10000 + 1 * Pg, rm.search(3 * Pg));
+  EXPECT_EQ(0x10000 + 40 * 4 * Pg - 3 * Pg, rm.search(7 * Pg));
+  EXPECT_EQ(0x10000 + 4 * Pg + Pg, rm.search(3 * Pg));
+  EXPECT_EQ(0x10000 + 8 * Pg + Pg, rm.search(2 * Pg));
+
+  // all remaining holes are off by one page against an alignment of four
+  // pages
+  EXPECT_EQ(0x10000 + 64 * 4 * Pg, rm.search(Pg, L4_PAGESHIFT + 2, 0x20000));
+}
+
+/**
+ * Holes inside of areas are skipped unless the search is done within the
+ * area.
+ *
+ * \see L4Re::Util::Region_map::attach_area
+ */
+TEST(RegionMap, SkipAreas)
+{
+  Test_rm rm;
+
+  ASSERT_EQ(0x10000UL, rm.attach_at(0x10000, Pg));
+  ASSERT_EQ(0x11000UL, rm.attach_area(0x11000, 0x10000 - Pg));
+  ASSERT_EQ(0x40000UL, rm.attach_area(0x40000, 0x10000));
+
+  EXPECT_EQ(0x20000UL, rm.search(0x1f000));
+  EXPECT_EQ(0x50000UL, rm.search(0x20000));
+
+  void *a = rm.attach((void *)0x11000, Pg, Test_handler(1, 0),
+                      Test_rm::Search | Test_rm::In_area);
+  EXPECT_EQ((void *)0x11000, a);
+}
+
+/**
+ * Partially detached regions free their space for later searches.
+ *
+ * \see L4Re::Util::Region_map::detach
+ */
+TEST(RegionMap, PartialDetach)
+{
+  Test_rm rm;
+
+  ASSERT_EQ(0x10000UL, rm.attach_at(0x10000, 16 * Pg));
+  ASSERT_EQ(0x20000UL, rm.search(Pg));
+
+  // split, move the end and move the start of the region
+  ASSERT_LE(0, rm.detach(0x14000, 4 * Pg));
+  EXPECT_EQ(0x14000UL, rm.search(4 * Pg));
+  ASSERT_LE(0, rm.detach(0x1c000, 4 * Pg));
+  EXPECT_EQ(0x1c000UL, rm.search(4 * Pg));
+  ASSERT_LE(0, rm.detach(0x10000, 2 * Pg));
+  EXPECT_EQ(0x10000UL, rm.search(2 * Pg));
+}
+
+/**
+ * Random attach and detach operations give the same results as a linear
+ * search over all addresses.
+ *
+ * \see L4Re::Util::Region_map::find_free
+ */
+TEST(RegionMap, RandomAgainstLinear)
+{
+  Test_rm rm;
+  l4_addr_t addrs[256] = { 0 };
+  unsigned long sizes[256];
+  srand(1);
+
+  for (unsigned i = 0; i < 10000; ++i)
+    {
+      unsigned slot = rand() % 256;
+      if (addrs[slot] && sizes[slot] > Pg && rand() % 2)
+        {
+          // shrink the region by its first page
+          ASSERT_LE(0, rm.detach(addrs[slot], Pg));
+          addrs[slot] += Pg;
+          sizes[slot] -= Pg;
+          continue;
+        }
+
+      if (addrs[slot])
+        {
+          ASSERT_LE(0, rm.detach(addrs[slot], sizes[slot]));
+          addrs[slot] = 0;
+          continue;
+        }
+
+      sizes[slot] = (1 + rand() % 8) * Pg;
+      unsigned char align = L4_PAGESHIFT + rand() % 3;
+      l4_addr_t ref = rm.ref_find(sizes[slot], align);
+      addrs[slot] = rm.search(sizes[slot], align);
+      ASSERT_EQ(ref, addrs[slot]) << "op " << i;
+    }
+}
+
+enum { Bench_regions = 100000 };
+
+/**
+ * Attach and detach many regions at searched addresses.
+ *
+ * The test only reports the time per operation.
+ */
+TEST(RegionMapBench, AttachDetach)
+{
+  Test_rm rm;
+  static l4_addr_t addrs[Bench_regions];
+
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (l4_addr_t &a : addrs)
+    {
+      a = rm.search(Pg);
+      ASSERT_NE(L4_INVALID_ADDR, a);
+    }
+  l4_cpu_time_t attach = l4_kip_clock(l4re_kip()) - start;
+
+  // punch holes from the end of the address space, every search has to
+  // skip all regions in front of the only hole that fits
+  start = l4_kip_clock(l4re_kip());
+  for (unsigned i = Bench_regions; i > 0; i -= 2)
+    {
+      ASSERT_LE(0, rm.detach(addrs[i - 1], Pg));
+      ASSERT_EQ(addrs[i - 1], rm.search(Pg));
+    }
+  l4_cpu_time_t refill = l4_kip_clock(l4re_kip()) - start;
+
+  start = l4_kip_clock(l4re_kip());
+  for (l4_addr_t a : addrs)
+    ASSERT_LE(0, rm.detach(a, Pg));
+  l4_cpu_time_t detach = l4_kip_clock(l4re_kip()) - start;
+
+  printf("%d regions: attach %lld ns, refill %lld ns, detach %lld ns\n",
+         Bench_regions, attach * 1000 / Bench_regions,
+         refill * 2000 / Bench_regions, detach * 1000 / Bench_regions);
+}
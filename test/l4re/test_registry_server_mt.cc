@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/**
+ * Tests for the thread-pool registry server.
+ */
+#include <l4/re/util/registry_server_mt>
+#include <l4/sys/cxx/ipc_epiface>
+#include <l4/sys/kip.h>
+
+#include <l4/atkins/tap/main>
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+struct Test_iface : L4::Kobject_t<Test_iface, L4::Kobject>
+{
+  /// Return the UTCB of the worker that served the call.
+  L4_INLINE_RPC(long, where, (l4_umword_t *utcb));
+  typedef L4::Typeid::Rpcs<where_t> Rpcs;
+};
+
+struct Test_svr : L4::Epiface_t<Test_svr, Test_iface>
+{
+  long op_where(Test_iface::Rights, l4_umword_t &utcb)
+  {
+    utcb = (l4_umword_t)l4_utcb();
+    return 0;
+  }
+};
+
+struct Safe_test_svr : Test_svr, L4Re::Util::Thread_safe_epiface {};
+
+typedef L4Re::Util::Registry_server_mt<> Server;
+
+enum { Max_workers = 4 };
+
+/**
+ * Start a server with `num` workers, whose worker 0 runs on a new thread.
+ */
+static Server *
+start_server(unsigned num)
+{
+  Server *srv = 0;
+  std::thread([&srv, num]()
+    {
+      Server *s = new Server(num);
+      __atomic_store_n(&srv, s, __ATOMIC_RELEASE);
+      s->loop();
+    }).detach();
+
+  while (!__atomic_load_n(&srv, __ATOMIC_ACQUIRE))
+    l4_thread_yield();
+
+  return srv;
+}
+
+static l4_umword_t
+where(L4::Cap<Test_iface> cap)
+{
+  l4_umword_t utcb = 0;
+  EXPECT_EQ(0, cap->where(&utcb));
+  return utcb;
+}
+
+/**
+ * Thread-safe objects are spread over all workers, other objects are served
+ * by worker 0 unless they are pinned to a worker.
+ *
+ * \see L4Re::Util::Registry_server_mt::Registry::register_obj
+ */
+TEST(RegistryServerMt, Placement)
+{
+  Server *srv = start_server(Max_workers);
+  ASSERT_EQ((unsigned)Max_workers, srv->num_workers());
+
+  Test_svr plain[2];
+  Safe_test_svr safe[Max_workers];
+  Test_svr pinned;
+
+  for (Test_svr &o : plain)
+    ASSERT_TRUE(srv->registry()->register_obj(&o).is_valid());
+  for (Safe_test_svr &o : safe)
+    ASSERT_TRUE(srv->registry()->register_obj(&o).is_valid());
+  ASSERT_TRUE(srv->registry()->worker(2)->register_obj(&pinned).is_valid());
+
+  l4_umword_t w0 = where(plain[0].obj_cap());
+  EXPECT_EQ(w0, where(plain[1].obj_cap()));
+
+  l4_umword_t utcbs[Max_workers];
+  for (unsigned i = 0; i < Max_workers; ++i)
+    {
+      utcbs[i] = where(safe[i].obj_cap());
+      for (unsigned j = 0; j < i; ++j)
+        EXPECT_NE(utcbs[j], utcbs[i]) << "objects " << j << " and " << i;
+    }
+
+  EXPECT_EQ(utcbs[2], where(pinned.obj_cap()));
+  EXPECT_NE(w0, utcbs[2]);
+
+  // an object is removed from the worker that serves it
+  srv->registry()->unregister_obj(&safe[1]);
+  EXPECT_FALSE(safe[1].obj_cap().is_valid());
+  EXPECT_EQ(utcbs[3], where(safe[3].obj_cap()));
+
+  for (Safe_test_svr &o : safe)
+    srv->registry()->unregister_obj(&o);
+  for (Test_svr &o : plain)
+    srv->registry()->unregister_obj(&o);
+  srv->registry()->unregister_obj(&pinned);
+}
+
+enum { Bench_calls = 100000 };
+
+static void
+bench(Server *srv, unsigned clients)
+{
+  std::vector<Safe_test_svr> objs(clients);
+  for (Safe_test_svr &o : objs)
+    ASSERT_TRUE(srv->registry()->register_obj(&o).is_valid());
+
+  std::vector<std::thread> threads;
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (Safe_test_svr &o : objs)
+    threads.emplace_back([&o]()
+      {
+        L4::Cap<Test_iface> cap = o.obj_cap();
+        l4_umword_t utcb;
+        for (unsigned i = 0; i < Bench_calls; ++i)
+          cap->where(&utcb);
+      });
+  for (std::thread &t : threads)
+    t.join();
+  l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+  printf("%u workers, %u clients: %lld calls/ms\n", srv->num_workers(),
+         clients, clients * Bench_calls * 1000ULL / (diff ? diff : 1));
+
+  for (Safe_test_svr &o : objs)
+    srv->registry()->unregister_obj(&o);
+}
+
+/**
+ * Compare the call throughput of a server with a single worker and one
+ * with several workers for a growing number of clients.
+ *
+ * The test only reports the numbers.
+ */
+TEST(RegistryServerMtBench, Throughput)
+{
+  Server *single = start_server(1);
+  Server *multi = start_server(Max_workers);
+
+  for (unsigned clients = 1; clients <= Max_workers; clients *= 2)
+    {
+      bench(single, clients);
+      bench(multi, clients);
+    }
+}
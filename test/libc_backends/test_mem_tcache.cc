@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/*
+ * Test the thread-caching malloc backend (libc_be_mem_tcache).
+ */
+
+#include <l4/re/env.h>
+#include <l4/sys/kip.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <l4/atkins/tap/main>
+
+static bool filled_with(void const *p, int c, size_t n)
+{
+  unsigned char const *b = static_cast<unsigned char const *>(p);
+  for (size_t i = 0; i < n; ++i)
+    if (b[i] != c)
+      return false;
+  return true;
+}
+
+/**
+ * Blocks of all size classes and of large sizes are suitably aligned,
+ * distinct and keep their content.
+ */
+TEST(MemTcache, SizesAndAlignment)
+{
+  enum { Num = 200 };
+  static void *p[Num];
+
+  for (unsigned i = 0; i < Num; ++i)
+    {
+      size_t n = (i * i * 37) % (128 << 10) + 1;
+      p[i] = malloc(n);
+      ASSERT_NE(nullptr, p[i]);
+      EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(p[i]) & 15) << n;
+      memset(p[i], i & 0xff, n);
+    }
+
+  for (unsigned i = 0; i < Num; ++i)
+    {
+      size_t n = (i * i * 37) % (128 << 10) + 1;
+      EXPECT_TRUE(filled_with(p[i], i & 0xff, n)) << n;
+      free(p[i]);
+    }
+}
+
+/**
+ * memalign() and posix_memalign() honour alignments up to beyond a page.
+ */
+TEST(MemTcache, Memalign)
+{
+  for (size_t align = 16; align <= (64 << 10); align <<= 1)
+    for (size_t n : { size_t{1}, align - 1, align, 3 * align + 5 })
+      {
+        void *p = memalign(align, n);
+        ASSERT_NE(nullptr, p);
+        EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(p) & (align - 1)) << align;
+        memset(p, 0xaa, n);
+        free(p);
+
+        ASSERT_EQ(0, posix_memalign(&p, align, n));
+        EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(p) & (align - 1)) << align;
+        free(p);
+      }
+
+  void *p;
+  EXPECT_EQ(EINVAL, posix_memalign(&p, 24, 100));
+}
+
+/**
+ * calloc() returns zeroed memory even when it reuses dirty blocks, and
+ * rejects overflowing sizes.
+ */
+TEST(MemTcache, Calloc)
+{
+  for (size_t n : { 24, 300, 4096, 40000, 300000 })
+    {
+      for (unsigned i = 0; i < 64; ++i)
+        {
+          void *d = malloc(n);
+          ASSERT_NE(nullptr, d);
+          memset(d, 0xff, n);
+          free(d);
+
+          void *p = calloc(1, n);
+          ASSERT_NE(nullptr, p);
+          ASSERT_TRUE(filled_with(p, 0, n)) << n;
+          free(p);
+        }
+    }
+
+  EXPECT_EQ(nullptr, calloc(SIZE_MAX / 2, 3));
+}
+
+/**
+ * realloc() keeps the content when moving between size classes and to and
+ * from large allocations.
+ */
+TEST(MemTcache, Realloc)
+{
+  size_t const sizes[] = { 10, 100, 1000, 20000, 200000, 3000, 50, 500000, 8 };
+  char *p = static_cast<char *>(realloc(nullptr, 8));
+  ASSERT_NE(nullptr, p);
+  memset(p, 0x5a, 8);
+
+  size_t prev = 8;
+  for (size_t n : sizes)
+    {
+      p = static_cast<char *>(realloc(p, n));
+      ASSERT_NE(nullptr, p);
+      size_t keep = n < prev ? n : prev;
+      ASSERT_TRUE(filled_with(p, 0x5a, keep)) << prev << " -> " << n;
+      memset(p, 0x5a, n);
+      prev = n;
+    }
+
+  free(p);
+}
+
+enum { Xfer_objs = 20000 };
+static void *xfer[Xfer_objs];
+
+static void *producer(void *)
+{
+  for (unsigned i = 0; i < Xfer_objs; ++i)
+    {
+      size_t n = 16 + (i % 64) * 24;
+      xfer[i] = malloc(n);
+      if (!xfer[i])
+        return nullptr;
+      memset(xfer[i], i & 0xff, n);
+    }
+  return xfer;
+}
+
+static void *consumer(void *)
+{
+  for (unsigned i = 0; i < Xfer_objs; ++i)
+    {
+      size_t n = 16 + (i % 64) * 24;
+      if (!filled_with(xfer[i], i & 0xff, n))
+        return nullptr;
+      free(xfer[i]);
+    }
+  return xfer;
+}
+
+/**
+ * Memory allocated by one thread is freed by another one after the
+ * allocating thread has exited, and is reused afterwards.
+ */
+TEST(MemTcache, CrossThreadFree)
+{
+  for (unsigned round = 0; round < 5; ++round)
+    {
+      pthread_t t;
+      void *ret;
+
+      ASSERT_EQ(0, pthread_create(&t, 0, producer, 0));
+      ASSERT_EQ(0, pthread_join(t, &ret));
+      ASSERT_EQ(xfer, ret);
+
+      ASSERT_EQ(0, pthread_create(&t, 0, consumer, 0));
+      ASSERT_EQ(0, pthread_join(t, &ret));
+      ASSERT_EQ(xfer, ret) << "round " << round;
+    }
+}
+
+/**
+ * malloc_trim() gives back the spans that became completely free.
+ */
+TEST(MemTcache, Trim)
+{
+  enum { Num = 200000 };
+  static void *p[Num];
+
+  for (unsigned i = 0; i < Num; ++i)
+    {
+      p[i] = malloc(64 + (i % 16) * 32);
+      ASSERT_NE(nullptr, p[i]);
+    }
+
+  struct mallinfo full = mallinfo();
+
+  for (unsigned i = 0; i < Num; ++i)
+    free(p[i]);
+
+  malloc_trim(0);
+  struct mallinfo trimmed = mallinfo();
+
+  EXPECT_LT(trimmed.arena, full.arena / 4);
+  EXPECT_EQ(0, trimmed.keepcost);
+}
+
+namespace {
+
+struct Bench_arg
+{
+  unsigned id;
+  unsigned rounds;
+};
+
+}
+
+static void *bench_thread(void *a)
+{
+  Bench_arg *arg = static_cast<Bench_arg *>(a);
+  enum { Live = 256 };
+  void *live[Live] = { nullptr };
+  unsigned seed = arg->id * 7919 + 1;
+
+  for (unsigned i = 0; i < arg->rounds; ++i)
+    {
+      seed = seed * 1103515245 + 12345;
+      unsigned slot = (seed >> 8) % Live;
+      free(live[slot]);
+      live[slot] = malloc(16 + (seed >> 16) % 1024);
+      if (!live[slot])
+        return nullptr;
+    }
+
+  for (void *p : live)
+    free(p);
+
+  return a;
+}
+
+/**
+ * Measure malloc/free pairs of mixed small sizes with several threads and
+ * print the fragmentation report afterwards.
+ *
+ * The test only reports the numbers.
+ */
+TEST(MemTcacheBench, Threads)
+{
+  enum { Rounds = 200000, Max_threads = 8 };
+
+  for (unsigned n = 1; n <= Max_threads; n *= 2)
+    {
+      pthread_t t[Max_threads];
+      Bench_arg args[Max_threads];
+
+      l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+      for (unsigned i = 0; i < n; ++i)
+        {
+          args[i] = Bench_arg{i, Rounds};
+          ASSERT_EQ(0, pthread_create(&t[i], 0, bench_thread, &args[i]));
+        }
+      for (unsigned i = 0; i < n; ++i)
+        {
+          void *ret;
+          ASSERT_EQ(0, pthread_join(t[i], &ret));
+          ASSERT_EQ(&args[i], ret);
+        }
+      l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+      printf("%u threads: %llu ns per malloc+free\n", n,
+             diff * 1000 / (static_cast<unsigned long long>(Rounds) * n));
+    }
+
+  malloc_stats(stdout);
+}
@@ -11,11 +11,15 @@
  */
 
 #include <climits>
+#include <cstdio>
+#include <pthread.h>
 #include <l4/re/env>
 #include <l4/re/util/cap_alloc>
 #include <l4/re/dma_space>
 #include <l4/re/error_helper>
 #include <l4/re/debug>
+#include <l4/sys/kip.h>
+#include <l4/util/util.h>
 
 #include <l4/atkins/l4_assert>
 #include <l4/atkins/tap/main>
@@ -235,3 +239,108 @@ TEST_F(TestMemAlloc, Superpages)
   ASSERT_EQ(0, env->rm()->attach(&start, L4_SUPERPAGESIZE,
                                  L4Re::Rm::Search_addr, ds.get()));
 }
+
+/**
+ * Touch all pages of a fresh on-demand allocated dataspace and return the
+ * time per page fault in nanoseconds.
+ */
+static unsigned long long
+first_touch(unsigned long pages)
+{
+  auto ds = make_unique_del_cap<L4Re::Dataspace>();
+  L4Re::chksys(env->mem_alloc()->alloc(pages * L4_PAGESIZE, ds.get()));
+
+  L4Re::Rm::Unique_region<char *> r;
+  L4Re::chksys(env->rm()->attach(&r, pages * L4_PAGESIZE,
+                                 L4Re::Rm::Search_addr,
+                                 L4::Ipc::make_cap_rw(ds.get())));
+
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (unsigned long i = 0; i < pages; ++i)
+    r.get()[i * L4_PAGESIZE] = 1;
+  l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+  return diff * 1000 / pages;
+}
+
+/**
+ * Measure the first-touch latency of fresh dataspace pages. Small
+ * dataspaces are served from Moe's pool of pre-zeroed pages, large ones
+ * exhaust the pool and are zeroed on the fault.
+ *
+ * The test only reports the numbers.
+ */
+TEST(MemAllocBench, FirstTouch)
+{
+  unsigned long const sizes[] = { 32, 1024 };
+  for (unsigned long pages : sizes)
+    for (unsigned round = 0; round < 3; ++round)
+      {
+        // give Moe's zeroing worker time to refill the pool
+        l4_sleep(20);
+        printf("%lu pages, round %u: %llu ns per first touch\n", pages, round,
+               first_touch(pages));
+      }
+
+#ifndef NDEBUG
+  auto dbg = L4::cap_reinterpret_cast<L4Re::Debug_obj>(env->mem_alloc());
+  dbg->debug(0);
+#endif
+}
+
+enum { Bench_rounds = 2000, Bench_max_threads = 4 };
+
+static void *
+alloc_free_loop(void *arg)
+{
+  L4::Cap<L4Re::Mem_alloc> ma = *static_cast<L4::Cap<L4Re::Mem_alloc> *>(arg);
+  auto ds = make_unique_cap<L4Re::Dataspace>();
+
+  for (unsigned i = 0; i < Bench_rounds; ++i)
+    {
+      if (ma->alloc(L4_PAGESIZE, ds.get()) < 0)
+        return nullptr;
+
+      // drop the only reference, Moe deletes the dataspace
+      env->task()->delete_obj(ds.get());
+    }
+
+  return arg;
+}
+
+/**
+ * Measure dataspace allocation with several client threads, each using its
+ * own memory allocator. With Moe's --server-threads option the allocators
+ * are served by different server threads.
+ *
+ * The test only reports the numbers.
+ */
+TEST(MemAllocBench, ParallelAlloc)
+{
+  for (unsigned n = 1; n <= Bench_max_threads; n *= 2)
+    {
+      L4Re::Util::Unique_del_cap<L4Re::Mem_alloc> ma[Bench_max_threads];
+      L4::Cap<L4Re::Mem_alloc> caps[Bench_max_threads];
+      pthread_t t[Bench_max_threads];
+
+      for (unsigned i = 0; i < n; ++i)
+        {
+          ma[i] = create_ma(64 * L4_PAGESIZE);
+          caps[i] = ma[i].get();
+        }
+
+      l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+      for (unsigned i = 0; i < n; ++i)
+        ASSERT_EQ(0, pthread_create(&t[i], nullptr, alloc_free_loop, &caps[i]));
+      for (unsigned i = 0; i < n; ++i)
+        {
+          void *ret;
+          ASSERT_EQ(0, pthread_join(t[i], &ret));
+          ASSERT_EQ(&caps[i], ret);
+        }
+      l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+      printf("%u threads: %llu ns per dataspace allocation\n", n,
+             diff * 1000 / (static_cast<unsigned long long>(Bench_rounds) * n));
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2.  Please see the COPYING-GPL-2 file for details.
+ */
+
+/*
+ * Test creating many short-lived pthreads, which reuse the resources of
+ * threads freed before.
+ */
+
+#include <l4/re/env.h>
+#include <l4/sys/kip.h>
+#include <l4/sys/thread.h>
+#include <pthread.h>
+#include <cstdio>
+#include <cstring>
+
+#include <l4/atkins/tap/main>
+
+static __thread long tls_value = 42;
+
+static void *check_func(void *arg)
+{
+  // thread-local data starts out fresh
+  if (tls_value != 42)
+    return 0;
+  tls_value = (long)arg;
+
+  // the whole stack is usable
+  char buf[16384];
+  memset(buf, (int)(long)arg, sizeof(buf));
+  asm volatile ("" : : "r" (buf) : "memory");
+
+  return arg;
+}
+
+static void *detached_func(void *arg)
+{
+  __atomic_add_fetch((long *)arg, 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * Threads that are created after others were joined start with fresh
+ * thread-local data and get distinct IDs while they are alive.
+ */
+TEST(PthreadCreate, JoinAndRecreate)
+{
+  for (long i = 1; i <= 1000; ++i)
+    {
+      pthread_t t[4];
+      for (long j = 0; j < 4; ++j)
+        ASSERT_EQ(0, pthread_create(&t[j], 0, check_func, (void *)(i * 4 + j)));
+
+      for (long j = 0; j < 4; ++j)
+        {
+          for (long k = 0; k < j; ++k)
+            EXPECT_NE(t[k], t[j]);
+
+          void *ret;
+          ASSERT_EQ(0, pthread_join(t[j], &ret));
+          ASSERT_EQ(i * 4 + j, (long)ret) << "round " << i;
+        }
+    }
+}
+
+/**
+ * Threads with different stack sizes never get a stack of the wrong size.
+ */
+TEST(PthreadCreate, MixedStackSizes)
+{
+  size_t const sizes[] = { 32 << 10, 64 << 10, 128 << 10 };
+
+  for (long i = 0; i < 300; ++i)
+    {
+      pthread_attr_t attr;
+      ASSERT_EQ(0, pthread_attr_init(&attr));
+      ASSERT_EQ(0, pthread_attr_setstacksize(&attr, sizes[i % 3]));
+
+      pthread_t t;
+      void *ret;
+      ASSERT_EQ(0, pthread_create(&t, &attr, check_func, (void *)(i + 1)));
+      ASSERT_EQ(0, pthread_join(t, &ret));
+      ASSERT_EQ(i + 1, (long)ret);
+      ASSERT_EQ(0, pthread_attr_destroy(&attr));
+    }
+}
+
+/**
+ * Detached threads give back their resources when they exit.
+ */
+TEST(PthreadCreate, Detached)
+{
+  pthread_attr_t attr;
+  ASSERT_EQ(0, pthread_attr_init(&attr));
+  ASSERT_EQ(0, pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED));
+
+  long done = 0;
+  for (long i = 0; i < 1000; ++i)
+    {
+      pthread_t t;
+      ASSERT_EQ(0, pthread_create(&t, &attr, detached_func, &done));
+      while (__atomic_load_n(&done, __ATOMIC_ACQUIRE) <= i)
+        l4_thread_yield();
+    }
+
+  ASSERT_EQ(0, pthread_attr_destroy(&attr));
+}
+
+static void *empty_func(void *)
+{ return 0; }
+
+/**
+ * Measure the time for creating and joining a thread.
+ *
+ * The test only reports the numbers.
+ */
+TEST(PthreadCreateBench, CreateJoin)
+{
+  enum { Rounds = 10000 };
+
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (unsigned i = 0; i < Rounds; ++i)
+    {
+      pthread_t t;
+      ASSERT_EQ(0, pthread_create(&t, 0, empty_func, 0));
+      ASSERT_EQ(0, pthread_join(t, 0));
+    }
+  l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+  printf("create+join: %llu ns per thread\n", diff * 1000 / Rounds);
+}
@@ -17,6 +17,7 @@
 #include <pthread-l4.h>
 #include <sys/time.h>
 #include <cerrno>
+#include <cstdio>
 
 #include <l4/atkins/tap/main>
 
@@ -356,3 +357,143 @@ TEST(Pthread, CondvarTimed)
   ASSERT_EQ(0, pthread_mutex_destroy(&_mtx));
   ASSERT_EQ(0, pthread_cond_destroy(&_cv));
 }
+
+enum { Contention_threads = 4, Contention_iter = 1 << 15 };
+
+struct contention_t
+{
+  pthread_mutex_t m;
+  long cnt;
+  bool timed;
+};
+
+static void *contention_thread(void *arg)
+{
+  contention_t *c = static_cast<contention_t *>(arg);
+  timespec far = { 0x7fffffff, 0 };
+
+  for (int i = 0; i < Contention_iter; ++i)
+    {
+      if (c->timed && (i & 1))
+        {
+          if (pthread_mutex_timedlock(&c->m, &far))
+            return 0;
+        }
+      else if (pthread_mutex_lock(&c->m))
+        return 0;
+      ++c->cnt;
+      if (pthread_mutex_unlock(&c->m))
+        return 0;
+    }
+
+  return (void *)1;
+}
+
+/**
+ * Run Contention_threads threads that increment a counter under the mutex
+ * `c` and return the time it took in microseconds.
+ */
+static l4_cpu_time_t run_contention(contention_t *c)
+{
+  pthread_t t[Contention_threads];
+
+  c->cnt = 0;
+  l4_cpu_time_t start = l4_kip_clock(l4re_kip());
+  for (pthread_t &th : t)
+    EXPECT_EQ(0, pthread_create(&th, NULL, contention_thread, c));
+  for (pthread_t &th : t)
+    {
+      void *ret;
+      EXPECT_EQ(0, pthread_join(th, &ret));
+      EXPECT_EQ((void *)1, ret);
+    }
+  l4_cpu_time_t diff = l4_kip_clock(l4re_kip()) - start;
+
+  EXPECT_EQ((long)Contention_threads * Contention_iter, c->cnt);
+  return diff;
+}
+
+class MutexContention : public ::testing::TestWithParam<int> {};
+
+/**
+ * A mutex of any type stays exclusive when several threads contend for it,
+ * including when the waiters are handed the lock while still spinning.
+ */
+TEST_P(MutexContention, Exclusive)
+{
+  contention_t c;
+  pthread_mutexattr_t a;
+
+  ASSERT_EQ(0, pthread_mutexattr_init(&a));
+  ASSERT_EQ(0, pthread_mutexattr_settype(&a, GetParam()));
+  ASSERT_EQ(0, pthread_mutex_init(&c.m, &a));
+  c.timed = false;
+  run_contention(&c);
+  c.timed = true;
+  run_contention(&c);
+
+  ASSERT_EQ(0, pthread_mutex_destroy(&c.m));
+  ASSERT_EQ(0, pthread_mutexattr_destroy(&a));
+}
+
+static INSTANTIATE_TEST_CASE_P(MutexTypes, MutexContention,
+                               ::testing::Values(PTHREAD_MUTEX_NORMAL,
+                                                 PTHREAD_MUTEX_RECURSIVE,
+                                                 PTHREAD_MUTEX_ERRORCHECK,
+                                                 PTHREAD_MUTEX_ADAPTIVE_NP));
+
+/**
+ * The lock profiler counts every acquisition of a mutex, and only while it
+ * is enabled.
+ */
+TEST(Pthread, MutexProfile)
+{
+  contention_t c;
+  pthread_l4_lock_stats st;
+
+  ASSERT_EQ(0, pthread_mutex_init(&c.m, NULL));
+  c.timed = false;
+
+  int was_enabled = pthread_l4_lock_profile(1);
+  pthread_l4_lock_profile_reset();
+  EXPECT_EQ(ENOENT, pthread_l4_mutex_stats(&c.m, &st));
+
+  run_contention(&c);
+  pthread_l4_lock_profile(was_enabled);
+
+  ASSERT_EQ(0, pthread_l4_mutex_stats(&c.m, &st));
+  EXPECT_EQ((unsigned long)Contention_threads * Contention_iter, st.acquires);
+  EXPECT_LE(st.slept, st.contended);
+  EXPECT_LE(st.contended, st.acquires);
+  EXPECT_LE(st.max_wait_us, st.wait_us);
+
+  // disabled profiling records nothing
+  if (!was_enabled)
+    {
+      ASSERT_EQ(0, pthread_mutex_lock(&c.m));
+      ASSERT_EQ(0, pthread_mutex_unlock(&c.m));
+      pthread_l4_lock_stats st2;
+      ASSERT_EQ(0, pthread_l4_mutex_stats(&c.m, &st2));
+      EXPECT_EQ(st.acquires, st2.acquires);
+    }
+
+  pthread_l4_lock_profile_report();
+  ASSERT_EQ(0, pthread_mutex_destroy(&c.m));
+}
+
+/**
+ * Measure the throughput of a contended mutex.
+ *
+ * The test only reports the numbers.
+ */
+TEST(PthreadBench, MutexContention)
+{
+  contention_t c;
+
+  ASSERT_EQ(0, pthread_mutex_init(&c.m, NULL));
+  c.timed = false;
+  l4_cpu_time_t diff = run_contention(&c);
+  printf("%d threads: %llu ns per lock/unlock\n", Contention_threads,
+         diff * 1000 / ((unsigned long long)Contention_threads * Contention_iter));
+  ASSERT_EQ(0, pthread_mutex_destroy(&c.m));
+}
@@ -9,6 +9,16 @@ enum
   PTHREAD_L4_ATTR_NO_START = 0x0001,
 };
 
+/* Contention statistics of one lock, see pthread_l4_lock_profile(). */
+struct pthread_l4_lock_stats
+{
+  unsigned long acquires;        /* Number of times the lock was taken */
+  unsigned long contended;       /* ... while another thread held it */
+  unsigned long slept;           /* ... and the thread had to block */
+  unsigned long long wait_us;    /* Total wait time of contended acquires */
+  unsigned long long max_wait_us;/* Longest wait time */
+};
+
 __BEGIN_DECLS
 
 l4_cap_idx_t pthread_l4_cap(pthread_t t);
@@ -19,6 +29,23 @@ static inline l4_utcb_t *pthread_l4_utcb(pthread_t t);
 
 int pthread_l4_start(pthread_t thread, void *(*func)(void *), void *arg);
 
+/* Lock contention profiling.  Enable (`enable` != 0) or disable recording
+   of lock statistics, returns whether recording was enabled before.
+   Setting PTHREAD_L4_LOCK_PROFILE in the environment enables recording at
+   startup and prints a report to stderr at exit. */
+int pthread_l4_lock_profile(int enable);
+
+/* Reset all recorded lock statistics. */
+void pthread_l4_lock_profile_reset(void);
+
+/* Print the recorded statistics of the most contended locks to stderr. */
+void pthread_l4_lock_profile_report(void);
+
+/* Get the recorded statistics of `mutex`, returns ENOENT if there are
+   none. */
+int pthread_l4_mutex_stats(pthread_mutex_t *mutex,
+                           struct pthread_l4_lock_stats *stats);
+
 /* Old-named version of pthread_l4_cap(), obsolete. */
 static inline l4_cap_idx_t pthread_getl4cap(pthread_t t)
    L4_DEPRECATED("pthread_getl4cap() has been renamed to pthread_l4_cap()");
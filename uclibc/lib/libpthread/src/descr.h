@@ -124,6 +124,7 @@ struct pthread
                                 /* Double chaining of active threads */
   pthread_descr p_nextwaiting;  /* Next element in the queue holding the thr */
   pthread_descr p_nextlock;	/* can be on a queue and waiting on a lock */
+  long p_lockwake;		/* hand-off state while waiting on a lock */
   pthread_t p_tid;              /* Thread identifier */
 
   int p_priority;               /* Thread priority (== 0 if not realtime) */
@@ -152,6 +152,16 @@ extern __volatile__ int __pthread_threads_debug;
 /* Flag which tells whether we are executing on SMP kernel. */
 extern int __pthread_smp_kernel;
 
+/* Lock contention profiling (lockprof.c).  The lock functions only call
+   into the profiler while __pthread_lock_profiling is set. */
+extern int __pthread_lock_profiling attribute_hidden;
+extern unsigned long long __pthread_lock_prof_clock(void) attribute_hidden;
+extern void __pthread_lock_prof_record(struct _pthread_fastlock *lock,
+                                       int contended, int slept,
+                                       unsigned long long start)
+  attribute_hidden;
+extern void __pthread_lock_prof_init(void) attribute_hidden;
+
 inline static void __pthread_send_manager_rq(struct pthread_request *r, int block)
 {
   if (l4_is_invalid_cap(__pthread_manager_request))
@@ -313,6 +323,10 @@ extern int __pthread_initialize_manager (void);
 extern void __pthread_message (const char * fmt, ...);
 extern int __pthread_manager (void *reqfd);
 extern int __pthread_start_manager (pthread_descr mgr) L4_HIDDEN;
+extern int __pthread_create_thread (pthread_t *thread,
+                                    const pthread_attr_t *attr,
+                                    void * (*start_routine)(void *),
+                                    void *arg) L4_HIDDEN;
 extern int __pthread_manager_event (void *reqfd);
 extern void __pthread_manager_sighandler (int sig);
 extern void __pthread_reset_main_thread (void);
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2026 Kernkonzept GmbH.
+ *
+ * This file is distributed under the terms of the GNU Library General
+ * Public License, version 2 or (at your option) any later version.
+ */
+
+/* Lock contention profiling.
+
+   While profiling is enabled, every acquisition of an internal fast lock
+   (and therefore of every mutex, and of the locks inside condition
+   variables and read-write locks) is accounted to the lock's address in a
+   fixed-size hash table.  Profiling is enabled with
+   pthread_l4_lock_profile() or by setting PTHREAD_L4_LOCK_PROFILE in the
+   environment, which also prints a report to stderr at exit.
+
+   Locks are identified by address only, so a lock that is destroyed and
+   whose memory is reused for another lock shares its entry.  Once the table
+   is full, locks without an entry are counted as dropped. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pthread.h"
+#include "internals.h"
+
+#include <pthread-l4.h>
+#include <l4/re/env.h>
+#include <l4/sys/kip.h>
+#include <l4/sys/thread.h>
+
+enum { LOCK_PROF_ENTRIES = 1024, LOCK_PROF_REPORT_MAX = 32 };
+
+struct lock_prof_entry
+{
+  struct _pthread_fastlock *lock;
+  unsigned long acquires;
+  unsigned long contended;
+  unsigned long slept;
+  unsigned long long wait_us;
+  unsigned long long max_wait_us;
+};
+
+static struct lock_prof_entry lock_prof[LOCK_PROF_ENTRIES];
+static unsigned long lock_prof_dropped;
+
+int __pthread_lock_profiling;
+
+static struct lock_prof_entry *
+lock_prof_find(struct _pthread_fastlock *lock, int create)
+{
+  unsigned long h = ((unsigned long)lock >> 3) * 2654435761UL;
+  unsigned i;
+
+  for (i = 0; i < LOCK_PROF_ENTRIES; i++) {
+    struct lock_prof_entry *e = &lock_prof[(h + i) % LOCK_PROF_ENTRIES];
+    struct _pthread_fastlock *l = __atomic_load_n(&e->lock, __ATOMIC_ACQUIRE);
+
+    if (l == lock)
+      return e;
+
+    if (l == NULL) {
+      if (!create)
+	return NULL;
+      if (__atomic_compare_exchange_n(&e->lock, &l, lock, 0,
+				      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+	  || l == lock)
+	return e;
+    }
+  }
+
+  return NULL;
+}
+
+unsigned long long __pthread_lock_prof_clock(void)
+{
+  return l4_kip_clock(l4re_kip());
+}
+
+void __pthread_lock_prof_record(struct _pthread_fastlock *lock,
+				int contended, int slept,
+				unsigned long long start)
+{
+  struct lock_prof_entry *e = lock_prof_find(lock, 1);
+  unsigned long long wait, max;
+
+  if (e == NULL) {
+    __atomic_add_fetch(&lock_prof_dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  __atomic_add_fetch(&e->acquires, 1, __ATOMIC_RELAXED);
+  if (!contended)
+    return;
+
+  __atomic_add_fetch(&e->contended, 1, __ATOMIC_RELAXED);
+  if (slept)
+    __atomic_add_fetch(&e->slept, 1, __ATOMIC_RELAXED);
+
+  /* Profiling was enabled while we were waiting. */
+  if (start == 0)
+    return;
+
+  wait = __pthread_lock_prof_clock() - start;
+  __atomic_add_fetch(&e->wait_us, wait, __ATOMIC_RELAXED);
+
+  max = __atomic_load_n(&e->max_wait_us, __ATOMIC_RELAXED);
+  while (wait > max
+	 && !__atomic_compare_exchange_n(&e->max_wait_us, &max, wait, 1,
+					 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+void __pthread_lock_prof_init(void)
+{
+  char const *env = getenv("PTHREAD_L4_LOCK_PROFILE");
+
+  if (env == NULL || *env == '\0')
+    return;
+
+  __pthread_lock_profiling = 1;
+  atexit(pthread_l4_lock_profile_report);
+}
+
+int pthread_l4_lock_profile(int enable)
+{
+  return __atomic_exchange_n(&__pthread_lock_profiling, !!enable,
+			     __ATOMIC_RELAXED);
+}
+
+void pthread_l4_lock_profile_reset(void)
+{
+  memset(lock_prof, 0, sizeof(lock_prof));
+  lock_prof_dropped = 0;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+int pthread_l4_mutex_stats(pthread_mutex_t *mutex,
+			   struct pthread_l4_lock_stats *stats)
+{
+  struct lock_prof_entry *e = lock_prof_find(&mutex->__m_lock, 0);
+
+  if (e == NULL)
+    return ENOENT;
+
+  stats->acquires = e->acquires;
+  stats->contended = e->contended;
+  stats->slept = e->slept;
+  stats->wait_us = e->wait_us;
+  stats->max_wait_us = e->max_wait_us;
+  return 0;
+}
+
+static int lock_prof_cmp(void const *a, void const *b)
+{
+  struct lock_prof_entry const *x = *(struct lock_prof_entry * const *)a;
+  struct lock_prof_entry const *y = *(struct lock_prof_entry * const *)b;
+
+  if (x->wait_us != y->wait_us)
+    return x->wait_us < y->wait_us ? 1 : -1;
+  if (x->contended != y->contended)
+    return x->contended < y->contended ? 1 : -1;
+  return 0;
+}
+
+void pthread_l4_lock_profile_report(void)
+{
+  static struct lock_prof_entry *sorted[LOCK_PROF_ENTRIES];
+  static int report_lock;
+  unsigned i, n = 0;
+
+  while (__atomic_exchange_n(&report_lock, 1, __ATOMIC_ACQUIRE))
+    l4_thread_yield();
+
+  for (i = 0; i < LOCK_PROF_ENTRIES; i++)
+    if (lock_prof[i].lock != NULL && lock_prof[i].acquires != 0)
+      sorted[n++] = &lock_prof[i];
+
+  qsort(sorted, n, sizeof(sorted[0]), lock_prof_cmp);
+
+  fprintf(stderr, "pthread lock profile: %u locks, %lu acquisitions dropped\n",
+	  n, lock_prof_dropped);
+  fprintf(stderr, "%18s %10s %10s %10s %12s %10s\n",
+	  "lock", "acquires", "contended", "slept", "wait[us]", "max[us]");
+
+  for (i = 0; i < n && i < LOCK_PROF_REPORT_MAX; i++)
+    fprintf(stderr, "%18p %10lu %10lu %10lu %12llu %10llu\n",
+	    (void *)sorted[i]->lock, sorted[i]->acquires, sorted[i]->contended,
+	    sorted[i]->slept, sorted[i]->wait_us, sorted[i]->max_wait_us);
+
+  if (n > LOCK_PROF_REPORT_MAX)
+    fprintf(stderr, "(%u more locks)\n", n - LOCK_PROF_REPORT_MAX);
+
+  __atomic_store_n(&report_lock, 0, __ATOMIC_RELEASE);
+}
@@ -108,7 +108,52 @@ static void pthread_handle_exit(pthread_descr issuing_thread, int exitcode)
 static void pthread_for_each_thread(void *arg,
     void (*fn)(void *, pthread_descr));
 
-static int pthread_exited(pthread_descr th);
+static int pthread_exited(pthread_descr th, int parked);
+
+/* Protects the list of live threads, the free UTCBs and the thread cache.
+   Taken by the manager while it handles a request and by threads creating
+   new threads without going through the manager. */
+
+static struct _pthread_fastlock pthread_mgr_lock = __LOCK_INITIALIZER;
+
+/* Cache of the resources of freed threads.
+
+   Threads that ran on a stack allocated by us keep their UTCB and their
+   stack including the guard area when they are freed, and hand them to the
+   next thread created with the same stack geometry. If the freed thread is
+   known to be parked for good, its kernel thread and semaphore are kept as
+   well and the kernel thread is simply pointed to the new entry. */
+
+enum { Thread_cache_max = 16 };
+
+struct pthread_cached
+{
+  l4_utcb_t *utcb;
+  char *guardaddr;
+  size_t guardsize;
+  size_t stacksize;
+  l4_cap_idx_t th_cap;		/* L4_INVALID_CAP if no kernel objects kept */
+  l4_cap_idx_t thsem_cap;
+};
+
+static struct pthread_cached thread_cache[Thread_cache_max];
+static unsigned thread_cache_num;
+
+/* Take a cache entry for a stack of the given geometry, newest first. */
+static int thread_cache_take(size_t guardsize, size_t stacksize,
+                             struct pthread_cached *c)
+{
+  for (unsigned i = thread_cache_num; i > 0; --i)
+    if (thread_cache[i - 1].guardsize == guardsize
+        && thread_cache[i - 1].stacksize == stacksize)
+      {
+        *c = thread_cache[i - 1];
+        thread_cache[i - 1] = thread_cache[--thread_cache_num];
+        return 1;
+      }
+
+  return 0;
+}
 
 /* The server thread managing requests for thread creation and termination */
 
@@ -163,22 +208,30 @@ __pthread_manager(void *arg)
       switch(request.req_kind)
 	{
 	case REQ_CREATE:
+	  __pthread_lock(&pthread_mgr_lock, self);
 	  request.req_thread->p_retcode =
 	    pthread_handle_create((pthread_t *) &request.req_thread->p_retval,
 		request.req_args.create.attr,
 		request.req_args.create.fn,
 		request.req_args.create.arg);
+	  __pthread_unlock(&pthread_mgr_lock);
 	  do_reply = 1;
 	  break;
 	case REQ_FREE:
+	  __pthread_lock(&pthread_mgr_lock, self);
 	  pthread_handle_free(request.req_args.free.thread_id);
+	  __pthread_unlock(&pthread_mgr_lock);
 	  break;
 	case REQ_PROCESS_EXIT:
+	  /* Never released: no thread may be created or freed while the
+	     process exits and the live threads are walked. */
+	  __pthread_lock(&pthread_mgr_lock, self);
 	  pthread_handle_exit(request.req_thread,
 	      request.req_args.exit.code);
 	  /* NOTREACHED */
 	  break;
 	case REQ_MAIN_THREAD_EXIT:
+	  __pthread_lock(&pthread_mgr_lock, self);
 	  main_thread_exiting = 1;
           /* Reap children in case all other threads died and the signal handler
              went off before we set main_thread_exiting to 1, and therefore did
@@ -192,6 +245,7 @@ __pthread_manager(void *arg)
 		 to the thread manager. In case you are wondering how the
 		 manager terminates from its loop here. */
 	  }
+	  __pthread_unlock(&pthread_mgr_lock);
 	  break;
 	case REQ_POST:
 	  sem_post((sem_t*)request.req_args.post);
@@ -211,14 +265,17 @@ __pthread_manager(void *arg)
 	     threads right away, avoiding a potential delay at shutdown. */
 	  break;
 	case REQ_FOR_EACH_THREAD:
+	  __pthread_lock(&pthread_mgr_lock, self);
 	  pthread_for_each_thread(request.req_args.for_each.arg,
 	      request.req_args.for_each.fn);
+	  __pthread_unlock(&pthread_mgr_lock);
           restart(request.req_thread);
 	  do_reply = 1;
 	  break;
         case REQ_THREAD_EXIT:
             {
-              if (!pthread_exited(request.req_thread))
+              __pthread_lock(&pthread_mgr_lock, self);
+              if (!pthread_exited(request.req_thread, 1))
                 {
                   auto th = request.req_thread;
                   /* Thread still waiting to be joined. Only release
@@ -235,6 +292,7 @@ __pthread_manager(void *arg)
                   L4Re::Env::env()->task()->unmap_batch(del_obj, 2,
                                                         L4_FP_DELETE_OBJ);
                 }
+              __pthread_unlock(&pthread_mgr_lock);
             }
           break;
 	}
@@ -372,6 +430,60 @@ static int pthread_l4_free_stack(void *stack_addr, void *guardaddr)
 }
 #endif
 
+/* Allocate a stack with a guard area below it. */
+static int pthread_map_stack(size_t guardsize, size_t stacksize,
+                             char **out_guardaddr)
+{
+  void *map_addr;
+
+#ifdef USE_L4RE_FOR_STACK
+  map_addr = 0;
+  L4Re::Env const *e = L4Re::Env::env();
+  long err;
+
+  if (e->rm()->reserve_area(&map_addr, stacksize + guardsize,
+                            L4Re::Rm::Search_addr) < 0)
+    return -1;
+
+  L4::Cap<L4Re::Dataspace> ds = L4Re::Util::cap_alloc.alloc<L4Re::Dataspace>();
+  if (!ds.is_valid())
+    return -1;
+
+  err = e->mem_alloc()->alloc(stacksize, ds);
+
+  if (err < 0)
+    {
+      L4Re::Util::cap_alloc.free(ds);
+      e->rm()->free_area(l4_addr_t(map_addr));
+      return -1;
+    }
+
+  char *bottom = (char *) map_addr + guardsize;
+  err = e->rm()->attach(&bottom, stacksize, L4Re::Rm::In_area,
+                        L4::Ipc::make_cap_rw(ds), 0);
+
+  if (err < 0)
+    {
+      L4Re::Util::cap_alloc.free(ds, L4Re::This_task);
+      e->rm()->free_area(l4_addr_t(map_addr));
+      return -1;
+    }
+#else
+  map_addr = mmap(NULL, stacksize + guardsize,
+                  PROT_READ | PROT_WRITE | PROT_EXEC,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map_addr == MAP_FAILED)
+    /* No more memory available.  */
+    return -1;
+
+  if (guardsize > 0)
+    mprotect (map_addr, guardsize, PROT_NONE);
+#endif
+
+  *out_guardaddr = (char *) map_addr;
+  return 0;
+}
+
 static int pthread_allocate_stack(const pthread_attr_t *attr,
                                   pthread_descr default_new_thread,
                                   int pagesize,
@@ -379,7 +491,8 @@ static int pthread_allocate_stack(const pthread_attr_t *attr,
                                   char ** out_new_thread_bottom,
                                   char ** out_guardaddr,
                                   size_t * out_guardsize,
-                                  size_t * out_stacksize)
+                                  size_t * out_stacksize,
+                                  struct pthread_cached *cached)
 {
   pthread_descr new_thread;
   char * new_thread_bottom;
@@ -438,7 +551,6 @@ static int pthread_allocate_stack(const pthread_attr_t *attr,
   else
     {
       const size_t granularity = pagesize;
-      void *map_addr;
 
       /* Allocate space for stack and thread descriptor at default address */
       if (attr != NULL)
@@ -454,59 +566,19 @@ static int pthread_allocate_stack(const pthread_attr_t *attr,
 	  stacksize = __pthread_max_stacksize - guardsize;
 	}
 
-#ifdef USE_L4RE_FOR_STACK
-      map_addr = 0;
-      L4Re::Env const *e = L4Re::Env::env();
-      long err;
-
-      if (e->rm()->reserve_area(&map_addr, stacksize + guardsize,
-	                        L4Re::Rm::Search_addr) < 0)
+      /* Reuse the stack of a freed thread if there is one */
+      if (cached && thread_cache_take(guardsize, stacksize, cached))
+	guardaddr = cached->guardaddr;
+      else if (pthread_map_stack(guardsize, stacksize, &guardaddr) < 0)
 	return -1;
 
-      guardaddr = (char*)map_addr;
-
-      L4::Cap<L4Re::Dataspace> ds = L4Re::Util::cap_alloc.alloc<L4Re::Dataspace>();
-      if (!ds.is_valid())
-	return -1;
-
-      err = e->mem_alloc()->alloc(stacksize, ds);
-
-      if (err < 0)
-	{
-	  L4Re::Util::cap_alloc.free(ds);
-	  e->rm()->free_area(l4_addr_t(map_addr));
-	  return -1;
-	}
-
-      new_thread_bottom = (char *) map_addr + guardsize;
-      err = e->rm()->attach(&new_thread_bottom, stacksize, L4Re::Rm::In_area,
-                            L4::Ipc::make_cap_rw(ds), 0);
-
-      if (err < 0)
-	{
-	  L4Re::Util::cap_alloc.free(ds, L4Re::This_task);
-	  e->rm()->free_area(l4_addr_t(map_addr));
-	  return -1;
-	}
-#else
-      map_addr = mmap(NULL, stacksize + guardsize,
-                      PROT_READ | PROT_WRITE | PROT_EXEC,
-                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-      if (map_addr == MAP_FAILED)
-        /* No more memory available.  */
-        return -1;
-
-      guardaddr = (char *)map_addr;
-      if (guardsize > 0)
-        mprotect (guardaddr, guardsize, PROT_NONE);
-
-      new_thread_bottom = (char *) map_addr + guardsize;
-#endif
-
+      new_thread_bottom = guardaddr + guardsize;
 #ifdef USE_TLS
       new_thread = ((pthread_descr) (new_thread_bottom + stacksize));
 #else
       new_thread = ((pthread_descr) (new_thread_bottom + stacksize)) - 1;
+      if (cached && cached->utcb)
+        memset (new_thread, '\0', sizeof (*new_thread));
 #endif
     }
   *out_new_thread = (char *) new_thread;
@@ -596,6 +668,48 @@ int __pthread_mgr_create_thread(pthread_descr thread, char **tos,
   return 0;
 }
 
+/* Start a new thread on the kernel thread kept in a cache entry.
+
+   The kernel thread is still bound to the UTCB of the entry and blocked for
+   good, either in its exit request to the manager or in l4_sleep_forever(),
+   so it only needs new scheduling parameters and a new entry point. Its
+   semaphore may still hold wakeups meant for the previous thread. */
+static inline
+int __pthread_mgr_recycle_thread(pthread_descr thread, char **tos,
+                                 int (*f)(void*), int prio,
+                                 l4_sched_cpu_set_t const &affinity,
+                                 struct pthread_cached const *c)
+{
+  L4::Cap<L4::Thread> t(c->th_cap);
+  int err;
+
+  while (!l4_msgtag_has_error(l4_semaphore_down(c->thsem_cap,
+                                                L4_IPC_BOTH_TIMEOUT_0)))
+    ;
+
+  thread->p_th_cap = c->th_cap;
+  thread->p_thsem_cap = c->thsem_cap;
+
+  l4_utcb_t *nt_utcb = (l4_utcb_t*)thread->p_tid;
+  l4_utcb_tcr_u(nt_utcb)->user[0] = l4_addr_t(thread);
+
+  l4_umword_t *&_tos = (l4_umword_t*&)*tos;
+
+  *(--_tos) = l4_addr_t(thread);
+  *(--_tos) = 0; /* ret addr */
+  *(--_tos) = l4_addr_t(f);
+
+  // the thread is runnable, set its parameters before it enters the new entry
+  l4_sched_param_t sp = l4_sched_param(prio >= 0 ? prio : 2);
+  sp.affinity = affinity;
+  err = l4_error(L4Re::Env::env()->scheduler()->run_thread(t, sp));
+  if (err < 0)
+    return err;
+
+  return l4_error(t->ex_regs(l4_addr_t(__pthread_new_thread_entry),
+                             l4_addr_t(_tos), L4_THREAD_EX_REGS_CANCEL));
+}
+
 static int l4pthr_get_more_utcb()
 {
   using namespace L4Re;
@@ -643,6 +757,8 @@ int __pthread_start_manager(pthread_descr mgr)
   int err;
 
   mgr->p_tid = mgr_alloc_utcb();
+  // threads may be created without the manager as soon as it is started
+  manager_thread = mgr;
 
   err = __pthread_mgr_create_thread(mgr, &__pthread_manager_thread_tos,
                                     __pthread_manager, -1, 0, l4_sched_cpu_set(0, ~0, 1));
@@ -709,11 +825,16 @@ static int pthread_handle_create(pthread_t *thread, const pthread_attr_t *attr,
   if (!new_utcb)
     return EAGAIN;
 
-  new_thread_id = new_utcb;
+  /* A recycled kernel thread would run right away, so threads that shall
+     not be started take no resources from the cache */
+  struct pthread_cached cached;
+  cached.utcb = 0;
+  int use_cache = !attr || !(attr->create_flags & PTHREAD_L4_ATTR_NO_START);
 
   if (pthread_allocate_stack(attr, thread_segment(sseg),
                              pagesize, &stack_addr, &new_thread_bottom,
-                             &guardaddr, &guardsize, &stksize) == 0)
+                             &guardaddr, &guardsize, &stksize,
+                             use_cache ? &cached : NULL) == 0)
     {
 #ifdef USE_TLS
       new_thread->p_stackaddr = stack_addr;
@@ -727,6 +848,15 @@ static int pthread_handle_create(pthread_t *thread, const pthread_attr_t *attr,
       return EAGAIN;
     }
 
+  /* The stack came from the cache, use the UTCB that belongs to it */
+  if (cached.utcb)
+    {
+      mgr_free_utcb(new_utcb);
+      new_utcb = cached.utcb;
+    }
+
+  new_thread_id = new_utcb;
+
   /* Allocate new thread identifier */
   /* Initialize the thread descriptor.  Elements which have to be
      initialized to zero already have this value.  */
@@ -792,14 +922,27 @@ static int pthread_handle_create(pthread_t *thread, const pthread_attr_t *attr,
   *thread = new_thread_id;
   /* Do the cloning.  We have to use two different functions depending
      on whether we are debugging or not.  */
-  err =  __pthread_mgr_create_thread(new_thread, &stack_addr,
-                                     pthread_start_thread, prio,
-                                     attr ? attr->create_flags : 0,
-                                     attr ? attr->affinity : l4_sched_cpu_set(0, ~0, 1));
+  if (cached.utcb && l4_is_valid_cap(cached.th_cap))
+    err = __pthread_mgr_recycle_thread(new_thread, &stack_addr,
+                                       pthread_start_thread, prio,
+                                       attr ? attr->affinity : l4_sched_cpu_set(0, ~0, 1),
+                                       &cached);
+  else
+    err =  __pthread_mgr_create_thread(new_thread, &stack_addr,
+                                       pthread_start_thread, prio,
+                                       attr ? attr->create_flags : 0,
+                                       attr ? attr->affinity : l4_sched_cpu_set(0, ~0, 1));
   saved_errno = -err;
 
   /* Check if cloning succeeded */
   if (err < 0) {
+    if (cached.utcb && l4_is_valid_cap(cached.th_cap))
+      {
+        // the kernel thread is in an unknown state, get rid of it
+        L4Re::Util::Unique_del_cap<void> s(L4::Cap<void>(cached.thsem_cap));
+        L4Re::Util::Unique_del_cap<void> t(L4::Cap<void>(cached.th_cap));
+      }
+
     /* Free the stack if we allocated it */
     if (attr == NULL || !attr->__stackaddr_set)
       {
@@ -851,25 +994,66 @@ static int pthread_handle_create(pthread_t *thread, const pthread_attr_t *attr,
 }
 
 
+/* Create a thread from the calling thread, without a round trip to the
+   thread manager. */
+
+int __pthread_create_thread(pthread_t *thread, const pthread_attr_t *attr,
+                            void * (*start_routine)(void *), void *arg)
+{
+  int err;
+
+  __pthread_lock(&pthread_mgr_lock, NULL);
+  err = pthread_handle_create(thread, attr, start_routine, arg);
+  __pthread_unlock(&pthread_mgr_lock);
+  return err;
+}
+
+
 /* Try to free the resources of a thread when requested by pthread_join
-   or pthread_detach on a terminated thread. */
+   or pthread_detach on a terminated thread.
+
+   `parked` tells that the kernel thread of `th` will not run anymore
+   unless it is restarted by us. */
 
-static void pthread_free(pthread_descr th)
+static void pthread_free(pthread_descr th, int parked)
 {
   pthread_handle handle;
   pthread_readlock_info *iter, *next;
+  struct pthread_cached *cached = 0;
 
   ASSERT(th->p_exited);
+  /* Keep the resources of the thread for the next one if its stack is ours
+     and nothing runs on it anymore */
+  int alive = 0;
+  if (!th->p_userstack && thread_cache_num < Thread_cache_max)
+    {
+      alive = l4_msgtag_label(l4_task_cap_valid(L4RE_THIS_TASK_CAP,
+                                                th->p_th_cap)) > 0;
+      if (parked || !alive)
+        cached = &thread_cache[thread_cache_num++];
+    }
+
   /* Make the handle invalid */
   handle =  thread_handle(th->p_tid);
   __pthread_lock(handle_to_lock(handle), NULL);
-  mgr_free_utcb(handle);
+  if (cached)
+    l4_utcb_tcr_u(handle)->user[0] = 0;
+  else
+    mgr_free_utcb(handle);
   __pthread_unlock(handle_to_lock(handle));
 
+  if (cached && alive)
+    {
+      cached->th_cap = th->p_th_cap;
+      cached->thsem_cap = th->p_thsem_cap;
+    }
+  else
     {
       // free the semaphore and the thread
       L4Re::Util::Unique_del_cap<void> s(L4::Cap<void>(th->p_thsem_cap));
       L4Re::Util::Unique_del_cap<void> t(L4::Cap<void>(th->p_th_cap));
+      if (cached)
+        cached->th_cap = cached->thsem_cap = L4_INVALID_CAP;
     }
 
   /* One fewer threads in __pthread_handles */
@@ -917,12 +1101,25 @@ static void pthread_free(pthread_descr th)
       stacksize *= 2;
 # endif
 #endif
+      if (cached)
+        {
+          cached->utcb = handle;
+          cached->guardaddr = guardaddr;
+          cached->guardsize = guardsize;
+#ifdef USE_TLS
+          cached->stacksize = th->p_stackaddr - guardaddr - guardsize;
+#else
+          cached->stacksize = (char *)(th+1) - guardaddr - guardsize;
+#endif
+        }
+      else
+        {
 #ifdef USE_L4RE_FOR_STACK
-      pthread_l4_free_stack(guardaddr + guardsize, guardaddr);
+          pthread_l4_free_stack(guardaddr + guardsize, guardaddr);
 #else
-      munmap(guardaddr, stacksize + guardsize);
+          munmap(guardaddr, stacksize + guardsize);
 #endif
-
+        }
     }
 
 #ifdef USE_TLS
@@ -935,7 +1132,7 @@ static void pthread_free(pthread_descr th)
 
 /* Handle threads that have exited */
 
-static int pthread_exited(pthread_descr th)
+static int pthread_exited(pthread_descr th, int parked)
 {
   if (th->p_exited)
     return 0;
@@ -951,7 +1148,7 @@ static int pthread_exited(pthread_descr th)
   detached = th->p_detached;
   __pthread_unlock(th->p_lock);
   if (detached)
-    pthread_free(th);
+    pthread_free(th, parked);
   /* If all threads have exited and the main thread is pending on a
      pthread_exit, wake up the main thread and terminate ourselves. */
   if (main_thread_exiting &&
@@ -981,8 +1178,11 @@ static void pthread_handle_free(pthread_t th_id)
   }
   th = handle_to_descr(handle);
   __pthread_unlock(handle_to_lock(handle));
-  if (!pthread_exited(th))
-    pthread_free(th);
+  /* A thread that was joined while it ran has parked itself after waking
+     up the joiner, see __pthread_do_exit */
+  int parked = th->p_joining != NULL;
+  if (!pthread_exited(th, parked))
+    pthread_free(th, parked);
 }
 
 /* Send a signal to all running threads */
@@ -1019,7 +1219,7 @@ static void pthread_for_each_thread(void *arg,
   fn(arg, __pthread_main_thread);
 }
 
-/* Process-wide exit() */
+/* Process-wide exit(), called with pthread_mgr_lock held */
 
 static void pthread_handle_exit(pthread_descr issuing_thread, int exitcode)
 {
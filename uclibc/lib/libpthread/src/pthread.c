@@ -631,6 +631,8 @@ static void pthread_initialize(void)
     __on_exit (pthread_onexit_process, NULL);
   /* How many processors.  */
   __pthread_smp_kernel = is_smp_system ();
+  /* Lock contention profiling requested through the environment. */
+  __pthread_lock_prof_init();
 
 /* psm: we do not have any ld.so support yet
  *	 remove the USE_TLS guard if nptl is added */
@@ -893,30 +895,13 @@ attribute_hidden
 __pthread_create(pthread_t *thread, const pthread_attr_t *attr,
 			 void * (*start_routine)(void *), void *arg)
 {
-  pthread_descr self = thread_self();
-  struct pthread_request request;
-  int retval;
   if (__builtin_expect (l4_is_invalid_cap(__pthread_manager_request), 0)) {
     if (__pthread_initialize_manager() < 0)
       return EAGAIN;
   }
-  request.req_thread = self;
-  request.req_kind = REQ_CREATE;
-  request.req_args.create.attr = attr;
-  request.req_args.create.fn = start_routine;
-  request.req_args.create.arg = arg;
-#ifdef NOT_FOR_L4
-  sigprocmask(SIG_SETMASK, NULL, &request.req_args.create.mask);
-  TEMP_FAILURE_RETRY(write_not_cancel(__pthread_manager_request,
-				      (char *) &request, sizeof(request)));
-  suspend(self);
-#else
-  __pthread_send_manager_rq(&request, 1);
-#endif
-  retval = THREAD_GETMEM(self, p_retcode);
-  if (__builtin_expect (retval, 0) == 0)
-    *thread = (pthread_t) THREAD_GETMEM(self, p_retval);
-  return retval;
+  /* The manager still reaps exited threads, but creation is done right
+     here, serialized against the manager by its lock.  */
+  return __pthread_create_thread(thread, attr, start_routine, arg);
 }
 strong_alias (__pthread_create, pthread_create)
 
@@ -60,13 +60,117 @@ static __inline__ void __pthread_release(int * spinlock)
    operations -- only the thread that locked the mutex can unlock it. */
 
 
+/* Waiting for a lock.
+
+   A thread that queued itself on a lock first spins on its own p_lockwake
+   word before it blocks on its semaphore.  The thread that takes it off the
+   queue sets that word to LOCK_WOKEN and only posts the semaphore if the
+   waiter has already gone to sleep.  So if the lock is released while the
+   waiter still spins, neither of them enters the kernel.  */
+
+enum { LOCK_WAITING = 0, LOCK_SLEEPING = 1, LOCK_WOKEN = 2 };
+
+/* Used by compare_and_swap emulation on p_lockwake. */
+static int lock_wake_spinlock = __LT_SPINLOCK_INIT;
+
+/* Wait until lock_wake() is called for us, spinning for at most `spins`
+   iterations before going to sleep.  Returns the number of iterations spun
+   or -1 if we slept.  Wake-ups of our semaphore that do not come from
+   lock_wake() are counted in *spurious. */
+
+static int lock_wait(pthread_descr self, int spins, int *spurious)
+{
+  long volatile *wake = &self->p_lockwake;
+  int i;
+
+  for (i = 0; i < spins; i++) {
+    if (*wake == LOCK_WOKEN) {
+      READ_MEMORY_BARRIER();
+      return i;
+    }
+#ifdef BUSY_WAIT_NOP
+    BUSY_WAIT_NOP;
+#endif
+  }
+
+  if (!compare_and_swap(&self->p_lockwake, LOCK_WAITING, LOCK_SLEEPING,
+			&lock_wake_spinlock)) {
+    /* Woken right before we wanted to sleep. */
+    READ_MEMORY_BARRIER();
+    return spins;
+  }
+
+  for (;;) {
+    suspend(self);
+    if (*wake == LOCK_WOKEN)
+      break;
+    (*spurious)++;
+  }
+
+  READ_MEMORY_BARRIER();
+  return -1;
+}
+
+/* Wake a thread that the caller took off a lock's wait queue. */
+
+static void lock_wake(pthread_descr th)
+{
+  long oldwake;
+
+  do {
+    oldwake = th->p_lockwake;
+  } while (!compare_and_swap(&th->p_lockwake, oldwake, LOCK_WOKEN,
+			     &lock_wake_spinlock));
+
+  if (oldwake == LOCK_SLEEPING)
+    restart(th);
+}
+
+/* Adaptive spinning.
+
+   On SMP, a waiter spins for up to spin_limit() iterations, first on the
+   lock and then on its own wake-up word.  The limit is twice an estimate of
+   how long the lock stays held, kept in lock->__spinlock and fed by every
+   contended acquisition (spin_update()):
+
+   - a thread that got the lock after spinning `n` iterations moves the
+     estimate towards `n`;
+   - a thread that had to sleep saw a hold time beyond what spinning can
+     bridge and lets the estimate decay, so that waiters of long-held locks
+     waste less CPU time.  */
+
+static __inline__ int spin_limit(struct _pthread_fastlock * lock)
+{
+  int max_count;
+
+  if (!__pthread_smp_kernel)
+    return 0;
+
+  max_count = lock->__spinlock * 2 + 10;
+  if (max_count > MAX_ADAPTIVE_SPIN_COUNT)
+    max_count = MAX_ADAPTIVE_SPIN_COUNT;
+
+  return max_count;
+}
+
+/* `spun` is the number of iterations spun, or -1 if the thread slept. */
+
+static __inline__ void spin_update(struct _pthread_fastlock * lock, int spun)
+{
+  if (spun < 0)
+    lock->__spinlock -= lock->__spinlock / 8;
+  else
+    lock->__spinlock += (spun - lock->__spinlock) / 8;
+}
+
 void internal_function __pthread_lock(struct _pthread_fastlock * lock,
 				      pthread_descr self)
 {
 #if defined HAS_COMPARE_AND_SWAP
   long oldstatus, newstatus;
   int successful_seizure, spurious_wakeup_count;
-  int spin_count;
+  int spin_count, max_count, spun, slept;
+  unsigned long long start;
 #endif
 
 #if defined TEST_FOR_COMPARE_AND_SWAP
@@ -82,37 +186,33 @@ void internal_function __pthread_lock(struct _pthread_fastlock * lock,
 #if defined HAS_COMPARE_AND_SWAP
   /* First try it without preparation.  Maybe it's a completely
      uncontested lock.  */
-  if (lock->__status == 0 && __compare_and_swap (&lock->__status, 0, 1))
+  if (lock->__status == 0 && __compare_and_swap (&lock->__status, 0, 1)) {
+    if (__builtin_expect(__pthread_lock_profiling, 0))
+      __pthread_lock_prof_record(lock, 0, 0, 0);
     return;
+  }
 
   spurious_wakeup_count = 0;
-  spin_count = 0;
+  slept = 0;
+  start = 0;
+  if (__builtin_expect(__pthread_lock_profiling, 0))
+    start = __pthread_lock_prof_clock();
 
   /* On SMP, try spinning to get the lock. */
 
-  if (__pthread_smp_kernel) {
-    int max_count = lock->__spinlock * 2 + 10;
-
-    if (max_count > MAX_ADAPTIVE_SPIN_COUNT)
-      max_count = MAX_ADAPTIVE_SPIN_COUNT;
-
-    for (spin_count = 0; spin_count < max_count; spin_count++) {
-      if (((oldstatus = lock->__status) & 1) == 0) {
-	if(__compare_and_swap(&lock->__status, oldstatus, oldstatus | 1))
-	{
-	  if (spin_count)
-	    lock->__spinlock += (spin_count - lock->__spinlock) / 8;
-	  READ_MEMORY_BARRIER();
-	  return;
-	}
+  max_count = spin_limit(lock);
+  for (spin_count = 0; spin_count < max_count; spin_count++) {
+    if (((oldstatus = lock->__status) & 1) == 0) {
+      if(__compare_and_swap(&lock->__status, oldstatus, oldstatus | 1))
+      {
+	spin_update(lock, spin_count);
+	goto acquired;
       }
+    }
 #ifdef BUSY_WAIT_NOP
-      BUSY_WAIT_NOP;
+    BUSY_WAIT_NOP;
 #endif
-      __asm__ __volatile__ ("" : "=m" (lock->__status) : "m" (lock->__status));
-    }
-
-    lock->__spinlock += (spin_count - lock->__spinlock) / 8;
+    __asm__ __volatile__ ("" : "=m" (lock->__status) : "m" (lock->__status));
   }
 
 again:
@@ -134,28 +234,27 @@ again:
 
     if (self != NULL) {
       THREAD_SETMEM(self, p_nextlock, (pthread_descr) (oldstatus));
+      THREAD_SETMEM(self, p_lockwake, LOCK_WAITING);
       /* Make sure the store in p_nextlock completes before performing
          the compare-and-swap */
       MEMORY_BARRIER();
     }
   } while(! __compare_and_swap(&lock->__status, oldstatus, newstatus));
 
-  /* Suspend with guard against spurious wakeup.
+  /* Wait with guard against spurious wakeup.
      This can happen in pthread_cond_timedwait_relative, when the thread
      wakes up due to timeout and is still on the condvar queue, and then
      locks the queue to remove itself. At that point it may still be on the
-     queue, and may be resumed by a condition signal. */
+     queue, and may be resumed by a condition signal.
+
+     Being woken does not hand over the lock, it only takes us off the
+     queue, so compete for the lock again. */
 
   if (!successful_seizure) {
-    for (;;) {
-      suspend(self);
-      if (self->p_nextlock != NULL) {
-	/* Count resumes that don't belong to us. */
-	spurious_wakeup_count++;
-	continue;
-      }
-      break;
-    }
+    spun = lock_wait(self, max_count, &spurious_wakeup_count);
+    if (spun < 0)
+      slept = 1;
+    spin_update(lock, spun < 0 ? -1 : max_count + spun);
     goto again;
   }
 
@@ -163,7 +262,11 @@ again:
   while (spurious_wakeup_count--)
     restart(self);
 
+acquired:
   READ_MEMORY_BARRIER();
+
+  if (__builtin_expect(__pthread_lock_profiling, 0))
+    __pthread_lock_prof_record(lock, 1, slept, start);
 #endif
 }
 
@@ -248,13 +351,11 @@ again:
 	     oldstatus, oldstatus & ~1L));
   }
 
-  /* Wake up the selected waiting thread. Woken thread can check
-     its own p_nextlock field for NULL to detect that it has been removed. No
-     barrier is needed here, since restart() and suspend() take
-     care of memory synchronization. */
+  /* Wake up the selected waiting thread. The compare-and-swap in
+     lock_wake() orders the store to p_nextlock before the wake-up. */
 
   thr->p_nextlock = NULL;
-  restart(thr);
+  lock_wake(thr);
 
   return 0;
 #endif
@@ -362,8 +463,11 @@ void __pthread_alt_lock(struct _pthread_fastlock * lock,
 {
 #if defined HAS_COMPARE_AND_SWAP
   long oldstatus, newstatus;
+  int spin_count, max_count, spun, slept;
+  unsigned long long start;
 #endif
   struct wait_node wait_node;
+  int spurious_wakeup_count = 0;
 
 #if defined TEST_FOR_COMPARE_AND_SWAP
   if (!__pthread_has_cas)
@@ -382,19 +486,54 @@ void __pthread_alt_lock(struct _pthread_fastlock * lock,
       wait_node.abandoned = 0;
       wait_node.next = (struct wait_node *) lock->__status;
       wait_node.thr = self;
+      self->p_lockwake = LOCK_WAITING;
       lock->__status = (long) &wait_node;
       suspend_needed = 1;
     }
 
     __pthread_release(&lock->__spinlock);
 
-    if (suspend_needed)
-      suspend (self);
+    if (suspend_needed) {
+      lock_wait(self, 0, &spurious_wakeup_count);
+      while (spurious_wakeup_count--)
+	restart(self);
+    }
     return;
   }
 #endif
 
 #if defined HAS_COMPARE_AND_SWAP
+  if (lock->__status == 0 && __compare_and_swap(&lock->__status, 0, 1)) {
+    if (__builtin_expect(__pthread_lock_profiling, 0))
+      __pthread_lock_prof_record(lock, 0, 0, 0);
+    return;
+  }
+
+  slept = 0;
+  start = 0;
+  if (__builtin_expect(__pthread_lock_profiling, 0))
+    start = __pthread_lock_prof_clock();
+
+  /* On SMP, spin while the lock is held but nobody waits for it. Once
+     threads are queued, the lock is handed over to them and we queue up as
+     well. */
+
+  max_count = spin_limit(lock);
+  for (spin_count = 0; spin_count < max_count; spin_count++) {
+    oldstatus = lock->__status;
+    if (oldstatus == 0) {
+      if (__compare_and_swap(&lock->__status, 0, 1)) {
+	spin_update(lock, spin_count);
+	goto acquired;
+      }
+    } else if (oldstatus != 1)
+      break;
+#ifdef BUSY_WAIT_NOP
+    BUSY_WAIT_NOP;
+#endif
+    __asm__ __volatile__ ("" : "=m" (lock->__status) : "m" (lock->__status));
+  }
+
   do {
     oldstatus = lock->__status;
     if (oldstatus == 0) {
@@ -403,6 +542,7 @@ void __pthread_alt_lock(struct _pthread_fastlock * lock,
       if (self == NULL)
 	self = thread_self();
       wait_node.thr = self;
+      self->p_lockwake = LOCK_WAITING;
       newstatus = (long) &wait_node;
     }
     wait_node.abandoned = 0;
@@ -412,15 +552,25 @@ void __pthread_alt_lock(struct _pthread_fastlock * lock,
     MEMORY_BARRIER();
   } while(! __compare_and_swap(&lock->__status, oldstatus, newstatus));
 
-  /* Suspend. Note that unlike in __pthread_lock, we don't worry
-     here about spurious wakeup. That's because this lock is not
-     used in situations where that can happen; the restart can
-     only come from the previous lock owner. */
+  /* Wait for the previous owner to hand over the lock. Other than in
+     __pthread_lock, spurious wakeups cannot come from the lock itself, but
+     the thread may still get restarted for a condition variable. */
 
-  if (oldstatus != 0)
-    suspend(self);
+  if (oldstatus != 0) {
+    spun = lock_wait(self, max_count, &spurious_wakeup_count);
+    if (spun < 0)
+      slept = 1;
+    spin_update(lock, spun < 0 ? -1 : max_count + spun);
 
+    while (spurious_wakeup_count--)
+      restart(self);
+  }
+
+acquired:
   READ_MEMORY_BARRIER();
+
+  if (__builtin_expect(__pthread_lock_profiling, 0))
+    __pthread_lock_prof_record(lock, 1, slept, start);
 #endif
 }
 
@@ -430,6 +580,8 @@ int __pthread_alt_timedlock(struct _pthread_fastlock * lock,
 			    pthread_descr self, const struct timespec *abstime)
 {
   long oldstatus = 0;
+  int slept = 0;
+  unsigned long long start = 0;
 #if defined HAS_COMPARE_AND_SWAP
   long newstatus;
 #endif
@@ -457,6 +609,7 @@ int __pthread_alt_timedlock(struct _pthread_fastlock * lock,
       p_wait_node->abandoned = 0;
       p_wait_node->next = (struct wait_node *) lock->__status;
       p_wait_node->thr = self;
+      self->p_lockwake = LOCK_WAITING;
       lock->__status = (long) p_wait_node;
       oldstatus = 1; /* force suspend */
     }
@@ -475,6 +628,7 @@ int __pthread_alt_timedlock(struct _pthread_fastlock * lock,
       if (self == NULL)
 	self = thread_self();
       p_wait_node->thr = self;
+      self->p_lockwake = LOCK_WAITING;
       newstatus = (long) p_wait_node;
     }
     p_wait_node->abandoned = 0;
@@ -494,16 +648,26 @@ int __pthread_alt_timedlock(struct _pthread_fastlock * lock,
      to remove us from the queue. This race is resolved by us and the owner
      doing an atomic testandset() to change the state of the wait node from 0
      to 1. If we succeed, then it's a timeout and we abandon the node in the
-     queue. If we fail, it means the owner gave us the lock. */
+     queue. If we fail, it means the owner gave us the lock.
 
-  if (oldstatus != 0) {
-    if (timedsuspend(self, abstime) == 0) {
-      if (!testandset(&p_wait_node->abandoned))
-	return 0; /* Timeout! */
+     If the owner handed over the lock before we announced that we go to
+     sleep, it does not post our semaphore and we must not wait for it. */
 
-      /* Eat oustanding resume from owner, otherwise wait_node_free() below
-	 will race with owner's wait_node_dequeue(). */
-      suspend(self);
+  if (oldstatus != 0) {
+    if (__builtin_expect(__pthread_lock_profiling, 0))
+      start = __pthread_lock_prof_clock();
+
+    if (compare_and_swap(&self->p_lockwake, LOCK_WAITING, LOCK_SLEEPING,
+			 &lock_wake_spinlock)) {
+      slept = 1;
+      if (timedsuspend(self, abstime) == 0) {
+	if (!testandset(&p_wait_node->abandoned))
+	  return 0; /* Timeout! */
+
+	/* Eat oustanding resume from owner, otherwise wait_node_free() below
+	   will race with owner's wait_node_dequeue(). */
+	suspend(self);
+      }
     }
   }
 
@@ -511,6 +675,9 @@ int __pthread_alt_timedlock(struct _pthread_fastlock * lock,
 
   READ_MEMORY_BARRIER();
 
+  if (__builtin_expect(__pthread_lock_profiling, 0))
+    __pthread_lock_prof_record(lock, oldstatus != 0, slept, start);
+
   return 1; /* Got the lock! */
 }
 
@@ -651,7 +818,7 @@ void __pthread_alt_unlock(struct _pthread_fastlock *lock)
 	}
 #endif
 
-      restart(p_max_prio->thr);
+      lock_wake(p_max_prio->thr);
 
       return;
     }